@@ -20,7 +20,7 @@ build_editor_bvh(const shared::map_t &map)
     if (!entry.entity)
       continue;
 
-    auto bounds = shared::compute_entity_bounds(entry.entity.get());
+    auto bounds = shared::compute_entity_bounds(entry.entity);
 
     BVH_Input input;
     input.aabb.min = bounds.min;
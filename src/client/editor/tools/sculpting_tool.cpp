@@ -151,7 +151,7 @@ void Sculpting_Tool::on_update(editor_context_t &ctx,
         if (entry && entry->entity)
         {
           if (auto *aabb_ent =
-                  dynamic_cast<::network::AABB_Entity *>(entry->entity.get()))
+                  dynamic_cast<::network::AABB_Entity *>(entry->entity))
           {
             shared::aabb_t aabb;
             aabb.center = aabb_ent->position;
@@ -185,7 +185,7 @@ void Sculpting_Tool::on_mouse_down(editor_context_t &ctx,
     if (entry && entry->entity)
     {
       if (auto *aabb_ent =
-              dynamic_cast<::network::AABB_Entity *>(entry->entity.get()))
+              dynamic_cast<::network::AABB_Entity *>(entry->entity))
       {
         original_aabb.center = aabb_ent->position;
         original_aabb.half_extents = aabb_ent->half_extents;
@@ -207,7 +207,7 @@ void Sculpting_Tool::on_mouse_drag(editor_context_t &ctx,
       return;
 
     if (auto *aabb_ent =
-            dynamic_cast<::network::AABB_Entity *>(entry->entity.get()))
+            dynamic_cast<::network::AABB_Entity *>(entry->entity))
     {
       using namespace linalg;
 
@@ -351,7 +351,7 @@ void Sculpting_Tool::on_draw_overlay(editor_context_t &ctx,
     if (entry && entry->entity)
     {
       if (auto *aabb_ent =
-              dynamic_cast<::network::AABB_Entity *>(entry->entity.get()))
+              dynamic_cast<::network::AABB_Entity *>(entry->entity))
       {
         shared::aabb_t aabb;
         aabb.center = aabb_ent->position;
@@ -52,7 +52,7 @@ void Selection_Tool::on_draw_ui(editor_context_t &ctx)
       auto *entry = ctx.map->find_by_uid(selected_uids[0]);
       if (entry && entry->entity)
       {
-        render_imgui_entity_fields_in_a_window(entry->entity.get());
+        render_imgui_entity_fields_in_a_window(entry->entity);
       }
     }
     ImGui::End();
@@ -80,11 +80,11 @@ void Selection_Tool::on_update(editor_context_t &ctx,
     auto *entry = ctx.map->find_by_uid(selected_uids[0]);
     if (entry && entry->entity)
     {
-      auto bounds = shared::compute_entity_bounds(entry->entity.get());
+      auto bounds = shared::compute_entity_bounds(entry->entity);
       editor_gizmo.set_geometry(bounds);
 
       // Only show reshape handles for entities that support face sculpting
-      if (dynamic_cast<::network::AABB_Entity *>(entry->entity.get()))
+      if (dynamic_cast<::network::AABB_Entity *>(entry->entity))
         editor_gizmo.set_mode(Editor_Gizmo::Gizmo_Mode::Unified);
       else
         editor_gizmo.set_mode(Editor_Gizmo::Gizmo_Mode::Translate);
@@ -242,7 +242,7 @@ void Selection_Tool::on_mouse_up(editor_context_t &ctx, const mouse_event_t &e)
       {
         if (!entry.entity)
           continue;
-        auto bounds = shared::compute_entity_bounds(entry.entity.get());
+        auto bounds = shared::compute_entity_bounds(entry.entity);
 
         linalg::vec3 p = (bounds.min + bounds.max) * 0.5f;
 
@@ -356,7 +356,7 @@ void Selection_Tool::on_draw_overlay(editor_context_t &ctx,
     auto *entry = ctx.map->find_by_uid(uid);
     if (entry && entry->entity)
     {
-      draw_entity_highlight(entry->entity.get(), 0xFF00FF00);
+      draw_entity_highlight(entry->entity, 0xFF00FF00);
     }
   }
 
@@ -377,7 +377,7 @@ void Selection_Tool::on_draw_overlay(editor_context_t &ctx,
       auto *entry = ctx.map->find_by_uid(hovered_uid);
       if (entry && entry->entity)
       {
-        draw_entity_highlight(entry->entity.get(), 0xFF00FFFF);
+        draw_entity_highlight(entry->entity, 0xFF00FFFF);
       }
     }
   }
@@ -396,7 +396,7 @@ void Selection_Tool::on_draw_overlay(editor_context_t &ctx,
     {
       if (!entry.entity)
         continue;
-      auto bounds = shared::compute_entity_bounds(entry.entity.get());
+      auto bounds = shared::compute_entity_bounds(entry.entity);
 
       linalg::vec3 p = (bounds.min + bounds.max) * 0.5f;
 
@@ -421,7 +421,7 @@ void Selection_Tool::on_draw_overlay(editor_context_t &ctx,
 
         if (!already_selected)
         {
-          draw_entity_highlight(entry.entity.get(), 0xFF00FFFF);
+          draw_entity_highlight(entry.entity, 0xFF00FFFF);
         }
       }
     }
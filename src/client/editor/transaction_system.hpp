@@ -117,7 +117,7 @@ private:
       if (ent)
       {
         ent->init_from_map(d.snapshot.properties);
-        map.add_entity_with_uid(d.entity_uid, ent);
+        map.add_entity_with_uid(d.entity_uid, *ent);
       }
       break;
     }
@@ -156,7 +156,7 @@ private:
       if (ent)
       {
         ent->init_from_map(d.snapshot.properties);
-        map.add_entity_with_uid(d.entity_uid, ent);
+        map.add_entity_with_uid(d.entity_uid, *ent);
       }
       break;
     }
@@ -187,7 +187,7 @@ public:
   // Add entity to map and record it
   shared::entity_uid_t add(std::shared_ptr<network::Entity> ent)
   {
-    shared::entity_uid_t uid = map_.add_entity(ent);
+    shared::entity_uid_t uid = map_.add_entity(*ent);
 
     entity_delta_t d;
     d.type = entity_delta_t::type_t::Add;
@@ -210,7 +210,7 @@ public:
     d.type = entity_delta_t::type_t::Remove;
     d.entity_uid = uid;
     d.snapshot.classname =
-        shared::get_classname_for_entity(entry->entity.get());
+        shared::get_classname_for_entity(entry->entity);
     d.snapshot.properties = entry->entity->get_all_properties();
     txn_.deltas.push_back(std::move(d));
 
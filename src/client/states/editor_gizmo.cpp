@@ -350,7 +350,7 @@ void Editor_Gizmo::start_interaction(Transaction_System *sys,
   // Store original for drag calculations
   auto &ent = entry->entity;
 
-  if (auto *aabb = dynamic_cast<::network::AABB_Entity *>(ent.get()))
+  if (auto *aabb = dynamic_cast<::network::AABB_Entity *>(ent))
   {
     original_transform.position = aabb->position;
     original_transform.scale =
@@ -358,19 +358,19 @@ void Editor_Gizmo::start_interaction(Transaction_System *sys,
     original_transform.orientation = {0, 0, 0,
                                       1}; // Identity (AABB has no rotation)
   }
-  else if (auto *wedge = dynamic_cast<::network::Wedge_Entity *>(ent.get()))
+  else if (auto *wedge = dynamic_cast<::network::Wedge_Entity *>(ent))
   {
     original_transform.position = wedge->position;
     original_transform.scale = wedge->half_extents;
     original_transform.orientation = {0, 0, 0, 1}; // TODO: Wedge rotation
   }
   else if (auto *mesh =
-               dynamic_cast<::network::Static_Mesh_Entity *>(ent.get()))
+               dynamic_cast<::network::Static_Mesh_Entity *>(ent))
   {
     original_transform.position = mesh->position;
     original_transform.scale = mesh->render.scale;
   }
-  else if (auto *player = dynamic_cast<::network::Player_Entity *>(ent.get()))
+  else if (auto *player = dynamic_cast<::network::Player_Entity *>(ent))
   {
     original_transform.position = player->position;
     original_transform.scale = {1, 1, 1};
@@ -529,7 +529,7 @@ void Editor_Gizmo::handle_input(const linalg::ray_t &ray, bool is_mouse_down,
       auto *_entry = target_map->find_by_uid(target_uid);
       if (!_entry) return;
       auto &ent = _entry->entity;
-      if (auto *aabb = dynamic_cast<::network::AABB_Entity *>(ent.get()))
+      if (auto *aabb = dynamic_cast<::network::AABB_Entity *>(ent))
       {
         if (axis == 0)
         {
@@ -1,9 +1,12 @@
 #include "play_state.hpp"
 #include "../console.hpp"
+#include "../input.hpp"
 #include "../renderer.hpp"
 #include "../shared/map.hpp"
 #include "../shared/network/network_types.hpp"
 #include "../state_manager.hpp"
+#include <SDL.h>
+#include <algorithm>
 
 // TODO: WORKING ON MAP LOADING!.
 
@@ -53,6 +56,8 @@ void PlayState::update(float dt)
     if (cmd.has_accept())
     {
       ctx.connection_state.connected = true;
+      ctx.connection_state.connection_token =
+          static_cast<network::uint16>(cmd.accept().connection_token());
       renderer::draw_announcement("Connected!");
 
       if (ctx.session.map_name != cmd.accept().map_name())
@@ -63,7 +68,7 @@ void PlayState::update(float dt)
         std::string map_path = "levels/" + cmd.accept().map_name();
         if (shared::load_map(map_path, temp_map))
         {
-          shared::init_session_from_map(ctx.session, temp_map);
+          shared::init_session_from_map(ctx.session, std::move(temp_map));
           ctx.session.map_name = cmd.accept().map_name();
         }
       }
@@ -75,10 +80,44 @@ void PlayState::update(float dt)
     }
   }
 
-  // TODO: Handle Entity Replication here
-  // for(const auto& update : inbox.entity_updates) { ... }
+  // Decode (and ack) snapshots so the server can delta against them.
+  // TODO: Handle Entity Replication here (apply the latest snapshot to
+  // ctx.session; receive_snapshot can report the entities to spawn/despawn).
+  for (const auto &update : inbox.entity_updates)
+  {
+    network::receive_snapshot(ctx.connection_state, update);
+  }
 
   // Game logic here
+
+  if (ctx.connection_state.connected)
+  {
+    // Sample this frame's input and send it (with the last few commands, in
+    // case a datagram is lost).
+    int mouse_dx = 0;
+    int mouse_dy = 0;
+    input::get_mouse_delta(&mouse_dx, &mouse_dy);
+    view_yaw += mouse_dx * 0.1f;
+    view_pitch = std::clamp(view_pitch - mouse_dy * 0.1f, -89.0f, 89.0f);
+
+    network::usercmd_t cmd;
+    cmd.tick = ++input_tick;
+    cmd.yaw = network::degrees_to_angle(view_yaw);
+    cmd.pitch = network::degrees_to_angle(view_pitch);
+    cmd.forward_move = network::quantize_move(
+        float(input::is_key_down(SDL_SCANCODE_W)) -
+        float(input::is_key_down(SDL_SCANCODE_S)));
+    cmd.side_move = network::quantize_move(
+        float(input::is_key_down(SDL_SCANCODE_D)) -
+        float(input::is_key_down(SDL_SCANCODE_A)));
+    if (input::is_key_down(SDL_SCANCODE_SPACE))
+      cmd.buttons |= network::Button_Jump;
+    if (input::is_key_down(SDL_SCANCODE_LCTRL))
+      cmd.buttons |= network::Button_Crouch;
+    if (input::is_mouse_down(SDL_BUTTON_LEFT))
+      cmd.buttons |= network::Button_Attack;
+    network::send_usercmd(ctx.connection_state, cmd);
+  }
 }
 
 void PlayState::render_ui()
@@ -13,6 +13,12 @@ public:
   void update(float dt) override;
   void render_ui() override;
   void render_3d(VkCommandBuffer cmd) override;
+
+private:
+  // View angles (degrees) and frame counter for the usercmds we send.
+  float view_yaw = 0.0f;
+  float view_pitch = 0.0f;
+  network::uint32 input_tick = 0;
 };
 
 } // namespace client
@@ -1,7 +1,7 @@
 #include "tool_editor_state.hpp"
 #include "../../shared/asset.hpp"
-#include "../../shared/entities/player_entity.hpp"
-#include "../../shared/entities/static_entities.hpp"
+#define ENTITIES_WANT_INCLUDES
+#include "../../shared/entities/entity_list.hpp"
 #include "../editor/editor_entity.hpp"
 #include "../editor/tools/placement_tool.hpp"
 #include "../editor/tools/sculpting_tool.hpp"
@@ -112,9 +112,9 @@ void ToolEditorState::on_enter()
   if (!map_loaded)
   {
     map.name = "Tool Editor Map";
-    auto floor_ent = std::make_shared<::network::AABB_Entity>();
-    floor_ent->position = {0, -2.0f, 0};
-    floor_ent->half_extents = {10.0f, 0.5f, 10.0f};
+    ::network::AABB_Entity floor_ent;
+    floor_ent.position = {0, -2.0f, 0};
+    floor_ent.half_extents = {10.0f, 0.5f, 10.0f};
 
     map.add_entity(floor_ent);
     renderer::draw_announcement("Welcome to the Tool Editor!");
@@ -613,7 +613,7 @@ void ToolEditorState::render_3d(VkCommandBuffer cmd)
   // Draw map elements
   for (const auto &entry : map.entities)
   {
-    const auto &ent = entry.entity;
+    const ::network::Entity *ent = entry.entity;
     if (!ent)
       continue;
 
@@ -640,38 +640,44 @@ void ToolEditorState::render_3d(VkCommandBuffer cmd)
     }
 
     // Fallback: entity-specific primitive rendering
-    if (auto *aabb = dynamic_cast<::network::AABB_Entity *>(ent.get()))
-    {
-      renderer::DrawWireAABB(cmd, aabb->position - aabb->half_extents,
-                             aabb->position + aabb->half_extents, 0xFFFFFFFF);
-    }
-    else if (auto *wedge = dynamic_cast<::network::Wedge_Entity *>(ent.get()))
-    {
-      shared::wedge_t w;
-      w.center = wedge->position;
-      w.half_extents = wedge->half_extents;
-      w.orientation = wedge->orientation;
-      renderer::draw_wedge(cmd, w, 0xFFFFFFFF);
-    }
-    else if (dynamic_cast<::network::Static_Mesh_Entity *>(ent.get()))
-    {
-      // No mesh in render component — draw placeholder AABB
-      auto bounds = shared::compute_entity_bounds(ent.get());
-      renderer::DrawWireAABB(cmd, bounds.min, bounds.max, 0xFF00FFFF);
-    }
-    else if (auto *player = dynamic_cast<::network::Player_Entity *>(ent.get()))
-    {
-      const char *mesh_path = assets::get_mesh_path(2); // pyramid
-      if (mesh_path)
-      {
-        auto mesh_handle = assets::load_mesh(mesh_path);
-        if (mesh_handle.valid())
-        {
-          renderer::DrawMeshWireframe(cmd, ent->position, {1, 1, 1},
-                                      mesh_handle, 0xFFFFFFFF, ent->orientation);
-        }
-      }
-    }
+    shared::visit_entity(
+        *ent,
+        shared::overloaded{
+            [&](const ::network::AABB_Entity &aabb)
+            {
+              renderer::DrawWireAABB(cmd, aabb.position - aabb.half_extents,
+                                     aabb.position + aabb.half_extents,
+                                     0xFFFFFFFF);
+            },
+            [&](const ::network::Wedge_Entity &wedge)
+            {
+              shared::wedge_t w;
+              w.center = wedge.position;
+              w.half_extents = wedge.half_extents;
+              w.orientation = wedge.orientation;
+              renderer::draw_wedge(cmd, w, 0xFFFFFFFF);
+            },
+            [&](const ::network::Static_Mesh_Entity &mesh)
+            {
+              // No mesh in render component — draw placeholder AABB
+              auto bounds = shared::compute_entity_bounds(&mesh);
+              renderer::DrawWireAABB(cmd, bounds.min, bounds.max, 0xFF00FFFF);
+            },
+            [&](const ::network::Player_Entity &player)
+            {
+              const char *mesh_path = assets::get_mesh_path(2); // pyramid
+              if (mesh_path)
+              {
+                auto mesh_handle = assets::load_mesh(mesh_path);
+                if (mesh_handle.valid())
+                {
+                  renderer::DrawMeshWireframe(cmd, player.position, {1, 1, 1},
+                                              mesh_handle, 0xFFFFFFFF,
+                                              player.orientation);
+                }
+              }
+            },
+            [](const auto &) {}});
   }
 
   // Draw Tool Overlay
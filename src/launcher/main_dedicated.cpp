@@ -4,9 +4,7 @@
 #include "shared/log.hpp"
 #include "shared/timed_function.hpp"
 
-#include <chrono>
 #include <iostream>
-#include <thread>
 
 cvar::CVar<float> r_fov("r_fov", 90.0f, "Field of view in degrees");
 
@@ -29,13 +27,12 @@ int main(int argc, char *argv[])
   bool running = true;
   while (running)
   {
+    // Blocks on the socket until the next sv_tickrate deadline.
+    server::WaitForNextTick();
+
     // Run Server Logic
     server::Tick();
 
-    // In a real dedicated server, we'd sleep to maintain tickrate
-    // For now, sleep 16ms to avoid burning CPU in this loop
-    std::this_thread::sleep_for(std::chrono::milliseconds(16));
-
     // TODO: Handle signal handling for graceful shutdown (SIGINT)
     // For this demo, runs until killed or console closed.
   }
@@ -44,10 +44,12 @@ int main(int argc, char *argv[])
       running = false;
     }
 
-    // Run Server Tick (Game Logic)
-    // In a real scenario, this might run on a separate thread or at a fixed
-    // timestep
-    server::Tick();
+    // Run Server Tick (Game Logic) at sv_tickrate; the client frame rate
+    // paces this loop.
+    if (server::TickDue())
+    {
+      server::Tick();
+    }
   }
 
   log_terminal("=== Shutdown Initiated ===");
@@ -0,0 +1,24 @@
+#include "shared/map.hpp"
+
+#include <cstdio>
+
+// Converts a map between the text and binary formats:
+//   map_convert levels/start.map levels/start.bmap
+//   map_convert levels/start.bmap levels/start.map
+// The output is binary if its name ends in .bmap.
+int main(int argc, char *argv[])
+{
+  if (argc != 3)
+  {
+    std::fprintf(stderr, "usage: %s <from.map|.bmap> <to.map|.bmap>\n",
+                 argv[0]);
+    return 2;
+  }
+
+  if (!shared::convert_map(argv[1], argv[2]))
+  {
+    std::fprintf(stderr, "Could not convert %s to %s\n", argv[1], argv[2]);
+    return 1;
+  }
+  return 0;
+}
@@ -12,8 +12,18 @@
   #define GAME_SERVER_API __attribute__((visibility("default")))
 #endif
 
+#include "../shared/tick_scheduler.hpp"
+
 namespace server {
 GAME_SERVER_API bool Init();
 GAME_SERVER_API bool Tick();
 GAME_SERVER_API void Shutdown();
+
+// Fixed-timestep pacing at sv_tickrate.
+// WaitForNextTick blocks (on the socket, handling packets as they arrive)
+// until the next tick is due; use it in a loop that only runs the server.
+// TickDue is the non-blocking check for loops paced by something else.
+GAME_SERVER_API void WaitForNextTick();
+GAME_SERVER_API bool TickDue();
+GAME_SERVER_API shared::tick_stats_t GetTickStats();
 } // namespace server
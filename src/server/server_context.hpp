@@ -1,11 +1,35 @@
 #pragma once
 
 #include "../shared/game_session.hpp"
+#include "../shared/network/interest.hpp"
 #include "../shared/network/server_connection_state.hpp"
+#include "../shared/network/snapshot_builder.hpp"
+#include "../shared/network/snapshot_history.hpp"
+#include "../shared/network/snapshot_priority.hpp"
 
 namespace server
 {
 
+// Snapshot bookkeeping for one connected client.
+struct client_snapshot_state_t
+{
+  // What the client held after each recent tick.
+  network::Interest_Ring sent;
+  // Scratch for this tick's relevancy query.
+  std::vector<network::uint32> relevant;
+  std::vector<float> priority_rates;
+  // Bandwidth control.
+  network::Priority_Accumulator priorities;
+  network::Bandwidth_Budget bandwidth;
+
+  void reset()
+  {
+    sent.clear();
+    priorities.clear();
+    bandwidth.reset();
+  }
+};
+
 // 'Context' refers to the bundle of data required for the active game session
 // (entities, network state). This is distinct from 'State' (e.g. Initializing,
 // Running, Shutdown) which refers to the FSM state.
@@ -13,6 +37,21 @@ struct server_context_t
 {
   network::Server_Connection_State net;
   shared::game_session_t session;
+
+  // Current simulation tick; 0 until the first Tick() ran.
+  network::uint32 tick = 0;
+  // Recent world snapshots, the baselines for per-client deltas.
+  network::Snapshot_Ring snapshots;
+  // Which entities are relevant to which client, rebuilt every tick.
+  network::Relevancy_Index relevancy;
+  // Per slot, reset when a client connects.
+  std::array<client_snapshot_state_t, network::sv_max_player_count>
+      client_snapshots;
+  // Each slot's player entity; null_entity_id while the slot is free.
+  std::array<network::Entity_Id, network::sv_max_player_count>
+      player_entities{};
+  // Per-client snapshot payloads, built in parallel.
+  network::Snapshot_Builder snapshot_builder;
 };
 
 } // namespace server
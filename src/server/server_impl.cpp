@@ -10,17 +10,163 @@
 // a sharedcomponents.hpp) avoiding redefinition here. namespace game { ... }
 // block removed.
 // block removed.
+#include "network/bandwidth_profiler.hpp"
 #include "network/server_connection_state.hpp"
 #include "server_context.hpp"
+#include "task_system.hpp"
+#include "tick_scheduler.hpp"
 #include "timed_function.hpp"
 
 namespace server
 {
 
 cvar::CVar<float> sv_tickrate("sv_tickrate", 60.0f, "Server tick rate in Hz");
+cvar::CVar<int> sv_snapshot_workers(
+    "sv_snapshot_workers", 4,
+    "Worker threads that build client snapshots (0 = server thread only)");
+cvar::CVar<int> sv_relevancy(
+    "sv_relevancy", 1,
+    "Only send clients the entities near their player (0 = send everything)");
+cvar::CVar<float> sv_relevancy_radius(
+    "sv_relevancy_radius", 3000.0f,
+    "Relevancy radius for entity classes that do not set their own");
+cvar::CVar<float> sv_relevancy_behind_scale(
+    "sv_relevancy_behind_scale", 0.5f,
+    "Relevancy radius multiplier for entities behind the player");
+cvar::CVar<int> sv_net_profile(
+    "sv_net_profile", 0,
+    "Record snapshot bits per entity field; the report is logged at shutdown");
+cvar::CVar<int> sv_client_rate(
+    "sv_client_rate", 64000,
+    "Snapshot bytes per second per client (0 = unlimited, may fragment)");
 
 server_context_t g_state;
 network::Udp_Socket g_socket;
+Task_System g_tasks;
+shared::Tick_Scheduler g_scheduler;
+
+// Packets received while waiting for the next tick, processed in Tick().
+network::ServerInbox g_inbox;
+
+void log_tick_stats(const shared::tick_stats_t &stats)
+{
+  log_terminal("Tick stats @ {} Hz: {} ticks, {} late, {} skipped, lateness "
+               "mean {:.1f}us / stddev {:.1f}us / max {:.1f}us",
+               g_scheduler.tickrate(), stats.ticks, stats.late_ticks,
+               stats.skipped_ticks, stats.mean_lateness_us,
+               stats.stddev_lateness_us(), stats.max_lateness_us);
+}
+
+// Sends `snapshot` to every connected client: only the entities relevant to
+// it, each delta encoded against the copy that client holds as of the last
+// tick it acknowledged (or in full if that one has aged out of the history).
+// With sv_client_rate set, each client's snapshot fits its bandwidth budget
+// and one datagram; updates that do not fit wait by priority. The payloads
+// are built in parallel; sending happens after the join, in slot order.
+void send_snapshots(server_context_t &state,
+                    const network::snapshot_t &snapshot)
+{
+  timed_function();
+
+  std::vector<int> slots;
+  for (int slot = 0; slot < network::sv_max_player_count; ++slot)
+  {
+    if (state.net.player_slots[slot])
+      slots.push_back(slot);
+  }
+
+  if (slots.empty())
+    return;
+
+  // Where each client is looking from.
+  std::array<const network::Player_Entity *, network::sv_max_player_count>
+      viewers{};
+  if (auto *players =
+          state.session.entity_system.get_entities<network::Player_Entity>(
+              entity_type::PLAYER))
+  {
+    for (const auto &player : *players)
+    {
+      int slot = player.client_slot_index;
+      if (slot >= 0 && slot < network::sv_max_player_count)
+        viewers[slot] = &player;
+    }
+  }
+
+  bool cull = sv_relevancy.Get() != 0;
+  if (cull)
+  {
+    network::interest_settings_t settings;
+    settings.default_radius = sv_relevancy_radius.Get();
+    settings.behind_scale = sv_relevancy_behind_scale.Get();
+    state.relevancy.build(snapshot, state.session.entity_system, settings);
+  }
+
+  std::vector<network::Snapshot_Builder::Client> clients;
+  for (int slot : slots)
+  {
+    network::uint32 acked = state.net.last_acked_tick[slot];
+    client_snapshot_state_t &client_state = state.client_snapshots[slot];
+    network::Snapshot_Builder::Client client;
+    const network::snapshot_t *acked_snapshot = state.snapshots.find(acked);
+    const network::sent_view_t *acked_view = client_state.sent.find(acked);
+    if (acked_snapshot && acked_view)
+      client.baseline = acked_view->of(acked_snapshot);
+
+    std::vector<network::uint32> &relevant = client_state.relevant;
+    relevant.clear();
+    if (const network::Player_Entity *player = viewers[slot]; cull && player)
+    {
+      network::interest_viewer_t viewer;
+      viewer.origin = player->position;
+      viewer.forward = network::view_forward(player->view_angle_yaw,
+                                             player->view_angle_pitch);
+      viewer.entity = player->id;
+      state.relevancy.query(viewer, relevant, &client_state.priority_rates);
+      client.priority_rates = &client_state.priority_rates;
+    }
+    else
+    {
+      // Nothing to cull around: the client sees everything.
+      for (size_t i = 0; i < snapshot.entities.size(); ++i)
+        relevant.push_back(static_cast<network::uint32>(i));
+    }
+    client.visible = &relevant;
+
+    if (sv_client_rate.Get() > 0)
+    {
+      client.budget_bytes = client_state.bandwidth.begin_tick(
+          static_cast<float>(sv_client_rate.Get()), sv_tickrate.Get(),
+          network::max_snapshot_data_bytes);
+      client.priorities = &client_state.priorities;
+    }
+    client.sent = &client_state.sent.begin(snapshot.tick);
+    clients.push_back(client);
+  }
+
+  state.snapshot_builder.build(snapshot, clients, &state.snapshots,
+                               g_tasks.worker_count() ? &g_tasks : nullptr);
+
+  for (size_t i = 0; i < slots.size(); ++i)
+  {
+    const network::snapshot_t *baseline = clients[i].baseline.snapshot;
+    auto bytes = state.snapshot_builder.payload(i);
+    state.client_snapshots[slots[i]].bandwidth.spend(bytes.size());
+
+    game::S2C_EntityPackage package;
+    package.set_tick(snapshot.tick);
+    package.set_expected_max_entities(
+        static_cast<int>(clients[i].sent->visible.size()));
+    package.set_is_delta(baseline != nullptr);
+    package.set_update_baseline(baseline ? static_cast<int>(baseline->tick)
+                                         : 0);
+    package.set_entity_data(bytes.data(), bytes.size());
+
+    network::send_protobuf_message(g_socket, state.net.player_ips[slots[i]],
+                                   package,
+                                   static_cast<network::uint8>(snapshot.tick));
+  }
+}
 
 void handle_player_join(server_context_t &state, const network::Address &sender)
 {
@@ -47,11 +193,8 @@ void handle_player_join(server_context_t &state, const network::Address &sender)
   }
 
   // 3. Occupy slot
-  state.net.player_slots[slot] = true;
-  state.net.player_ips[slot] = sender;
-  // Clear buffers etc?
-  state.net.player_byte_buffers[slot] = {};
-  state.net.partial_packets[slot].clear();
+  network::connect_player(state.net, slot, sender);
+  state.client_snapshots[slot].reset();
 
   log_terminal("Player joined at slot {}: {}", slot, sender.to_string());
 
@@ -60,9 +203,9 @@ void handle_player_join(server_context_t &state, const network::Address &sender)
       entity_type::PLAYER);
   if (player)
   {
-    player->client_slot_index = slot;
-    // Set explicit spawn position?
-    player->position = {0, 0, 50}; // Debug spawn
+    player->set(player->client_slot_index, network::int32(slot));
+    player->set(player->position, {0, 0, 50}); // Debug spawn
+    state.player_entities[slot] = player->id;
   }
 }
 
@@ -74,22 +217,8 @@ void handle_player_leave(server_context_t &state,
     return;
 
   // 1. Despawn Entity
-  // We need to find the entity owned by this slot.
-  auto *pool = state.session.entity_system.get_entities<network::Player_Entity>(
-      entity_type::PLAYER);
-
-  if (pool)
-  {
-    // Iterate and find
-    for (size_t i = 0; i < pool->size(); ++i)
-    {
-      if ((*pool)[i].client_slot_index == slot)
-      {
-        state.session.entity_system.destroy(entity_type::PLAYER, &(*pool)[i]);
-        break;
-      }
-    }
-  }
+  state.session.entity_system.destroy(state.player_entities[slot]);
+  state.player_entities[slot] = network::null_entity_id;
 
   // 2. Free network slot
   network::disconnect_player(state.net, sender);
@@ -108,18 +237,22 @@ bool Init()
     return false;
   }
 
+  if (sv_snapshot_workers.Get() > 0)
+    g_tasks.initialize(static_cast<size_t>(sv_snapshot_workers.Get()));
+
   return true;
 }
 
 bool Tick()
 {
   timed_function();
-  // Server logic simulation
-  // In a real server, we'd sleep to maintain sv_tickrate
 
-  network::ServerInbox inbox;
-  network::poll_network(g_state.net, g_socket, 0.005,
-                        inbox); // 5ms receive window
+  network::Bandwidth_Profiler::get().set_enabled(sv_net_profile.Get() != 0);
+
+  // Pick up anything that arrived since the last wait.
+  network::drain_network(g_state.net, g_socket, g_inbox);
+  network::ServerInbox inbox = std::move(g_inbox);
+  g_inbox = {};
 
   // Handle Net Commands (Handshake)
   for (const auto &[sender, cmd] : inbox.net_commands)
@@ -147,10 +280,9 @@ bool Tick()
       if (slot != -1)
       {
         // Accept
-        g_state.net.player_slots[slot] = true;
-        g_state.net.player_ips[slot] = sender;
-        g_state.net.player_byte_buffers[slot] = {};
-        g_state.net.partial_packets[slot].clear();
+        network::uint16 token = network::connect_player(g_state.net, slot,
+                                                        sender);
+        g_state.client_snapshots[slot].reset();
 
         log_terminal("Player {} joined at slot {}", cmd.connect().player_name(),
                      slot);
@@ -161,8 +293,9 @@ bool Tick()
                 entity_type::PLAYER);
         if (player)
         {
-          player->client_slot_index = slot;
-          player->position = {0, 0, 50};
+          player->set(player->client_slot_index, network::int32(slot));
+          player->set(player->position, {0, 0, 50});
+          g_state.player_entities[slot] = player->id;
         }
 
         // Send Accept
@@ -172,15 +305,10 @@ bool Tick()
         accept->set_map_name(g_state.session.map_name.empty()
                                  ? "start.map"
                                  : g_state.session.map_name);
-        accept->set_server_tickrate(60);
-
-        std::vector<network::uint8> buffer(reply.ByteSizeLong());
-        reply.SerializeToArray(buffer.data(), static_cast<int>(buffer.size()));
-        auto packets = network::convert_to_packets(
-            buffer,
-            static_cast<network::uint8>(network::Message_Type::NetCommand));
-        for (const auto &p : packets)
-          g_socket.send(p, sender);
+        accept->set_server_tickrate(static_cast<int>(sv_tickrate.Get()));
+        accept->set_connection_token(token);
+
+        network::send_protobuf_message(g_socket, sender, reply);
       }
       else
       {
@@ -190,6 +318,18 @@ bool Tick()
         // Send reject...
       }
     }
+    else if (cmd.has_snapshot_ack())
+    {
+      int slot = network::get_player_idx(g_state.net, sender);
+      if (slot == -1)
+        continue;
+      // Acks can arrive out of order; only move forward, and never past a
+      // tick we actually sent.
+      network::uint32 tick = cmd.snapshot_ack().tick();
+      auto &acked = g_state.net.last_acked_tick[slot];
+      if (tick > acked && tick <= g_state.tick)
+        acked = tick;
+    }
   }
 
   // Handle Joins (Legacy / Unknown packet from unknown IP?)
@@ -216,16 +356,80 @@ bool Tick()
     (void)tm;
   }
 
-  // Propagate state (Placeholder)
-  // network::propagate_state(g_server_state, g_socket);
+  // Apply each player's usercmds in order. Only the view angles are used;
+  // the server does not simulate movement.
+  if (auto *players =
+          g_state.session.entity_system.get_entities<network::Player_Entity>(
+              entity_type::PLAYER))
+  {
+    for (auto &player : *players)
+    {
+      int slot = player.client_slot_index;
+      if (slot < 0 || slot >= network::sv_max_player_count ||
+          !g_state.net.player_slots[slot])
+        continue;
+      while (const network::usercmd_t *cmd = g_state.net.usercmds[slot].next())
+      {
+        player.set(player.view_angle_yaw, network::angle_to_degrees(cmd->yaw));
+        player.set(player.view_angle_pitch,
+                   network::angle_to_degrees(cmd->pitch));
+      }
+    }
+  }
+
+  // Everything that moves entities has run; pack their transforms once for
+  // the passes that only need positions (relevancy).
+  g_state.session.entity_system.sync_transforms();
+
+  g_state.tick += 1;
+  network::snapshot_t &snapshot = g_state.snapshots.begin(g_state.tick);
+  network::capture_snapshot(g_state.session.entity_system, snapshot);
+  send_snapshots(g_state, snapshot);
 
   return true;
 }
 
+void WaitForNextTick()
+{
+  g_scheduler.set_tickrate(sv_tickrate.Get());
+  g_scheduler.wait_for_next_tick(
+      [](double timeout_seconds)
+      {
+        if (g_socket.wait_readable(timeout_seconds))
+          network::drain_network(g_state.net, g_socket, g_inbox);
+      });
+}
+
+bool TickDue()
+{
+  g_scheduler.set_tickrate(sv_tickrate.Get());
+  return g_scheduler.consume_due_tick();
+}
+
+shared::tick_stats_t GetTickStats() { return g_scheduler.stats(); }
+
 void Shutdown()
 {
   timed_function();
   log_terminal("--- Shutting down Server ---");
+  log_tick_stats(g_scheduler.stats());
+
+  const auto &cache_stats = g_state.snapshot_builder.stats();
+  log_terminal("Snapshot encode cache: {} lookups, {:.1f}% hits",
+               cache_stats.lookups, cache_stats.hit_rate() * 100.0);
+
+  const auto &pool_stats = g_state.net.buffer_pool.stats();
+  log_terminal("Connection buffers: {} KB in use, {} KB pooled, peak {} KB",
+               pool_stats.bytes_in_use / 1024, pool_stats.bytes_pooled / 1024,
+               pool_stats.peak_bytes_in_use / 1024);
+  log_terminal("Unknown senders: {} packets dropped by the rate limit",
+               g_state.net.unknown_senders.dropped_count());
+
+  const auto &profiler = network::Bandwidth_Profiler::get();
+  if (!profiler.rows().empty())
+    log_terminal("Snapshot bandwidth by field:\n{}", profiler.report());
+
+  g_tasks.shutdown();
 }
 
 } // namespace server
@@ -12,30 +12,68 @@
 // =============================================================================
 // To add a new entity type:
 // 1. Add the #include for your entity in the block above (inside #ifdef).
-// 2. Add an entry to the macro below:
+// 2. Add an entry to SHARED_ENTITIES_LIST in entities/entity_type.hpp:
 //    X(ENUM_NAME, Namespace::Class_Name, "string_classname", "path/ignored")
 // 3. Make sure to declare schemas in your entity class using DECLARE_SCHEMA.
+// 4. Put DECLARE_ENTITY_TYPE(Class_Name, ENUM_NAME) in the class, so that
+//    Entity::type is set when one is constructed.
 // =============================================================================
 
-// X(EnumName, ClassName, StringName, HeaderPath)
-#define SHARED_ENTITIES_LIST(X)                                                \
-  X(PLAYER, network::Player_Entity, "player_start",                            \
-    "entities/player_entity.hpp")                                              \
-  X(WEAPON, network::Weapon_Entity, "weapon_basic",                            \
-    "entities/weapon_entity.hpp")                                              \
-  X(AABB, network::AABB_Entity, "aabb_entity", "entities/static_entities.hpp") \
-  X(WEDGE, network::Wedge_Entity, "wedge_entity",                              \
-    "entities/static_entities.hpp")                                            \
-  X(STATIC_MESH, network::Static_Mesh_Entity, "static_mesh_entity",            \
-    "entities/static_entities.hpp")
-
-// we override the x macro from st get the enum name.
-#define ENUM_NAME(enum_name, class_name, str_name, header) enum_name,
-enum class entity_type
+#include "entity_type.hpp"
+
+#endif // SHARED_ENTITY_LIST_HPP
+
+// With the entity classes available: dispatch on Entity::type.
+#if defined(ENTITIES_WANT_INCLUDES) && !defined(SHARED_ENTITY_VISIT_HPP)
+#define SHARED_ENTITY_VISIT_HPP
+
+#include <type_traits>
+
+namespace shared
+{
+
+// Builds one callable out of several lambdas, for visit_entity.
+template <typename... Fns> struct overloaded : Fns...
 {
-  UNKNOWN = 0,
-  SHARED_ENTITIES_LIST(ENUM_NAME) COUNT
+  using Fns::operator()...;
 };
-#undef ENUM_NAME
 
-#endif // SHARED_ENTITY_LIST_HPP
+namespace entity_detail
+{
+// T, const if From is.
+template <typename From, typename T>
+using like_t = std::conditional_t<std::is_const_v<From>, const T, T>;
+} // namespace entity_detail
+
+// Calls fn with `entity` as its own class (the one entity.type names), or
+// as a network::Entity if that is not a class of SHARED_ENTITIES_LIST.
+// Costs one switch on the tag rather than a dynamic_cast per class tried:
+//
+//   shared::visit_entity(*ent, shared::overloaded{
+//       [&](const network::AABB_Entity &aabb) { ... },
+//       [&](const network::Wedge_Entity &wedge) { ... },
+//       [&](const auto &) {}});
+template <typename Entity_T, typename Fn>
+decltype(auto) visit_entity(Entity_T &entity, Fn &&fn)
+{
+  static_assert(
+      std::is_same_v<std::remove_const_t<Entity_T>, network::Entity>,
+      "visit_entity takes a network::Entity");
+  switch (entity.type)
+  {
+#define VISIT_GEN(enum_name, class_name, str_name, header_path)                \
+  case entity_type::enum_name:                                                 \
+    return fn(                                                                 \
+        static_cast<entity_detail::like_t<Entity_T, class_name> &>(entity));
+
+    SHARED_ENTITIES_LIST(VISIT_GEN)
+#undef VISIT_GEN
+
+  default:
+    return fn(entity);
+  }
+}
+
+} // namespace shared
+
+#endif // SHARED_ENTITY_VISIT_HPP
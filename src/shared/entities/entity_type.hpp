@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// The list of shared entity classes and the entity_type enum generated from
+// it. Kept apart from entity_list.hpp (which also pulls in the entity
+// headers) so that entity.hpp can use the enum for Entity::type.
+
+// X(EnumName, ClassName, StringName, HeaderPath)
+#define SHARED_ENTITIES_LIST(X)                                                \
+  X(PLAYER, network::Player_Entity, "player_start",                            \
+    "entities/player_entity.hpp")                                              \
+  X(WEAPON, network::Weapon_Entity, "weapon_basic",                            \
+    "entities/weapon_entity.hpp")                                              \
+  X(AABB, network::AABB_Entity, "aabb_entity", "entities/static_entities.hpp") \
+  X(WEDGE, network::Wedge_Entity, "wedge_entity",                              \
+    "entities/static_entities.hpp")                                            \
+  X(STATIC_MESH, network::Static_Mesh_Entity, "static_mesh_entity",            \
+    "entities/static_entities.hpp")
+
+// we override the x macro from st get the enum name.
+// One byte: it is stored in every entity and sent as the 8-bit class id.
+#define ENUM_NAME(enum_name, class_name, str_name, header) enum_name,
+enum class entity_type : uint8_t
+{
+  UNKNOWN = 0,
+  SHARED_ENTITIES_LIST(ENUM_NAME) COUNT
+};
+#undef ENUM_NAME
@@ -6,6 +6,8 @@ namespace network
 DEFINE_SCHEMA_CLASS(Player_Entity, Entity)
 {
   BEGIN_SCHEMA_FIELDS()
+  SCHEMA_PRIORITY(2.0f); // ahead of props when bandwidth is tight
+  SCHEMA_TRACK_CHANGES();
   REGISTER_SCHEMA_FIELD(view_angle_yaw);
   REGISTER_SCHEMA_FIELD(view_angle_pitch);
   REGISTER_SCHEMA_FIELD(health);
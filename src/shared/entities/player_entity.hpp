@@ -8,20 +8,25 @@ namespace network
 class Player_Entity : public Entity
 {
 public:
-  SCHEMA_FIELD(float32, view_angle_yaw,
-               Schema_Flags::Networked | Schema_Flags::Editable);
-  SCHEMA_FIELD(float32, view_angle_pitch,
-               Schema_Flags::Networked | Schema_Flags::Editable);
+  // Same precision as the usercmds they come from.
+  SCHEMA_FIELD_QUANTIZED(float32, view_angle_yaw,
+                         Schema_Flags::Networked | Schema_Flags::Editable,
+                         quantize_angle(16));
+  SCHEMA_FIELD_QUANTIZED(float32, view_angle_pitch,
+                         Schema_Flags::Networked | Schema_Flags::Editable,
+                         quantize_angle(16));
 
   SCHEMA_FIELD(int32, health, Schema_Flags::Networked | Schema_Flags::Editable);
   SCHEMA_FIELD(int32, ammo, Schema_Flags::Networked | Schema_Flags::Editable);
   SCHEMA_FIELD(int32, active_weapon_id, Schema_Flags::Networked);
-  SCHEMA_FIELD(int32, client_slot_index, Schema_Flags::Networked);
+  SCHEMA_FIELD_QUANTIZED(int32, client_slot_index, Schema_Flags::Networked,
+                         quantize_range(-1, sv_max_player_count - 1, 1));
 
   SCHEMA_FIELD(render_component_t, render,
                Schema_Flags::Networked | Schema_Flags::Editable);
 
   DECLARE_SCHEMA(Player_Entity)
+  DECLARE_ENTITY_TYPE(Player_Entity, PLAYER)
 };
 
 } // namespace network
@@ -7,6 +7,7 @@ namespace network
 DEFINE_SCHEMA_CLASS(AABB_Entity, Entity)
 {
   BEGIN_SCHEMA_FIELDS()
+  SCHEMA_RELEVANCY(Never, 0.0f); // part of the map, never replicated
   REGISTER_SCHEMA_FIELD(half_extents);
   REGISTER_SCHEMA_FIELD(render);
   END_SCHEMA_FIELDS()
@@ -16,6 +17,7 @@ DEFINE_SCHEMA_CLASS(AABB_Entity, Entity)
 DEFINE_SCHEMA_CLASS(Wedge_Entity, Entity)
 {
   BEGIN_SCHEMA_FIELDS()
+  SCHEMA_RELEVANCY(Never, 0.0f); // part of the map, never replicated
   REGISTER_SCHEMA_FIELD(half_extents);
   REGISTER_SCHEMA_FIELD(orientation);
   REGISTER_SCHEMA_FIELD(render);
@@ -26,6 +28,7 @@ DEFINE_SCHEMA_CLASS(Wedge_Entity, Entity)
 DEFINE_SCHEMA_CLASS(Static_Mesh_Entity, Entity)
 {
   BEGIN_SCHEMA_FIELDS()
+  SCHEMA_RELEVANCY(Never, 0.0f);
   REGISTER_SCHEMA_FIELD(render);
   END_SCHEMA_FIELDS()
 }
@@ -16,6 +16,7 @@ public:
                Schema_Flags::Networked | Schema_Flags::Editable);
 
   DECLARE_SCHEMA(AABB_Entity)
+  DECLARE_ENTITY_TYPE(AABB_Entity, AABB)
 };
 
 class Wedge_Entity : public Entity
@@ -30,6 +31,7 @@ public:
                Schema_Flags::Networked | Schema_Flags::Editable);
 
   DECLARE_SCHEMA(Wedge_Entity)
+  DECLARE_ENTITY_TYPE(Wedge_Entity, WEDGE)
 };
 
 class Static_Mesh_Entity : public Entity
@@ -39,6 +41,7 @@ public:
                Schema_Flags::Networked | Schema_Flags::Editable);
 
   DECLARE_SCHEMA(Static_Mesh_Entity)
+  DECLARE_ENTITY_TYPE(Static_Mesh_Entity, STATIC_MESH)
 };
 
 } // namespace network
@@ -6,6 +6,8 @@ namespace network
 DEFINE_SCHEMA_CLASS(Weapon_Entity, Entity)
 {
   BEGIN_SCHEMA_FIELDS()
+  SCHEMA_RELEVANCY(Radius, 1500.0f); // small, not worth sending from afar
+  SCHEMA_TRACK_CHANGES();
   REGISTER_SCHEMA_FIELD(ammo);
   REGISTER_SCHEMA_FIELD(active_weapon_id);
   REGISTER_SCHEMA_FIELD(render);
@@ -15,6 +15,7 @@ public:
                Schema_Flags::Networked | Schema_Flags::Editable);
 
   DECLARE_SCHEMA(Weapon_Entity)
+  DECLARE_ENTITY_TYPE(Weapon_Entity, WEAPON)
 };
 
 } // namespace network
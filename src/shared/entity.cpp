@@ -1,140 +1,131 @@
 #include "entity.hpp"
+#include "network/bandwidth_profiler.hpp"
 #include "network/quantization.hpp"
+#include <algorithm>
+#include <bit>
 #include <cstring>
 #include <iostream>
 
 namespace network
 {
 
+Field_Mask changed_field_mask(const Class_Schema *schema, const uint8 *a,
+                              const uint8 *b)
+{
+  return schema->diff_layout.changed_fields(a, b);
+}
+
+void serialize_fields(Bit_Writer &writer, const Class_Schema *schema,
+                      const uint8 *current_base, const uint8 *baseline_base)
+{
+  // With no baseline (a new entity) everything counts as changed.
+  Field_Mask changed =
+      baseline_base
+          ? changed_field_mask(schema, current_base, baseline_base)
+          : all_fields_mask(schema->fields.size());
+  serialize_changed_fields(writer, schema, current_base, changed);
+}
+
+void serialize_changed_fields(Bit_Writer &writer, const Class_Schema *schema,
+                              const uint8 *current_base, Field_Mask changed,
+                              std::vector<field_bits_t> *profile)
+{
+  size_t num_fields = schema->fields.size();
+  changed &= all_fields_mask(num_fields);
+
+  Bandwidth_Profiler::Class_Counters *counters =
+      profile ? &Bandwidth_Profiler::get().counters_for(schema) : nullptr;
+
+  // 1. Write Mask, field 0 first
+  writer.write_bits64(changed, static_cast<int>(num_fields));
+  if (profile)
+    profile->push_back({counters, static_cast<uint32>(num_fields),
+                        static_cast<uint32>(num_fields)});
+
+  // 2. Write Data, one codec call per changed field
+  for (Field_Mask rest = changed; rest; rest &= rest - 1)
+  {
+    size_t i = static_cast<size_t>(std::countr_zero(rest));
+    const Field_Codec &codec = schema->codecs[i];
+    size_t field_start = writer.bits_written();
+    codec.write(writer, current_base + codec.offset, codec.quantization);
+    if (profile)
+      profile->push_back(
+          {counters, static_cast<uint32>(i),
+           static_cast<uint32>(writer.bits_written() - field_start)});
+  }
+}
+
+bool fields_differ(const Class_Schema *schema, const uint8 *a, const uint8 *b)
+{
+  return schema->diff_layout.differs(a, b);
+}
+
+void Entity::mark_changed(const void *field)
+{
+  const Class_Schema *schema = get_schema();
+  size_t offset = static_cast<const uint8 *>(field) -
+                  reinterpret_cast<const uint8 *>(this);
+  Field_Mask mask = schema ? schema->fields_at_offset(offset) : 0;
+  // Not a schema field by itself (e.g. one member of a vec3f): we cannot
+  // tell which field it belongs to cheaply, so assume all of them.
+  changed_fields |= mask ? mask : ~Field_Mask(0);
+}
+
 void Entity::serialize(Bit_Writer &writer, const Entity *baseline) const
 {
   const Class_Schema *schema = get_schema();
   if (!schema)
     return;
 
-  // 1. Calculate Mask
-  // We need to know which fields changed.
-  // The user said: "write the BITMASK".
-  // This implies a bitmask of size = number of fields.
-  // We can write it as N bits.
+  serialize_fields(writer, schema, reinterpret_cast<const uint8 *>(this),
+                   reinterpret_cast<const uint8 *>(baseline));
+}
 
-  const uint8 *current_base = reinterpret_cast<const uint8 *>(this);
-  const uint8 *baseline_base =
-      baseline ? reinterpret_cast<const uint8 *>(baseline) : nullptr;
+namespace
+{
 
-  size_t num_fields = schema->fields.size();
-  std::vector<bool> changed_flags(num_fields, false);
+void set_property(Entity &entity, const Class_Schema &schema,
+                  std::string_view key, std::string_view value,
+                  bool has_position)
+{
+  // Backward compat: old maps store "center" for AABB/Wedge entities,
+  // now consolidated into the inherited "position" field.
+  if (key == "center" && !has_position)
+    key = "position";
 
-  for (size_t i = 0; i < num_fields; ++i)
+  uint8 *base = reinterpret_cast<uint8 *>(&entity);
+  for (uint16_t index : schema.find_fields(key))
   {
-    const auto &field = schema->fields[i];
-    if (baseline_base)
-    {
-      if (std::memcmp(current_base + field.offset, baseline_base + field.offset,
-                      field.size) != 0)
-      {
-        changed_flags[i] = true;
-      }
-    }
-    else
-    {
-      // specific logic: if baseline is null, do we mark everything as changed?
-      // "Scenario 1: Full Update (New Entity) ... Everything is considered
-      // changed"
-      changed_flags[i] = true;
-    }
+    const Field_Prop &field = schema.fields[index];
+    parse_string_to_field(value, field.type, base + field.offset);
   }
+}
 
-  // 2. Write Mask
-  for (bool changed : changed_flags)
-  {
-    writer.write_bit(changed);
-  }
+} // namespace
 
-  // 3. Write Data
-  for (size_t i = 0; i < num_fields; ++i)
-  {
-    if (changed_flags[i])
-    {
-      const auto &field = schema->fields[i];
-      // Use quantization functions
-      switch (field.type)
-      {
-      case Field_Type::Int32:
-      {
-        int32_t val =
-            *reinterpret_cast<const int32_t *>(current_base + field.offset);
-        write_var_int(writer, val);
-        break;
-      }
-      case Field_Type::Float32:
-      {
-        float val =
-            *reinterpret_cast<const float *>(current_base + field.offset);
-        write_coord(writer, val);
-        break;
-      }
-      case Field_Type::Bool:
-      {
-        bool val = *reinterpret_cast<const bool *>(current_base + field.offset);
-        writer.write_bit(val);
-        break;
-      }
-      case Field_Type::Vec3f:
-      {
-        // Vec3f usually has 3 floats.
-        // Assuming network::vec3f or similar structure.
-        // The type is not standard, let's look at `network_types.hpp` or assume
-        // `struct { x,y,z }` We can just cast to float* and write 3 coords?
-        // Let's verify structure size.
-        // If field.size == 12 (3 * 4), safe to assume 3 floats.
-        const float *vals =
-            reinterpret_cast<const float *>(current_base + field.offset);
-        write_coord(writer, vals[0]);
-        write_coord(writer, vals[1]);
-        write_coord(writer, vals[2]);
-        break;
-      }
-      case Field_Type::PascalString:
-      {
-        const auto *ps =
-            reinterpret_cast<const pascal_string *>(current_base + field.offset);
-        writer.write_bits(ps->length, 8);
-        for (uint8 i = 0; i < ps->length; ++i)
-          writer.write_bits(static_cast<uint8>(ps->data[i]), 8);
-        break;
-      }
-      case Field_Type::RenderComponent:
-      {
-        const auto *rc = reinterpret_cast<const render_component_t *>(
-            current_base + field.offset);
-        write_var_int(writer, rc->mesh_id);
-        // pascal_string sub-field
-        writer.write_bits(rc->mesh_path.length, 8);
-        for (uint8 i = 0; i < rc->mesh_path.length; ++i)
-          writer.write_bits(static_cast<uint8>(rc->mesh_path.data[i]), 8);
-        writer.write_bit(rc->visible);
-        writer.write_bit(rc->is_wireframe);
-        // offset
-        write_coord(writer, rc->offset.x);
-        write_coord(writer, rc->offset.y);
-        write_coord(writer, rc->offset.z);
-        // scale
-        write_coord(writer, rc->scale.x);
-        write_coord(writer, rc->scale.y);
-        write_coord(writer, rc->scale.z);
-        // rotation
-        write_coord(writer, rc->rotation.x);
-        write_coord(writer, rc->rotation.y);
-        write_coord(writer, rc->rotation.z);
-        break;
-      }
-      default:
-        assert(false && "Unknown field type");
-        break;
-      }
-    }
-  }
+void Entity::init_from_map(const std::map<std::string, std::string> &props)
+{
+  const Class_Schema *schema = get_schema();
+  if (!schema)
+    return;
+
+  bool has_position = props.count("position") != 0;
+  for (const auto &[key, value] : props)
+    set_property(*this, *schema, key, value, has_position);
+}
+
+void Entity::init_from_properties(std::span<const map_property_t> props)
+{
+  const Class_Schema *schema = get_schema();
+  if (!schema)
+    return;
+
+  bool has_position = std::any_of(props.begin(), props.end(),
+                                  [](const map_property_t &property)
+                                  { return property.key == "position"; });
+  for (const map_property_t &property : props)
+    set_property(*this, *schema, property.key, property.value, has_position);
 }
 
 std::map<std::string, std::string> Entity::get_all_properties() const
@@ -163,94 +154,23 @@ void Entity::deserialize(Bit_Reader &reader)
   if (!schema)
     return;
 
-  uint8 *current_base = reinterpret_cast<uint8 *>(this);
+  deserialize_fields(reader, schema, reinterpret_cast<uint8 *>(this));
+}
+
+void deserialize_fields(Bit_Reader &reader, const Class_Schema *schema,
+                        uint8 *current_base)
+{
   size_t num_fields = schema->fields.size();
-  std::vector<bool> changed_flags(num_fields);
 
   // 1. Read Mask
-  for (size_t i = 0; i < num_fields; ++i)
-  {
-    changed_flags[i] = reader.read_bit();
-  }
+  Field_Mask changed = reader.read_bits64(static_cast<int>(num_fields));
 
   // 2. Read Data
-  for (size_t i = 0; i < num_fields; ++i)
+  for (Field_Mask rest = changed; rest; rest &= rest - 1)
   {
-    if (changed_flags[i])
-    {
-      const auto &field = schema->fields[i];
-      switch (field.type)
-      {
-      case Field_Type::Int32:
-      {
-        int32_t val = read_var_int(reader);
-        std::memcpy(current_base + field.offset, &val, sizeof(val));
-        break;
-      }
-      case Field_Type::Float32:
-      {
-        float val = read_coord(reader);
-        std::memcpy(current_base + field.offset, &val, sizeof(val));
-        break;
-      }
-      case Field_Type::Bool:
-      {
-        bool val = reader.read_bit();
-        std::memcpy(current_base + field.offset, &val, sizeof(val));
-        break;
-      }
-      case Field_Type::Vec3f:
-      {
-        float vals[3];
-        vals[0] = read_coord(reader);
-        vals[1] = read_coord(reader);
-        vals[2] = read_coord(reader);
-        std::memcpy(current_base + field.offset, vals, sizeof(vals));
-        break;
-      }
-      case Field_Type::PascalString:
-      {
-        auto *ps =
-            reinterpret_cast<pascal_string *>(current_base + field.offset);
-        ps->length = static_cast<uint8>(reader.read_bits(8));
-        for (uint8 j = 0; j < ps->length; ++j)
-          ps->data[j] = static_cast<char>(reader.read_bits(8));
-        if (ps->length < ps->max_length())
-          ps->data[ps->length] = '\0';
-        break;
-      }
-      case Field_Type::RenderComponent:
-      {
-        auto *rc = reinterpret_cast<render_component_t *>(
-            current_base + field.offset);
-        rc->mesh_id = read_var_int(reader);
-        // pascal_string sub-field
-        rc->mesh_path.length = static_cast<uint8>(reader.read_bits(8));
-        for (uint8 j = 0; j < rc->mesh_path.length; ++j)
-          rc->mesh_path.data[j] = static_cast<char>(reader.read_bits(8));
-        if (rc->mesh_path.length < rc->mesh_path.max_length())
-          rc->mesh_path.data[rc->mesh_path.length] = '\0';
-        rc->visible = reader.read_bit();
-        rc->is_wireframe = reader.read_bit();
-        // offset
-        rc->offset.x = read_coord(reader);
-        rc->offset.y = read_coord(reader);
-        rc->offset.z = read_coord(reader);
-        // scale
-        rc->scale.x = read_coord(reader);
-        rc->scale.y = read_coord(reader);
-        rc->scale.z = read_coord(reader);
-        // rotation
-        rc->rotation.x = read_coord(reader);
-        rc->rotation.y = read_coord(reader);
-        rc->rotation.z = read_coord(reader);
-        break;
-      }
-      default:
-        assert(false && "Unknown field type");
-        break;
-      }
-    }
+    const Field_Codec &codec =
+        schema->codecs[static_cast<size_t>(std::countr_zero(rest))];
+    codec.read(reader, current_base + codec.offset, codec.quantization);
   }
 }
 
@@ -261,6 +181,7 @@ void Entity::deserialize(Bit_Reader &reader)
 // schema registration (avoiding static init order issues across TUs).
 void network::Entity::register_schema()
 {
+  network::register_entity_schemas();
   static bool registered = false;
   if (registered)
     return;
@@ -276,7 +197,8 @@ void network::Entity::register_schema()
                    offsetof(network::Entity, position),
                    network::Entity::_schema_meta_position.size,
                    network::Entity::_schema_meta_position.type,
-                   network::Entity::_schema_meta_position.flags});
+                   network::Entity::_schema_meta_position.flags,
+                   network::Entity::_schema_meta_position.quantization});
 
   static_assert(
       std::is_trivially_copyable_v<decltype(network::Entity::orientation)>,
@@ -286,7 +208,8 @@ void network::Entity::register_schema()
                    offsetof(network::Entity, orientation),
                    network::Entity::_schema_meta_orientation.size,
                    network::Entity::_schema_meta_orientation.type,
-                   network::Entity::_schema_meta_orientation.flags});
+                   network::Entity::_schema_meta_orientation.flags,
+                   network::Entity::_schema_meta_orientation.quantization});
 
   network::Schema_Registry::get().register_class("Entity", props);
 }
@@ -294,6 +217,26 @@ void network::Entity::register_schema()
 #define ENTITIES_WANT_INCLUDES
 #include "entities/entity_list.hpp"
 
+void network::register_entity_schemas()
+{
+  static bool registered = false;
+  if (registered)
+    return;
+  registered = true;
+
+  // Entity takes id 0, which lines up with entity_type::UNKNOWN.
+  Entity::register_schema();
+#define X(ENUM, CLASS, NAME, PATH)                                             \
+  static_assert(CLASS::static_type == entity_type::ENUM,                       \
+                "DECLARE_ENTITY_TYPE does not match SHARED_ENTITIES_LIST");    \
+  CLASS::register_schema();                                                    \
+  assert(Schema_Registry::get().get_schema(uint16_t(entity_type::ENUM)) ==     \
+             CLASS{}.get_schema() &&                                           \
+         "Entity class registered before register_entity_schemas()");
+  SHARED_ENTITIES_LIST(X)
+#undef X
+}
+
 namespace shared
 {
 
@@ -310,12 +253,18 @@ create_entity_by_classname(const std::string &classname)
 
 std::string get_classname_for_entity(const network::Entity *entity)
 {
+  if (!entity)
+    return "unknown";
+  switch (entity->type)
+  {
 #define X(ENUM, CLASS, NAME, PATH)                                             \
-  if (dynamic_cast<const CLASS *>(entity))                                     \
+  case entity_type::ENUM:                                                      \
     return NAME;
-  SHARED_ENTITIES_LIST(X)
+    SHARED_ENTITIES_LIST(X)
 #undef X
-  return "unknown";
+  default:
+    return "unknown";
+  }
 }
 
 } // namespace shared
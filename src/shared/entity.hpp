@@ -1,5 +1,6 @@
 #pragma once
 
+#include "entities/entity_type.hpp"
 #include "network/bitstream.hpp"
 #include "network/network_types.hpp"
 #include "network/schema.hpp"
@@ -7,7 +8,10 @@
 #include <cstring>
 #include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace network
 {
@@ -22,24 +26,60 @@ struct Entity_Id
 
 inline constexpr Entity_Id null_entity_id = {0, 0};
 
+// One "key" "value" pair of a map file entity.
+struct map_property_t
+{
+  std::string_view key;
+  std::string_view value;
+};
+
 class Entity
 {
 public:
   Entity_Id id = null_entity_id;
-  SCHEMA_FIELD(vec3f, position,
-               Schema_Flags::Networked | Schema_Flags::Editable);
-  SCHEMA_FIELD(vec3f, orientation,
-               Schema_Flags::Networked | Schema_Flags::Editable);
+  // The entity's class, for classifying entities without RTTI (see
+  // entity_cast and shared::visit_entity). Set by DECLARE_ENTITY_TYPE;
+  // UNKNOWN for classes outside SHARED_ENTITIES_LIST.
+  entity_type type = entity_type::UNKNOWN;
+  // 1/32 unit steps, as write_coord had.
+  SCHEMA_FIELD_QUANTIZED(vec3f, position,
+                         Schema_Flags::Networked | Schema_Flags::Editable,
+                         quantize_position(1.0f / 32.0f));
+  // Euler angles in degrees.
+  SCHEMA_FIELD_QUANTIZED(vec3f, orientation,
+                         Schema_Flags::Networked | Schema_Flags::Editable,
+                         quantize_angle(16));
+
+  // Change tracking, for classes with SCHEMA_TRACK_CHANGES. set() marks
+  // fields here; capture_snapshot() hands them to the snapshot and clears
+  // them.
+  Field_Mask changed_fields = 0; // set since the last capture
+  uint32 last_changed_tick = 0;  // last capture that saw a change
+  uint32 last_captured_tick = 0;
 
   virtual ~Entity() = default;
 
+  // Assigns a schema field (`field` must be a member of this entity) and
+  // marks it changed if the value differs.
+  template <typename T> void set(T &field, const T &value)
+  {
+    if (std::memcmp(&field, &value, sizeof(T)) == 0)
+      return;
+    field = value;
+    mark_changed(&field);
+  }
+
+  // For fields written in place: marks the field starting at `field`.
+  void mark_changed(const void *field);
+
   // Register the Entity base class schema (called on-demand by derived schemas)
   static void register_schema();
 
   // Macro required in every derived class to register schema
   virtual const Class_Schema *get_schema() const = 0;
 
-  // Look up a component by type using the schema system.
+  // Look up a component by type using the schema system: the first field of
+  // type T, from the class's offset table.
   // Returns nullptr if the entity doesn't have a field of type T.
   template <typename T>
   const T *get_component() const
@@ -47,13 +87,11 @@ public:
     const Class_Schema *schema = get_schema();
     if (!schema) return nullptr;
     constexpr Field_Type expected = Schema_Type_Info<T>::type;
-    for (const auto &field : schema->fields)
-    {
-      if (field.type == expected)
-        return reinterpret_cast<const T *>(
-            reinterpret_cast<const uint8_t *>(this) + field.offset);
-    }
-    return nullptr;
+    int32_t offset = schema->component_offsets[static_cast<size_t>(expected)];
+    if (offset < 0)
+      return nullptr;
+    return reinterpret_cast<const T *>(
+        reinterpret_cast<const uint8_t *>(this) + offset);
   }
 
   template <typename T>
@@ -63,31 +101,12 @@ public:
         const_cast<const Entity *>(this)->get_component<T>());
   }
 
-  virtual void init_from_map(const std::map<std::string, std::string> &props)
-  {
-    const Class_Schema *schema = get_schema();
-    if (!schema)
-      return;
-
-    uint8 *current_base = reinterpret_cast<uint8 *>(this);
-
-    for (const auto &[key, value] : props)
-    {
-      // Backward compat: old maps store "center" for AABB/Wedge entities,
-      // now consolidated into the inherited "position" field.
-      std::string field_name = key;
-      if (key == "center" && !props.count("position"))
-        field_name = "position";
-
-      for (const auto &field : schema->fields)
-      {
-        if (field.name == field_name)
-        {
-          parse_string_to_field(value, field.type, current_base + field.offset);
-        }
-      }
-    }
-  }
+  // Sets the schema fields named by `props` from their text values (see
+  // parse_string_to_field); unknown keys are ignored.
+  virtual void init_from_map(const std::map<std::string, std::string> &props);
+  // The same for properties that point into a buffer, such as a map file
+  // being loaded, without copying them into strings first.
+  void init_from_properties(std::span<const map_property_t> props);
 
   // Returns all properties as a map of strings (for saving/snapshots)
   virtual std::map<std::string, std::string> get_all_properties() const;
@@ -99,6 +118,52 @@ public:
   void deserialize(Bit_Reader &reader);
 };
 
+// In every class of SHARED_ENTITIES_LIST (EnumName is its entry there):
+// tags each instance with its entity_type.
+#define DECLARE_ENTITY_TYPE(ClassName, EnumName)                               \
+public:                                                                        \
+  static constexpr ::entity_type static_type = ::entity_type::EnumName;        \
+  ClassName() { type = static_type; }
+
+// `entity` as a T if that is its class, else nullptr. T must use
+// DECLARE_ENTITY_TYPE. Unlike dynamic_cast this matches the exact class,
+// which is the same thing as long as entity classes derive from Entity only.
+template <typename T> T *entity_cast(Entity *entity)
+{
+  return entity && entity->type == T::static_type ? static_cast<T *>(entity)
+                                                  : nullptr;
+}
+
+template <typename T> const T *entity_cast(const Entity *entity)
+{
+  return entity && entity->type == T::static_type
+             ? static_cast<const T *>(entity)
+             : nullptr;
+}
+
+struct field_bits_t; // bandwidth_profiler.hpp
+
+// The field encoding behind Entity::serialize / deserialize, on raw state:
+// either a live object or a copy of its first schema->state_size bytes (which
+// is what snapshots keep). Writes a change mask followed by the changed
+// fields; with a null baseline every field is written.
+void serialize_fields(Bit_Writer &writer, const Class_Schema *schema,
+                      const uint8 *current, const uint8 *baseline);
+// The same with the change mask already known (bit i = field index i). With
+// `profile`, also appends the bits written per field, for the
+// Bandwidth_Profiler to count once the record is sent.
+void serialize_changed_fields(Bit_Writer &writer, const Class_Schema *schema,
+                              const uint8 *current, Field_Mask changed,
+                              std::vector<field_bits_t> *profile = nullptr);
+void deserialize_fields(Bit_Reader &reader, const Class_Schema *schema,
+                        uint8 *target);
+
+// True if any schema field differs between the two states.
+bool fields_differ(const Class_Schema *schema, const uint8 *a, const uint8 *b);
+// The schema fields that differ between the two states.
+Field_Mask changed_field_mask(const Class_Schema *schema, const uint8 *a,
+                              const uint8 *b);
+
 struct Entity_Delta
 {
   uint32_t entity_id;   // WHICH object is this? (e.g., Player #42)
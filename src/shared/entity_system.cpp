@@ -16,30 +16,99 @@ void Entity_System::reset()
   {
     pool->reset();
   }
+  transforms.clear();
+  // Ids from before the reset must not resolve to entities spawned after it,
+  // so the slots are retired like destroyed ones rather than started over.
+  free_entity_slots.clear();
+  for (network::uint32 index = network::uint32(entity_slots.size()) - 1;
+       index > 0; --index)
+  {
+    entity_slot_t &slot = entity_slots[index];
+    if (slot.pool && ++slot.generation == 0)
+      slot.generation = 1;
+    slot.pool = nullptr;
+    slot.type = entity_type::UNKNOWN;
+    free_entity_slots.push_back(index);
+  }
 }
 
-void Entity_System::add_entity(const std::shared_ptr<network::Entity> &entity)
+network::Entity_Id Entity_System::allocate_entity_id(entity_type type,
+                                                     Entity_Pool_Base *pool)
 {
-  if (!entity)
-    return;
+  network::uint32 index;
+  if (!free_entity_slots.empty())
+  {
+    index = free_entity_slots.back();
+    free_entity_slots.pop_back();
+  }
+  else
+  {
+    index = static_cast<network::uint32>(entity_slots.size());
+    entity_slots.emplace_back();
+  }
 
-#define ADD_IF_TYPE(enum_name, class_name, str_name, header_path)              \
-  if (auto *casted = dynamic_cast<const class_name *>(entity.get()))           \
-  {                                                                            \
-    auto it = pools.find(entity_type::enum_name);                              \
-    if (it != pools.end())                                                     \
-    {                                                                          \
-      it->second->add_existing(entity.get());                                  \
-      return;                                                                  \
-    }                                                                          \
+  entity_slot_t &slot = entity_slots[index];
+  slot.pool = pool;
+  slot.type = type;
+  slot.dense_index = static_cast<network::uint32>(pool->size() - 1);
+  return {index, slot.generation};
+}
+
+bool Entity_System::destroy(network::Entity_Id id)
+{
+  if (!live_slot(id))
+    return false;
+
+  entity_slot_t &slot = entity_slots[id.index];
+  if (network::Entity *moved = slot.pool->remove_at(slot.dense_index))
+  {
+    if (moved->id.index != 0)
+      entity_slots[moved->id.index].dense_index = slot.dense_index;
   }
 
-  SHARED_ENTITIES_LIST(ADD_IF_TYPE)
+  slot.pool = nullptr;
+  slot.type = entity_type::UNKNOWN;
+  if (++slot.generation == 0)
+    slot.generation = 1;
+  free_entity_slots.push_back(id.index);
+  return true;
+}
 
-#undef ADD_IF_TYPE
+void Entity_System::sync_transforms()
+{
+  size_t count = 0;
+  for (auto &[type, pool] : pools)
+    count += pool->size();
+  transforms.ids.resize(count);
+  transforms.positions.resize(count);
+  transforms.orientations.resize(count);
+
+  size_t next = 0;
+  for (auto &[type, pool] : pools)
+  {
+    Entity_Pool_Base::storage_t storage = pool->storage();
+    for (size_t i = 0; i < storage.count; ++i, ++next)
+    {
+      const auto &entity = *reinterpret_cast<const network::Entity *>(
+          storage.first + i * storage.stride);
+      transforms.ids[next] = entity.id;
+      transforms.positions[next] = entity.position;
+      transforms.orientations[next] = entity.orientation;
+      if (entity.id.index != 0 && entity.id.index < entity_slots.size())
+        entity_slots[entity.id.index].transform_index =
+            static_cast<network::uint32>(next);
+    }
+  }
+}
 
-  // Optional: Log warning if not handled, but some entities might not be in the
-  // system? log_error("Could not add entity of unknown type");
+void Entity_System::add_entity(const network::Entity &entity)
+{
+  // Entities of classes without a pool (entity_type::UNKNOWN) are skipped.
+  auto it = pools.find(entity.type);
+  if (it == pools.end())
+    return;
+  if (auto *added = it->second->add_existing(&entity))
+    added->id = allocate_entity_id(entity.type, it->second.get());
 }
 
 void Entity_System::populate_from_map(const map_t &map)
@@ -47,7 +116,8 @@ void Entity_System::populate_from_map(const map_t &map)
   reset();
   for (const auto &entry : map.entities)
   {
-    add_entity(entry.entity);
+    if (entry.entity)
+      add_entity(*entry.entity);
   }
 }
 
@@ -62,7 +132,7 @@ void Entity_System::register_all_known_entity_types()
 #undef REGISTER_GEN
 }
 
-entity_type classname_to_type(const std::string &classname)
+entity_type classname_to_type(std::string_view classname)
 {
 #define FROM_STRING_GEN(enum_name, class_name, str_name, header_path)          \
   if (classname == str_name)                                                   \
@@ -90,4 +160,14 @@ std::string type_to_classname(entity_type type)
   }
 }
 
+const network::Class_Schema *schema_for_type(entity_type type)
+{
+  // The shared entity classes' class ids are their entity_type.
+  if (type == entity_type::UNKNOWN || type >= entity_type::COUNT)
+    return nullptr;
+  network::register_entity_schemas();
+  return network::Schema_Registry::get().get_schema(
+      static_cast<uint16_t>(type));
+}
+
 } // namespace shared
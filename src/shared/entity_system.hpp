@@ -3,14 +3,20 @@
 #include "map.hpp" // For map_t and entity_type
 #include "network/network_types.hpp"
 #include "network/schema.hpp"
+#include "transform_stream.hpp"
+#include <cstring>
 #include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace shared
 {
 
+// Schema of the class registered for `type`, or nullptr.
+const network::Class_Schema *schema_for_type(entity_type type);
+
 struct Spawn_Info
 {
   linalg::vec3 position = {{0, 0, 0}};
@@ -23,7 +29,26 @@ struct Entity_Pool_Base
   virtual ~Entity_Pool_Base() = default;
   virtual void reset() = 0;
   virtual void instantiate(const Spawn_Info &spawn) = 0;
-  virtual void add_existing(const network::Entity *entity) = 0;
+  // Returns the pool's copy, or nullptr if the entity is of another type.
+  virtual network::Entity *add_existing(const network::Entity *entity) = 0;
+  // Removes the entity at `index` by moving the last one into its place.
+  // Returns the moved entity, or nullptr if `index` was the last.
+  virtual network::Entity *remove_at(size_t index) = 0;
+
+  // Type-erased iteration (snapshot capture).
+  virtual size_t size() const = 0;
+  virtual const network::Entity *at(size_t index) const = 0;
+  virtual network::Entity *at(size_t index) = 0;
+
+  // The entities as raw storage, for loops that should not make a virtual
+  // call per entity (Entity_System::for_each_component).
+  struct storage_t
+  {
+    network::uint8 *first = nullptr;
+    size_t stride = 0; // sizeof the pool's class
+    size_t count = 0;
+  };
+  virtual storage_t storage() = 0;
 };
 
 template <typename T> struct EntityPool : Entity_Pool_Base
@@ -35,10 +60,9 @@ template <typename T> struct EntityPool : Entity_Pool_Base
   // Instantiates an entity from spawn data.
   // 1. Calls ent.init_from_map(spawn.properties) to parse generic properties.
   // 2. "Magically" injects position and yaw if the Entity's schema has matching
-  // fields:
+  // fields (looked up by name with Class_Schema::find_fields):
   //    - Field "position" (Vec3f) <- spawn.position
   //    - Field "yaw" or "view_angle_yaw" (Float32) <- spawn.yaw
-  //    - Field "yaw" or "view_angle_yaw" (Float32) <- spawn.yaw
   void instantiate(const Spawn_Info &spawn) override
   {
     auto &ent = entities.emplace_back();
@@ -46,73 +70,60 @@ template <typename T> struct EntityPool : Entity_Pool_Base
     // 1. Init properties from map first
     ent.init_from_map(spawn.properties);
 
-    // 2. "Magic" injection:
-    // If the entity has a "position" field of type Vec3f, set it from
-    // spawn.position If the entity has a "yaw" field of type Float32, set it
-    // from spawn.yaw
-
+    // 2. "Magic" injection: a Vec3f field called "position" gets
+    // spawn.position, and a Float32 field called "yaw" or "view_angle_yaw"
+    // (player_entity's name for it) gets spawn.yaw.
     const auto *schema = ent.get_schema();
     if (schema)
     {
       network::uint8 *base = reinterpret_cast<network::uint8 *>(&ent);
-
-      for (const auto &field : schema->fields)
+      auto inject = [&](std::string_view name, network::Field_Type type,
+                        const auto &value)
       {
-        if (field.name == "position" &&
-            field.type == network::Field_Type::Vec3f)
-        {
-          // We have a position field!
-          linalg::vec3 *ptr =
-              reinterpret_cast<linalg::vec3 *>(base + field.offset);
-          *ptr = spawn.position;
-        }
-        else if (field.name == "yaw" &&
-                 field.type == network::Field_Type::Float32)
+        for (uint16_t index : schema->find_fields(name))
         {
-          // We have a yaw field!
-          // (Note: player_entity uses view_angle_yaw, so this might need to be
-          // specific or we just rely on standard naming conventions if we want
-          // this to be generic.) BUT, the goal is to map from spawn.yaw if
-          // possible. However, player_entity has "view_angle_yaw". Let's check
-          // for "view_angle_yaw" too? Or maybe we should just set "yaw" if it
-          // exists. For now let's just do "yaw" and "view_angle_yaw" for
-          // convenience? Wait, "yaw" is what we parse from map property "yaw".
-
-          float *ptr = reinterpret_cast<float *>(base + field.offset);
-          *ptr = spawn.yaw;
+          const network::Field_Prop &field = schema->fields[index];
+          if (field.type == type)
+            std::memcpy(base + field.offset, &value, sizeof(value));
         }
-        else if (field.name == "view_angle_yaw" &&
-                 field.type == network::Field_Type::Float32)
-        {
-          float *ptr = reinterpret_cast<float *>(base + field.offset);
-          *ptr = spawn.yaw;
-        }
-      }
+      };
+      inject("position", network::Field_Type::Vec3f, spawn.position);
+      inject("yaw", network::Field_Type::Float32, spawn.yaw);
+      inject("view_angle_yaw", network::Field_Type::Float32, spawn.yaw);
     }
   }
 
-  void add_existing(const network::Entity *entity) override
+  network::Entity *add_existing(const network::Entity *entity) override
   {
-    if (const T *cast_ent = dynamic_cast<const T *>(entity))
+    if (const T *cast_ent = network::entity_cast<T>(entity))
     {
-      entities.push_back(*cast_ent);
+      return &entities.emplace_back(*cast_ent);
     }
+    return nullptr;
+  }
+
+  size_t size() const override { return entities.size(); }
+  const network::Entity *at(size_t index) const override
+  {
+    return &entities[index];
+  }
+  network::Entity *at(size_t index) override { return &entities[index]; }
+  storage_t storage() override
+  {
+    return {reinterpret_cast<network::uint8 *>(entities.data()), sizeof(T),
+            entities.size()};
   }
 
-  void remove(T *ptr)
+  network::Entity *remove_at(size_t index) override
   {
-    for (size_t i = 0; i < entities.size(); ++i)
+    if (index + 1 == entities.size())
     {
-      if (&entities[i] == ptr)
-      {
-        if (i != entities.size() - 1)
-        {
-          entities[i] = std::move(entities.back());
-        }
-        entities.pop_back();
-        return;
-      }
+      entities.pop_back();
+      return nullptr;
     }
+    entities[index] = std::move(entities.back());
+    entities.pop_back();
+    return &entities[index];
   }
 };
 
@@ -126,6 +137,24 @@ struct Entity_System
   Entity_System() { register_all_known_entity_types(); }
   std::map<entity_type, std::unique_ptr<struct Entity_Pool_Base>> pools;
 
+  // The pools are dense (entities move when one is destroyed); an
+  // Entity_Id stays valid until its entity is destroyed. entity_slots is
+  // indexed by id.index and says where the entity is now. Destroying an
+  // entity bumps its slot's generation, so the old id stops resolving and
+  // the index can be handed out again: clients tell the two apart by the
+  // full id. Slot 0 is never used, so null_entity_id never resolves.
+  struct entity_slot_t
+  {
+    Entity_Pool_Base *pool = nullptr; // null while the slot is free
+    entity_type type = entity_type::UNKNOWN;
+    network::uint32 dense_index = 0; // into the pool
+    network::uint32 generation = 1;
+    // Into `transforms`, as of the last sync_transforms().
+    network::uint32 transform_index = 0;
+  };
+  std::vector<entity_slot_t> entity_slots = {entity_slot_t{}};
+  std::vector<network::uint32> free_entity_slots;
+
   template <typename T> void register_entity_type(entity_type type)
   {
 #ifdef ENTITIES_WANT_INCLUDES
@@ -147,8 +176,8 @@ struct Entity_System
     return nullptr;
   }
 
-  //@FIXME(SJM): I don't think this should actually return T* ? and that delete
-  // should not actually delete but just free up a slot.
+  // The returned pointer is valid until the next spawn or destroy of this
+  // type; keep ent->id to refer to the entity after that.
   template <typename T> T *spawn(entity_type type, const Spawn_Info &info = {})
   {
     auto it = pools.find(type);
@@ -156,31 +185,99 @@ struct Entity_System
     {
       auto *pool = static_cast<EntityPool<T> *>(it->second.get());
       pool->instantiate(info);
-      return &pool->entities.back();
+      T *ent = &pool->entities.back();
+      ent->id = allocate_entity_id(type, pool);
+      return ent;
     }
     return nullptr;
   }
 
-  template <typename T> void destroy(entity_type type, T *ptr)
+  // The entity `id` refers to, or nullptr if it was destroyed.
+  network::Entity *find(network::Entity_Id id)
   {
-    auto it = pools.find(type);
-    if (it != pools.end())
+    const entity_slot_t *slot = live_slot(id);
+    return slot ? slot->pool->at(slot->dense_index) : nullptr;
+  }
+
+  // The same, or nullptr if the entity is not of `type`.
+  template <typename T> T *get(entity_type type, network::Entity_Id id)
+  {
+    const entity_slot_t *slot = live_slot(id);
+    if (!slot || slot->type != type)
+      return nullptr;
+    return &static_cast<EntityPool<T> *>(slot->pool)
+                ->entities[slot->dense_index];
+  }
+
+  // Returns false if `id` did not refer to a live entity.
+  bool destroy(network::Entity_Id id);
+
+  // Calls fn(network::Entity &, T &) for every entity whose class has a
+  // component of type T (the field get_component<T>() would return). The
+  // class and offset are looked up once per pool, not per entity.
+  template <typename T, typename Fn> void for_each_component(Fn &&fn)
+  {
+    constexpr size_t component_type =
+        static_cast<size_t>(network::Schema_Type_Info<T>::type);
+    for (auto &[type, pool] : pools)
     {
-      auto *pool = static_cast<EntityPool<T> *>(it->second.get());
-      pool->remove(ptr);
+      const network::Class_Schema *schema = schema_for_type(type);
+      if (!schema || schema->component_offsets[component_type] < 0)
+        continue;
+      size_t offset = size_t(schema->component_offsets[component_type]);
+      Entity_Pool_Base::storage_t storage = pool->storage();
+      for (size_t i = 0; i < storage.count; ++i)
+      {
+        network::uint8 *base = storage.first + i * storage.stride;
+        fn(*reinterpret_cast<network::Entity *>(base),
+           *reinterpret_cast<T *>(base + offset));
+      }
     }
   }
 
+  // Every entity's position and orientation, pool by pool, for batch passes
+  // that read them (see transform_stream.hpp). The entities' schema fields
+  // stay the source of truth and the stream is a read-only copy:
+  // sync_transforms() fills it, and it does not follow moves, spawns or
+  // destroys after that, so sync once per tick before using it.
+  Transform_Stream transforms;
+
+  void sync_transforms();
+
+  // Where `id` is in `transforms`, or transforms.size() if it was not live at
+  // the last sync.
+  size_t transform_index(network::Entity_Id id) const
+  {
+    const entity_slot_t *slot = live_slot(id);
+    if (!slot || slot->transform_index >= transforms.size() ||
+        transforms.ids[slot->transform_index] != id)
+      return transforms.size();
+    return slot->transform_index;
+  }
+
   void reset();
   void populate_from_map(const map_t &map);
-  void add_entity(const std::shared_ptr<network::Entity> &entity);
+  void add_entity(const network::Entity &entity);
 
   // this is called in the constructor, no need for you to call it.
   void register_all_known_entity_types();
+
+private:
+  // Gives the entity just appended to `pool` a slot and returns its id.
+  network::Entity_Id allocate_entity_id(entity_type type,
+                                        Entity_Pool_Base *pool);
+
+  const entity_slot_t *live_slot(network::Entity_Id id) const
+  {
+    if (id.index == 0 || id.index >= entity_slots.size())
+      return nullptr;
+    const entity_slot_t &slot = entity_slots[id.index];
+    return slot.pool && slot.generation == id.generation ? &slot : nullptr;
+  }
 };
 
 // Helpers migrated from EntityFactory
-entity_type classname_to_type(const std::string &classname);
+entity_type classname_to_type(std::string_view classname);
 std::string type_to_classname(entity_type type);
 
 } // namespace shared
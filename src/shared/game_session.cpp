@@ -6,27 +6,30 @@
 namespace shared
 {
 
-void init_session_from_map(game_session_t &session, const map_t &map)
+void init_session_from_map(game_session_t &session, map_t map)
 {
-  session.map_name = map.name;
+  session.map = std::move(map);
+  session.map_name = session.map.name;
   session.entity_system.reset();
   session.static_entities.clear();
+  session.static_entities.reserve(session.map.entities.size());
 
   // 1. Separate Static vs Dynamic Entities
-  for (const auto &entry : map.entities)
+  for (const auto &entry : session.map.entities)
   {
     if (!entry.entity)
       continue;
 
-    if (dynamic_cast<const network::AABB_Entity *>(entry.entity.get()) ||
-        dynamic_cast<const network::Wedge_Entity *>(entry.entity.get()) ||
-        dynamic_cast<const network::Static_Mesh_Entity *>(entry.entity.get()))
+    switch (entry.entity->type)
     {
+    case entity_type::AABB:
+    case entity_type::WEDGE:
+    case entity_type::STATIC_MESH:
       session.static_entities.push_back(entry.entity);
-    }
-    else
-    {
-      session.entity_system.add_entity(entry.entity);
+      break;
+    default:
+      session.entity_system.add_entity(*entry.entity);
+      break;
     }
   }
 
@@ -36,7 +39,7 @@ void init_session_from_map(game_session_t &session, const map_t &map)
 
   for (size_t i = 0; i < session.static_entities.size(); ++i)
   {
-    auto bounds = compute_entity_bounds(session.static_entities[i].get());
+    auto bounds = compute_entity_bounds(session.static_entities[i]);
     BVH_Input input;
     input.aabb.min = bounds.min;
     input.aabb.max = bounds.max;
@@ -23,10 +23,13 @@ struct game_session_t
   // Manages all active dynamic entities (Players, Weapons, Projectiles)
   Entity_System entity_system;
 
-  // Static entities (AABB, Wedge, StaticMesh)
+  // The map the session was started from. Owns the static entities.
+  map_t map;
+
+  // Static entities (AABB, Wedge, StaticMesh), in map.
   // We keep them separate from Entity_System (dynamic) for now,
   // though they are all "Entities" in the map.
-  std::vector<std::shared_ptr<network::Entity>> static_entities;
+  std::vector<const network::Entity *> static_entities;
 
   // The acceleration structure for collision queries against static_geometry.
   // Dynamic entity collision is handled separately via the Entity_System.
@@ -35,10 +38,10 @@ struct game_session_t
   std::string map_name;
 };
 
-// Initializes the session from a loaded map.
+// Initializes the session from a loaded map, which the session keeps.
 // - Resets the entity system and populates it from map entities.
-// - Copies static geometry (AABBs).
+// - Collects static geometry (AABBs).
 // - Builds the BVH for static geometry.
-void init_session_from_map(game_session_t &session, const map_t &map);
+void init_session_from_map(game_session_t &session, map_t map);
 
 } // namespace shared
@@ -3,8 +3,12 @@
 #include "asset.hpp"
 #include "entities/static_entities.hpp"
 #include "entity_system.hpp"
+#include <cctype>
+#include <charconv>
 #include <fstream>
+#include <span>
 #include <sstream>
+#include <string_view>
 
 namespace shared
 {
@@ -18,64 +22,93 @@ struct map_entity_def_t
   std::map<std::string, std::string> properties;
 };
 
-std::vector<map_entity_def_t> parse_map_content(const std::string &content)
+// An entity of a map file as parse_map_content() finds it: views into the
+// file's text, with its properties a range of the shared property list.
+struct parsed_map_entity_t
 {
-  std::vector<map_entity_def_t> entities;
-  std::stringstream ss(content);
-  std::string token;
+  std::string_view classname;
+  size_t first_property = 0;
+  size_t property_count = 0;
+};
+
+struct parsed_map_t
+{
+  std::vector<parsed_map_entity_t> entities;
+  std::vector<network::map_property_t> properties;
 
-  while (ss >> token)
+  std::span<const network::map_property_t>
+  properties_of(const parsed_map_entity_t &entity) const
   {
-    if (token == "entity")
-    {
-      std::string brace;
-      ss >> brace;
-      if (brace == "{")
-      {
-        map_entity_def_t file_ent;
-        while (ss >> token)
-        {
-          if (token == "}")
-          {
-            break;
-          }
-          // Expecting "key" "value"
-          std::string key = token;
-          if (key.size() >= 2 && key.front() == '"' && key.back() == '"')
-          {
-            key = key.substr(1, key.size() - 2);
-          }
+    return {properties.data() + entity.first_property,
+            entity.property_count};
+  }
+};
 
-          std::string value;
-          ss >> value;
-          // Values can have spaces if quoted "0 0 0"
-          if (value.front() == '"')
-          {
-            // If it doesn't end with quote, read until it does
-            while (value.back() != '"' && !ss.eof())
-            {
-              std::string part;
-              ss >> part;
-              value += " " + part;
-            }
-            if (value.size() >= 2)
-              value = value.substr(1, value.size() - 2);
-          }
+// The next whitespace-separated token of `text`, without its quotes if it
+// is quoted ("0 0 0" is one token). Advances `text` past it; returns false
+// at the end.
+bool next_map_token(std::string_view &text, std::string_view &token)
+{
+  size_t start = 0;
+  while (start < text.size() &&
+         std::isspace(static_cast<unsigned char>(text[start])))
+    ++start;
+  if (start == text.size())
+  {
+    text = {};
+    return false;
+  }
 
-          if (key == "classname")
-          {
-            file_ent.classname = value;
-          }
-          else
-          {
-            file_ent.properties[key] = value;
-          }
-        }
-        entities.push_back(file_ent);
-      }
+  size_t end;
+  if (text[start] == '"')
+  {
+    size_t close = text.find('"', start + 1);
+    end = close == std::string_view::npos ? text.size() : close;
+    token = text.substr(start + 1, end - start - 1);
+    end = std::min(end + 1, text.size());
+  }
+  else
+  {
+    end = start;
+    while (end < text.size() &&
+           !std::isspace(static_cast<unsigned char>(text[end])))
+      ++end;
+    token = text.substr(start, end - start);
+  }
+  text.remove_prefix(end);
+  return true;
+}
+
+// The views point into `content`, which must outlive the result.
+parsed_map_t parse_map_content(std::string_view content)
+{
+  parsed_map_t parsed;
+  std::string_view token;
+
+  while (next_map_token(content, token))
+  {
+    if (token != "entity")
+      continue;
+    if (!next_map_token(content, token) || token != "{")
+      continue;
+
+    parsed_map_entity_t entity;
+    entity.first_property = parsed.properties.size();
+    std::string_view key, value;
+    while (next_map_token(content, key) && key != "}")
+    {
+      // Expecting "key" "value"
+      if (!next_map_token(content, value))
+        break;
+      if (key == "classname")
+        entity.classname = value;
+      else
+        parsed.properties.push_back({key, value});
     }
+    entity.property_count = parsed.properties.size() - entity.first_property;
+    parsed.entities.push_back(entity);
   }
-  return entities;
+  return parsed;
 }
 
 std::string
@@ -131,7 +164,7 @@ aabb_bounds_t compute_entity_bounds(const network::Entity *entity)
   }
 
   // 2. Check for AABB entity shape
-  if (auto *aabb = dynamic_cast<const network::AABB_Entity *>(entity))
+  if (auto *aabb = network::entity_cast<network::AABB_Entity>(entity))
   {
     aabb_t t;
     t.center = aabb->position;
@@ -140,7 +173,7 @@ aabb_bounds_t compute_entity_bounds(const network::Entity *entity)
   }
 
   // 3. Check for Wedge entity shape
-  if (auto *wedge = dynamic_cast<const network::Wedge_Entity *>(entity))
+  if (auto *wedge = network::entity_cast<network::Wedge_Entity>(entity))
   {
     wedge_t t;
     t.center = wedge->position;
@@ -154,53 +187,154 @@ aabb_bounds_t compute_entity_bounds(const network::Entity *entity)
           entity->position + vec3f{0.5f, 0.5f, 0.5f}};
 }
 
+Map_Entity_Arena_Base *map_t::arena_for(entity_type type)
+{
+  size_t index = static_cast<size_t>(type);
+  if (type == entity_type::UNKNOWN || index >= arenas.size())
+    return nullptr;
+  if (!arenas[index])
+  {
+    switch (type)
+    {
+#define ARENA_GEN(enum_name, class_name, str_name, header_path)                \
+  case entity_type::enum_name:                                                 \
+    arenas[index] = std::make_unique<Map_Entity_Arena<class_name>>();          \
+    break;
+
+      SHARED_ENTITIES_LIST(ARENA_GEN)
+#undef ARENA_GEN
+
+    default:
+      return nullptr;
+    }
+  }
+  return arenas[index].get();
+}
+
+map_entity_t &map_t::create_entity(entity_type type, entity_uid_t uid)
+{
+  if (uid == 0)
+    uid = next_uid++;
+  else if (uid >= next_uid)
+    next_uid = uid + 1;
+
+  Map_Entity_Arena_Base *arena = arena_for(type);
+  entities.push_back({uid, arena ? arena->create() : nullptr});
+  return entities.back();
+}
+
+entity_uid_t map_t::add_entity(const network::Entity &entity)
+{
+  if (!arena_for(entity.type))
+    return 0;
+  entity_uid_t uid = next_uid;
+  add_entity_with_uid(uid, entity);
+  return uid;
+}
+
+void map_t::add_entity_with_uid(entity_uid_t uid,
+                                const network::Entity &entity)
+{
+  Map_Entity_Arena_Base *arena = arena_for(entity.type);
+  if (!arena)
+    return;
+  arena->assign(create_entity(entity.type, uid).entity, entity);
+}
+
+bool map_t::remove_entity(entity_uid_t uid)
+{
+  auto it = std::find_if(entities.begin(), entities.end(),
+                         [uid](const map_entity_t &e) { return e.uid == uid; });
+  if (it == entities.end())
+    return false;
+  if (it->entity)
+    arena_for(it->entity->type)->remove(it->entity);
+  entities.erase(it);
+  return true;
+}
+
+void map_t::reserve(entity_type type, size_t count)
+{
+  if (Map_Entity_Arena_Base *arena = arena_for(type))
+    arena->reserve(count);
+}
+
+void map_t::clear()
+{
+  name.clear();
+  next_uid = 1;
+  entities.clear();
+  for (auto &arena : arenas)
+    arena.reset();
+}
+
 bool load_map(const std::string &filename, map_t &out_map)
 {
-  std::ifstream in(filename);
+  if (is_binary_map(filename))
+    return load_map_binary(filename, out_map);
+
+  std::ifstream in(filename, std::ios::binary | std::ios::ate);
   if (!in.is_open())
   {
     return false;
   }
 
-  std::stringstream buffer;
-  buffer << in.rdbuf();
-  std::string content = buffer.str();
+  std::string content(static_cast<size_t>(in.tellg()), '\0');
+  in.seekg(0);
+  in.read(content.data(), static_cast<std::streamsize>(content.size()));
   in.close();
 
-  auto entities = parse_map_content(content);
-  out_map = {}; // Clear
+  // Properties are parsed straight out of `content`.
+  parsed_map_t parsed = parse_map_content(content);
+  const auto &entities = parsed.entities;
+  out_map.clear();
 
-  for (const auto &ent : entities)
+  // One block per class and one entry list, sized up front.
+  std::vector<entity_type> types(entities.size());
+  std::array<size_t, static_cast<size_t>(entity_type::COUNT)> counts{};
+  for (size_t i = 0; i < entities.size(); ++i)
+  {
+    types[i] = classname_to_type(entities[i].classname);
+    counts[static_cast<size_t>(types[i])] += 1;
+  }
+  for (size_t type = 1; type < counts.size(); ++type)
+  {
+    if (counts[type])
+      out_map.reserve(static_cast<entity_type>(type), counts[type]);
+  }
+  out_map.entities.reserve(entities.size());
+
+  for (size_t i = 0; i < entities.size(); ++i)
   {
+    const auto &ent = entities[i];
+    auto properties = parsed.properties_of(ent);
     if (ent.classname == "worldspawn")
     {
-      if (ent.properties.count("name"))
+      for (const auto &property : properties)
       {
-        out_map.name = ent.properties.at("name");
+        if (property.key == "name")
+          out_map.name = property.value;
       }
       continue;
     }
 
-    auto new_entity = create_entity_by_classname(ent.classname);
-    if (new_entity)
+    if (types[i] != entity_type::UNKNOWN)
     {
-      new_entity->init_from_map(ent.properties);
-
       // Restore uid from file if present, otherwise auto-assign
-      if (ent.properties.count("_uid"))
-      {
-        entity_uid_t uid =
-            (entity_uid_t)std::stoul(ent.properties.at("_uid"));
-        out_map.add_entity_with_uid(uid, new_entity);
-      }
-      else
+      entity_uid_t uid = 0;
+      for (const auto &property : properties)
       {
-        out_map.add_entity(new_entity);
+        if (property.key == "_uid")
+          std::from_chars(property.value.data(),
+                          property.value.data() + property.value.size(), uid);
       }
+      out_map.create_entity(types[i], uid).entity->init_from_properties(
+          properties);
     }
     else
     {
-      printf("Warning: Unknown entity classname: %s\n", ent.classname.c_str());
+      printf("Warning: Unknown entity classname: %.*s\n",
+             static_cast<int>(ent.classname.size()), ent.classname.data());
     }
   }
 
@@ -226,7 +360,7 @@ bool save_map(const std::string &filename, const map_t &map)
       continue;
 
     map_entity_def_t def;
-    def.classname = get_classname_for_entity(entry.entity.get());
+    def.classname = get_classname_for_entity(entry.entity);
 
     if (def.classname == "unknown")
       continue;
@@ -239,7 +373,7 @@ bool save_map(const std::string &filename, const map_t &map)
     if (schema)
     {
       const uint8_t *base_ptr =
-          reinterpret_cast<const uint8_t *>(entry.entity.get());
+          reinterpret_cast<const uint8_t *>(entry.entity);
 
       for (const auto &field : schema->fields)
       {
@@ -5,6 +5,7 @@
 #include "linalg.hpp"
 #include "shapes.hpp"
 #include <algorithm>
+#include <array>
 #include <map>
 #include <memory>
 #include <string>
@@ -19,41 +20,128 @@ using entity_uid_t = uint32_t;
 struct map_entity_t
 {
   entity_uid_t uid;
-  std::shared_ptr<network::Entity> entity;
+  // Into the map's storage; owned by the map.
+  network::Entity *entity = nullptr;
 };
 
-struct map_t
+// The map's entities of one class. They live in blocks that are never grown
+// past the size reserved for them, so an entity does not move for as long as
+// it is in the map. A removed entity is reset and left in place as a
+// tombstone (type entity_type::UNKNOWN) until its slot is reused, which
+// keeps every block a plain span of T.
+struct Map_Entity_Arena_Base
 {
-  std::string name;
-  entity_uid_t next_uid = 1;
-  std::vector<map_entity_t> entities;
+  virtual ~Map_Entity_Arena_Base() = default;
+  // Makes room for `count` more entities in one block.
+  virtual void reserve(size_t count) = 0;
+  // A default-constructed entity.
+  virtual network::Entity *create() = 0;
+  // Copies `from` over `to`; both must be of the arena's class.
+  virtual void assign(network::Entity *to, const network::Entity &from) = 0;
+  // `entity` must be in this arena.
+  virtual void remove(network::Entity *entity) = 0;
+  virtual void clear() = 0;
+};
+
+template <typename T> struct Map_Entity_Arena : Map_Entity_Arena_Base
+{
+  std::vector<std::vector<T>> blocks;
+  std::vector<T *> free_slots;
+
+  void reserve(size_t count) override
+  {
+    size_t room = blocks.empty() ? 0
+                                 : blocks.back().capacity() -
+                                       blocks.back().size();
+    if (room < count)
+      blocks.emplace_back().reserve(count);
+  }
+
+  network::Entity *create() override
+  {
+    if (!free_slots.empty())
+    {
+      T *slot = free_slots.back();
+      free_slots.pop_back();
+      *slot = T{};
+      return slot;
+    }
+    if (blocks.empty() || blocks.back().size() == blocks.back().capacity())
+    {
+      size_t capacity = blocks.empty() ? 0 : blocks.back().capacity();
+      blocks.emplace_back().reserve(std::max<size_t>(64, capacity * 2));
+    }
+    return &blocks.back().emplace_back();
+  }
+
+  void assign(network::Entity *to, const network::Entity &from) override
+  {
+    *static_cast<T *>(to) = static_cast<const T &>(from);
+  }
+
+  void remove(network::Entity *entity) override
+  {
+    T *slot = static_cast<T *>(entity);
+    *slot = T{};
+    slot->type = entity_type::UNKNOWN;
+    free_slots.push_back(slot);
+  }
 
-  // Add entity with auto-assigned uid
-  entity_uid_t add_entity(std::shared_ptr<network::Entity> ent)
+  void clear() override
   {
-    entity_uid_t uid = next_uid++;
-    entities.push_back({uid, std::move(ent)});
-    return uid;
+    blocks.clear();
+    free_slots.clear();
   }
 
-  // Add entity with a specific uid (for undo/redo restore)
-  void add_entity_with_uid(entity_uid_t uid,
-                           std::shared_ptr<network::Entity> ent)
+  // Calls fn(T &) for every entity of the class that is in the map, in
+  // memory order.
+  template <typename Fn> void for_each(Fn &&fn)
   {
-    entities.push_back({uid, std::move(ent)});
-    if (uid >= next_uid)
-      next_uid = uid + 1;
+    for (auto &block : blocks)
+      for (T &entity : block)
+        if (entity.type == T::static_type)
+          fn(entity);
   }
+};
+
+struct map_t
+{
+  std::string name;
+  entity_uid_t next_uid = 1;
+  // In the order they were added (file order for loaded maps).
+  std::vector<map_entity_t> entities;
+  // Storage per class, made on first use (see arena_for).
+  std::array<std::unique_ptr<Map_Entity_Arena_Base>,
+             static_cast<size_t>(entity_type::COUNT)>
+      arenas;
+
+  // Adds a default-constructed entity of `type` with the given uid (0:
+  // assign one). The entry's entity is null if `type` is not a map entity
+  // class. The reference is valid until the next add.
+  map_entity_t &create_entity(entity_type type, entity_uid_t uid = 0);
+
+  // Add a copy of `entity` with auto-assigned uid; 0 if its class is not
+  // in SHARED_ENTITIES_LIST.
+  entity_uid_t add_entity(const network::Entity &entity);
+
+  // Add a copy with a specific uid (for undo/redo restore)
+  void add_entity_with_uid(entity_uid_t uid, const network::Entity &entity);
 
   // Remove entity by uid
-  bool remove_entity(entity_uid_t uid)
+  bool remove_entity(entity_uid_t uid);
+
+  // Room for `count` more entities of `type` without further allocation.
+  void reserve(entity_type type, size_t count);
+
+  void clear();
+
+  // The storage for `type`, made if needed; null for entity_type::UNKNOWN.
+  Map_Entity_Arena_Base *arena_for(entity_type type);
+
+  // Typed access to one class's storage: T::static_type's arena.
+  template <typename T> Map_Entity_Arena<T> &arena()
   {
-    auto it = std::find_if(entities.begin(), entities.end(),
-                           [uid](const map_entity_t &e) { return e.uid == uid; });
-    if (it == entities.end())
-      return false;
-    entities.erase(it);
-    return true;
+    return *static_cast<Map_Entity_Arena<T> *>(arena_for(T::static_type));
   }
 
   // Find entity by uid (linear scan)
@@ -74,7 +162,8 @@ struct map_t
   }
 };
 
-// Loads map from VMF-style text file.
+// Loads map from VMF-style text file, or from a binary map (see below),
+// which is recognized by its header whatever the file is called.
 // Returns true on success, false on failure.
 // usage:
 //   shared::map_t map;
@@ -85,6 +174,22 @@ bool load_map(const std::string &filename, map_t &out_map);
 // Returns true on success, false on failure.
 bool save_map(const std::string &filename, const map_t &map);
 
+// Binary maps (map_binary.cpp): the same entities with their schema fields
+// stored as packed bytes per class, keyed by Class_Schema::layout_hash. The
+// file is memory-mapped and, for classes whose layout has not changed since
+// it was written, copied into the entities without parsing; other classes
+// are converted field by field by name. The text format stays the one to
+// edit and diff; binary maps are what matches load.
+inline constexpr const char *binary_map_extension = ".bmap";
+
+bool is_binary_map(const std::string &filename);
+bool load_map_binary(const std::string &filename, map_t &out_map);
+bool save_map_binary(const std::string &filename, const map_t &map);
+
+// Loads `from` (either format) and saves it to `to`, as a binary map if `to`
+// ends in binary_map_extension and as text otherwise.
+bool convert_map(const std::string &from, const std::string &to);
+
 // Compute world-space AABB bounds for an entity.
 // Data-driven: uses mesh bounds if available, else entity-specific shape,
 // else default 1x1x1 box at position.
@@ -0,0 +1,620 @@
+#include "map.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shared
+{
+
+namespace
+{
+
+static_assert(std::endian::native == std::endian::little,
+              "binary maps are stored little-endian");
+
+constexpr char binary_map_magic[4] = {'T', 'B', 'M', 'P'};
+constexpr uint32_t binary_map_version = 2;
+
+// File layout, all offsets from the start of the file:
+//   binary_map_header_t
+//   binary_map_class_t  x header.class_count
+//   binary_map_field_t  x header.field_count (each class's, in schema order)
+//   uint16_t            x header.entity_count: the class of each entity, in
+//                         map.entities order
+//   names (map, classes, fields), not terminated
+//   per class, 8-byte aligned: entity_count uint32_t uids, then entity_count
+//   records of record_size bytes, the class's fields packed in schema order
+struct binary_map_header_t
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t class_count;
+  uint32_t field_count;
+  uint32_t entity_count;
+  uint32_t name_length;
+  uint64_t name_offset;
+  uint64_t fields_offset;
+  uint64_t order_offset;
+  // network::field_type_layout() of each Field_Type when written.
+  uint32_t type_layouts[8];
+};
+
+static_assert(network::field_type_count <= 8);
+static_assert(sizeof(bool) == 1);
+
+struct binary_map_class_t
+{
+  uint64_t layout_hash; // Class_Schema::layout_hash when written
+  uint64_t name_offset; // the schema's class_name
+  uint32_t name_length;
+  uint32_t first_field; // into the field table
+  uint32_t field_count;
+  uint32_t entity_count;
+  uint32_t record_size;
+  uint32_t reserved;
+  uint64_t uids_offset;
+  uint64_t records_offset;
+};
+
+struct binary_map_field_t
+{
+  uint64_t name_offset;
+  uint32_t name_length;
+  uint32_t type; // network::Field_Type
+  uint32_t size;
+  uint32_t record_offset;
+};
+
+static_assert(sizeof(binary_map_header_t) == 80);
+static_assert(sizeof(binary_map_class_t) == 56);
+static_assert(sizeof(binary_map_field_t) == 24);
+
+// A read-only view of a whole file.
+class Mapped_File
+{
+public:
+  Mapped_File() = default;
+  Mapped_File(const Mapped_File &) = delete;
+  Mapped_File &operator=(const Mapped_File &) = delete;
+  ~Mapped_File() { close(); }
+
+  bool open(const std::string &filename)
+  {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+      HANDLE mapping =
+          CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping)
+      {
+        bytes = static_cast<const uint8_t *>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+        if (bytes)
+          length = static_cast<size_t>(file_size.QuadPart);
+      }
+    }
+    CloseHandle(file);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+      void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+      if (view != MAP_FAILED)
+      {
+        bytes = static_cast<const uint8_t *>(view);
+        length = static_cast<size_t>(info.st_size);
+      }
+    }
+    ::close(fd);
+#endif
+    return bytes != nullptr;
+  }
+
+  void close()
+  {
+    if (!bytes)
+      return;
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+#else
+    munmap(const_cast<uint8_t *>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+  }
+
+  const uint8_t *data() const { return bytes; }
+  size_t size() const { return length; }
+
+  // Whether [offset, offset + count * element_size) is inside the file.
+  bool contains(uint64_t offset, uint64_t count, uint64_t element_size) const
+  {
+    if (offset > length)
+      return false;
+    return element_size == 0 || count <= (length - offset) / element_size;
+  }
+
+private:
+  const uint8_t *bytes = nullptr;
+  size_t length = 0;
+};
+
+// Bytes of a field of `type` in this build, or 0 for an unknown type.
+size_t field_type_size(network::Field_Type type)
+{
+  switch (type)
+  {
+  case network::Field_Type::Int32:
+    return sizeof(network::int32);
+  case network::Field_Type::Float32:
+    return sizeof(network::float32);
+  case network::Field_Type::Bool:
+    return sizeof(bool);
+  case network::Field_Type::Vec3f:
+    return sizeof(network::vec3f);
+  case network::Field_Type::PascalString:
+    return sizeof(network::pascal_string);
+  case network::Field_Type::RenderComponent:
+    return sizeof(network::render_component_t);
+  }
+  return 0;
+}
+
+// How one file class becomes entities of the current build.
+struct class_plan_t
+{
+  entity_type type = entity_type::UNKNOWN; // UNKNOWN: skip its entities
+  binary_map_class_t header = {};
+  // Runs of bytes copied as they are from a record into the entity.
+  struct copy_t
+  {
+    uint32_t from; // in the record
+    uint32_t to;   // in the entity
+    uint32_t size;
+  };
+  std::vector<copy_t> copies;
+  // Fields whose type changed, converted through their text form.
+  struct convert_t
+  {
+    uint32_t from;
+    network::Field_Type from_type;
+    uint32_t to;
+    network::Field_Type to_type;
+  };
+  std::vector<convert_t> conversions;
+  // Copied fields that can hold invalid values, checked after the copy.
+  struct fixup_t
+  {
+    uint32_t to;
+    network::Field_Type type;
+  };
+  std::vector<fixup_t> fixups;
+  uint32_t next_record = 0;
+
+  void add_copy(uint32_t from, uint32_t to, uint32_t size)
+  {
+    if (!copies.empty() && copies.back().from + copies.back().size == from &&
+        copies.back().to + copies.back().size == to)
+      copies.back().size += size;
+    else
+      copies.push_back({from, to, size});
+  }
+
+  void add_fixup(uint32_t to, network::Field_Type type)
+  {
+    if (type == network::Field_Type::Bool ||
+        type == network::Field_Type::PascalString ||
+        type == network::Field_Type::RenderComponent)
+      fixups.push_back({to, type});
+  }
+};
+
+std::string_view file_string(const Mapped_File &file, uint64_t offset,
+                             uint32_t length)
+{
+  if (!file.contains(offset, length, 1))
+    return {};
+  return {reinterpret_cast<const char *>(file.data() + offset), length};
+}
+
+template <typename T> T read_at(const Mapped_File &file, uint64_t offset)
+{
+  T value;
+  std::memcpy(&value, file.data() + offset, sizeof(T));
+  return value;
+}
+
+// Fills `plan` for file class `index`. Returns false if the file is broken;
+// a class that no longer exists is not an error (plan.type stays UNKNOWN).
+bool plan_class(const Mapped_File &file, const binary_map_header_t &header,
+                uint32_t index, class_plan_t &plan)
+{
+  uint64_t class_offset = sizeof(binary_map_header_t) +
+                          uint64_t(index) * sizeof(binary_map_class_t);
+  plan.header = read_at<binary_map_class_t>(file, class_offset);
+  const binary_map_class_t &c = plan.header;
+  if (uint64_t(c.first_field) + c.field_count > header.field_count ||
+      !file.contains(c.uids_offset, c.entity_count, sizeof(uint32_t)) ||
+      !file.contains(c.records_offset, c.entity_count, c.record_size))
+    return false;
+
+  std::string_view class_name = file_string(file, c.name_offset, c.name_length);
+  const network::Class_Schema *schema =
+      network::Schema_Registry::get().get_schema(std::string(class_name));
+  if (!schema || schema->class_id == 0 ||
+      schema->class_id >= static_cast<uint16_t>(entity_type::COUNT))
+  {
+    printf("Warning: Unknown entity class in binary map: %.*s\n",
+           static_cast<int>(class_name.size()), class_name.data());
+    return true;
+  }
+  plan.type = static_cast<entity_type>(schema->class_id);
+
+  for (uint32_t i = 0; i < c.field_count; ++i)
+  {
+    auto field = read_at<binary_map_field_t>(
+        file, header.fields_offset +
+                  uint64_t(c.first_field + i) * sizeof(binary_map_field_t));
+    if (uint64_t(field.record_offset) + field.size > c.record_size)
+      return false;
+
+    // Unchanged layout: the file's fields are the schema's, in order.
+    if (c.layout_hash == schema->layout_hash)
+    {
+      if (i >= schema->fields.size() ||
+          field.size != schema->fields[i].size)
+        return false;
+      plan.add_copy(field.record_offset,
+                    static_cast<uint32_t>(schema->fields[i].offset),
+                    field.size);
+      plan.add_fixup(static_cast<uint32_t>(schema->fields[i].offset),
+                     schema->fields[i].type);
+      continue;
+    }
+
+    // Otherwise match fields by name; fields that are gone are dropped and
+    // new ones keep their defaults, as do fields whose type was laid out
+    // differently by the build that wrote the file (their bytes cannot be
+    // read as the type).
+    auto from_type = static_cast<network::Field_Type>(field.type);
+    if (field.type >= network::field_type_count ||
+        field_type_size(from_type) != field.size ||
+        header.type_layouts[field.type] !=
+            network::field_type_layout(from_type))
+      continue;
+    std::string_view name =
+        file_string(file, field.name_offset, field.name_length);
+    for (uint16_t to_index : schema->find_fields(name))
+    {
+      const network::Field_Prop &to = schema->fields[to_index];
+      if (to.type == from_type)
+      {
+        plan.add_copy(field.record_offset, static_cast<uint32_t>(to.offset),
+                      field.size);
+        plan.add_fixup(static_cast<uint32_t>(to.offset), to.type);
+      }
+      else
+        plan.conversions.push_back({field.record_offset, from_type,
+                                    static_cast<uint32_t>(to.offset),
+                                    to.type});
+    }
+  }
+  return true;
+}
+
+// A damaged file can hold bytes that are no value of the field's type: a bool
+// that is neither 0 nor 1, a string longer than its capacity. Makes a copied
+// field valid before anything reads it as its type, in constant time.
+void normalize_field(uint8_t *field, network::Field_Type type)
+{
+  switch (type)
+  {
+  case network::Field_Type::Bool:
+  {
+    uint8_t byte;
+    std::memcpy(&byte, field, 1);
+    byte = byte != 0;
+    std::memcpy(field, &byte, 1);
+    break;
+  }
+  case network::Field_Type::PascalString:
+  {
+    // Terminated at its length, so c_str() agrees with it.
+    auto *text = reinterpret_cast<network::pascal_string *>(field);
+    text->length = std::min(text->length, text->max_length());
+    if (text->length < text->max_length())
+      text->data[text->length] = '\0';
+    break;
+  }
+  case network::Field_Type::RenderComponent:
+    normalize_field(field + offsetof(network::render_component_t, mesh_path),
+                    network::Field_Type::PascalString);
+    normalize_field(field + offsetof(network::render_component_t, visible),
+                    network::Field_Type::Bool);
+    normalize_field(field +
+                        offsetof(network::render_component_t, is_wireframe),
+                    network::Field_Type::Bool);
+    break;
+  default:
+    break; // every bit pattern is a value
+  }
+}
+
+void apply_record(const class_plan_t &plan, const uint8_t *record,
+                  network::Entity *entity)
+{
+  auto *base = reinterpret_cast<uint8_t *>(entity);
+  for (const auto &copy : plan.copies)
+    std::memcpy(base + copy.to, record + copy.from, copy.size);
+  for (const auto &fixup : plan.fixups)
+    normalize_field(base + fixup.to, fixup.type);
+
+  for (const auto &conversion : plan.conversions)
+  {
+    // The record is not aligned for the field's type.
+    alignas(network::render_component_t) uint8_t
+        field[sizeof(network::render_component_t)];
+    static_assert(sizeof(network::render_component_t) >=
+                  sizeof(network::pascal_string));
+    std::memcpy(field, record + conversion.from,
+                field_type_size(conversion.from_type));
+    std::string text;
+    if (network::serialize_field_to_string(field, conversion.from_type, text))
+      network::parse_string_to_field(text, conversion.to_type,
+                                     base + conversion.to);
+  }
+}
+
+bool ends_with(const std::string &text, std::string_view suffix)
+{
+  return text.size() >= suffix.size() &&
+         text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+bool is_binary_map(const std::string &filename)
+{
+  std::ifstream in(filename, std::ios::binary);
+  char magic[sizeof(binary_map_magic)] = {};
+  return in.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, binary_map_magic, sizeof(magic)) == 0;
+}
+
+bool load_map_binary(const std::string &filename, map_t &out_map)
+{
+  Mapped_File file;
+  if (!file.open(filename) || file.size() < sizeof(binary_map_header_t))
+    return false;
+
+  auto header = read_at<binary_map_header_t>(file, 0);
+  if (std::memcmp(header.magic, binary_map_magic, sizeof(header.magic)) != 0 ||
+      header.version != binary_map_version ||
+      !file.contains(sizeof(binary_map_header_t), header.class_count,
+                     sizeof(binary_map_class_t)) ||
+      !file.contains(header.fields_offset, header.field_count,
+                     sizeof(binary_map_field_t)) ||
+      !file.contains(header.order_offset, header.entity_count,
+                     sizeof(uint16_t)))
+    return false;
+
+  network::register_entity_schemas();
+  std::vector<class_plan_t> plans(header.class_count);
+  for (uint32_t i = 0; i < header.class_count; ++i)
+  {
+    if (!plan_class(file, header, i, plans[i]))
+      return false;
+  }
+
+  out_map.clear();
+  out_map.name = file_string(file, header.name_offset, header.name_length);
+  for (const auto &plan : plans)
+  {
+    if (plan.type != entity_type::UNKNOWN && plan.header.entity_count)
+      out_map.reserve(plan.type, plan.header.entity_count);
+  }
+  out_map.entities.reserve(header.entity_count);
+
+  const auto *order = file.data() + header.order_offset;
+  for (uint32_t i = 0; i < header.entity_count; ++i)
+  {
+    uint16_t class_index;
+    std::memcpy(&class_index, order + i * sizeof(uint16_t), sizeof(uint16_t));
+    if (class_index >= plans.size())
+      return false;
+    class_plan_t &plan = plans[class_index];
+    if (plan.next_record >= plan.header.entity_count)
+      return false;
+    uint32_t record = plan.next_record++;
+    if (plan.type == entity_type::UNKNOWN)
+      continue;
+
+    auto uid = read_at<uint32_t>(
+        file, plan.header.uids_offset + uint64_t(record) * sizeof(uint32_t));
+    network::Entity *entity = out_map.create_entity(plan.type, uid).entity;
+    apply_record(plan,
+                 file.data() + plan.header.records_offset +
+                     uint64_t(record) * plan.header.record_size,
+                 entity);
+  }
+  return true;
+}
+
+bool save_map_binary(const std::string &filename, const map_t &map)
+{
+  network::register_entity_schemas();
+
+  struct class_entry_t
+  {
+    const network::Class_Schema *schema;
+    std::vector<const map_entity_t *> entries;
+    uint32_t record_size = 0;
+  };
+  std::vector<class_entry_t> classes;
+  std::array<int32_t, static_cast<size_t>(entity_type::COUNT)> class_of_type;
+  class_of_type.fill(-1);
+  std::vector<uint16_t> order;
+  order.reserve(map.entities.size());
+
+  for (const auto &entry : map.entities)
+  {
+    if (!entry.entity || entry.entity->type == entity_type::UNKNOWN ||
+        entry.entity->type >= entity_type::COUNT)
+      continue;
+    int32_t &index = class_of_type[static_cast<size_t>(entry.entity->type)];
+    if (index < 0)
+    {
+      const network::Class_Schema *schema = entry.entity->get_schema();
+      if (!schema)
+        continue;
+      index = static_cast<int32_t>(classes.size());
+      classes.push_back({schema, {}});
+      for (const auto &field : schema->fields)
+        classes.back().record_size += static_cast<uint32_t>(field.size);
+    }
+    classes[index].entries.push_back(&entry);
+    order.push_back(static_cast<uint16_t>(index));
+  }
+
+  // Lay the file out.
+  auto align8 = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+  binary_map_header_t header = {};
+  std::memcpy(header.magic, binary_map_magic, sizeof(header.magic));
+  header.version = binary_map_version;
+  for (size_t type = 0; type < network::field_type_count; ++type)
+    header.type_layouts[type] =
+        network::field_type_layout(static_cast<network::Field_Type>(type));
+  header.class_count = static_cast<uint32_t>(classes.size());
+  header.entity_count = static_cast<uint32_t>(order.size());
+  for (const auto &c : classes)
+    header.field_count += static_cast<uint32_t>(c.schema->fields.size());
+
+  uint64_t offset = sizeof(binary_map_header_t) +
+                    uint64_t(header.class_count) * sizeof(binary_map_class_t);
+  header.fields_offset = offset;
+  offset += uint64_t(header.field_count) * sizeof(binary_map_field_t);
+  header.order_offset = offset;
+  offset += uint64_t(header.entity_count) * sizeof(uint16_t);
+  uint64_t strings_offset = offset;
+  uint64_t strings_size = map.name.size();
+  for (const auto &c : classes)
+  {
+    strings_size += c.schema->class_name.size();
+    for (const auto &field : c.schema->fields)
+      strings_size += field.name.size();
+  }
+  offset = align8(strings_offset + strings_size);
+
+  std::vector<binary_map_class_t> class_headers(classes.size());
+  for (size_t i = 0; i < classes.size(); ++i)
+  {
+    binary_map_class_t &c = class_headers[i];
+    c.entity_count = static_cast<uint32_t>(classes[i].entries.size());
+    c.record_size = classes[i].record_size;
+    c.uids_offset = offset;
+    offset = align8(offset + uint64_t(c.entity_count) * sizeof(uint32_t));
+    c.records_offset = offset;
+    offset = align8(offset + uint64_t(c.entity_count) * c.record_size);
+  }
+
+  std::vector<uint8_t> out(offset, 0);
+  uint64_t next_string = strings_offset;
+  auto put_string = [&](const std::string &text, uint64_t &at, uint32_t &size)
+  {
+    at = next_string;
+    size = static_cast<uint32_t>(text.size());
+    std::memcpy(out.data() + next_string, text.data(), text.size());
+    next_string += text.size();
+  };
+  put_string(map.name, header.name_offset, header.name_length);
+
+  uint32_t next_field = 0;
+  for (size_t i = 0; i < classes.size(); ++i)
+  {
+    const network::Class_Schema &schema = *classes[i].schema;
+    binary_map_class_t &c = class_headers[i];
+    c.layout_hash = schema.layout_hash;
+    put_string(schema.class_name, c.name_offset, c.name_length);
+    c.first_field = next_field;
+    c.field_count = static_cast<uint32_t>(schema.fields.size());
+
+    uint32_t record_offset = 0;
+    for (const auto &field : schema.fields)
+    {
+      binary_map_field_t f = {};
+      put_string(field.name, f.name_offset, f.name_length);
+      f.type = static_cast<uint32_t>(field.type);
+      f.size = static_cast<uint32_t>(field.size);
+      f.record_offset = record_offset;
+      record_offset += f.size;
+      std::memcpy(out.data() + header.fields_offset +
+                      uint64_t(next_field++) * sizeof(binary_map_field_t),
+                  &f, sizeof(f));
+    }
+
+    for (uint32_t e = 0; e < c.entity_count; ++e)
+    {
+      const map_entity_t &entry = *classes[i].entries[e];
+      std::memcpy(out.data() + c.uids_offset + e * sizeof(uint32_t),
+                  &entry.uid, sizeof(uint32_t));
+      const auto *base = reinterpret_cast<const uint8_t *>(entry.entity);
+      uint8_t *record =
+          out.data() + c.records_offset + uint64_t(e) * c.record_size;
+      for (const auto &field : schema.fields)
+      {
+        std::memcpy(record, base + field.offset, field.size);
+        record += field.size;
+      }
+    }
+    std::memcpy(out.data() + sizeof(binary_map_header_t) +
+                    i * sizeof(binary_map_class_t),
+                &c, sizeof(c));
+  }
+  std::memcpy(out.data() + header.order_offset, order.data(),
+              order.size() * sizeof(uint16_t));
+  std::memcpy(out.data(), &header, sizeof(header));
+
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open())
+    return false;
+  file.write(reinterpret_cast<const char *>(out.data()),
+             static_cast<std::streamsize>(out.size()));
+  return static_cast<bool>(file);
+}
+
+bool convert_map(const std::string &from, const std::string &to)
+{
+  map_t map;
+  if (!load_map(from, map))
+    return false;
+  if (ends_with(to, binary_map_extension))
+    return save_map_binary(to, map);
+  return save_map(to, map);
+}
+
+} // namespace shared
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "network_types.hpp"
+#include "udp_socket.hpp"
+#include <array>
+#include <bit>
+
+namespace network
+{
+
+// Open-addressed Address -> player slot map with linear probing, sized at
+// twice the slot count so probes stay short. Erasing shifts the rest of the
+// probe run back instead of leaving tombstones, so lookups never degrade
+// with connect/disconnect churn.
+template <size_t Max_Entries> class Address_Table
+{
+public:
+  static constexpr size_t capacity = std::bit_ceil(Max_Entries * 2);
+  static constexpr int not_found = -1;
+
+  int find(const Address &address) const
+  {
+    for (size_t i = home_of(address);; i = next(i))
+    {
+      const entry_t &entry = entries[i];
+      if (entry.slot == not_found)
+        return not_found;
+      if (entry.address == address)
+        return entry.slot;
+    }
+  }
+
+  // Maps `address` to `slot`, replacing an existing mapping. False if the
+  // table is full.
+  bool insert(const Address &address, int slot)
+  {
+    for (size_t i = home_of(address);; i = next(i))
+    {
+      entry_t &entry = entries[i];
+      if (entry.slot != not_found && entry.address != address)
+        continue;
+      if (entry.slot == not_found)
+      {
+        if (count == Max_Entries)
+          return false;
+        count += 1;
+      }
+      entry.address = address;
+      entry.slot = slot;
+      return true;
+    }
+  }
+
+  void erase(const Address &address)
+  {
+    size_t hole = home_of(address);
+    while (entries[hole].slot != not_found && entries[hole].address != address)
+      hole = next(hole);
+    if (entries[hole].slot == not_found)
+      return;
+
+    // Move later entries of the run into the hole unless that would put them
+    // before their home position.
+    for (size_t i = next(hole); entries[i].slot != not_found; i = next(i))
+    {
+      size_t home = home_of(entries[i].address);
+      bool movable = hole <= i ? (home <= hole || home > i)
+                               : (home <= hole && home > i);
+      if (movable)
+      {
+        entries[hole] = entries[i];
+        hole = i;
+      }
+    }
+    entries[hole] = {};
+    count -= 1;
+  }
+
+  void clear()
+  {
+    entries.fill({});
+    count = 0;
+  }
+
+  size_t size() const { return count; }
+
+private:
+  struct entry_t
+  {
+    Address address;
+    int slot = not_found;
+  };
+
+  static size_t home_of(const Address &address)
+  {
+    uint64 key = uint64(address.ip_v4) << 16 | address.port;
+    // Fibonacci hashing: the top bits of the product are well mixed.
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >>
+                               (64 - std::countr_zero(capacity)));
+  }
+
+  static size_t next(size_t i) { return (i + 1) & (capacity - 1); }
+
+  std::array<entry_t, capacity> entries{};
+  size_t count = 0;
+};
+
+} // namespace network
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "quantization.hpp"
+#include "schema.hpp"
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace network
+{
+
+// Short description of how serialize_fields() writes `field`, e.g.
+// "range:7", "angle:16", "group7".
+inline std::string field_encoding_name(const Field_Prop &field)
+{
+  const Field_Quantization &q = field.quantization;
+  switch (field.type)
+  {
+  case Field_Type::Int32:
+    if (q.mode == Quantization::Range)
+      return std::format("range:{}", q.bits);
+    return int_coding_name(q.int_coding);
+  case Field_Type::Float32:
+  case Field_Type::Vec3f:
+  {
+    std::string name;
+    switch (q.mode)
+    {
+    case Quantization::Range:
+      name = std::format("range:{}", q.bits);
+      break;
+    case Quantization::Angle:
+      name = std::format("angle:{}", q.bits);
+      break;
+    case Quantization::Unit_Normal:
+      return std::format("octahedral:2x{}", q.bits);
+    case Quantization::Position:
+      name = std::format("position:{}", q.bits);
+      break;
+    default:
+      name = "coord";
+      break;
+    }
+    return field.type == Field_Type::Vec3f ? "3x " + name : name;
+  }
+  case Field_Type::Bool:
+    return "bit";
+  case Field_Type::PascalString:
+    return "pascal_string";
+  case Field_Type::RenderComponent:
+    return "render_component";
+  }
+  return "unknown";
+}
+
+struct field_bits_t;
+
+// Bits the snapshot stream spends per (class, field, encoding), summed over
+// a session. Off by default; while enabled, the snapshot encoders log the
+// bits of every field they write alongside each record (see
+// serialize_changed_fields), and the record is counted each time it is
+// written into a client's stream, so a record shared by N clients counts N
+// times and one deferred by a bandwidth budget not at all. Counters are
+// atomics so the snapshot workers can record concurrently; a lock is only
+// taken once per encoded record, to find its class.
+class Bandwidth_Profiler
+{
+public:
+  static Bandwidth_Profiler &get()
+  {
+    static Bandwidth_Profiler instance;
+    return instance;
+  }
+
+  struct row_t
+  {
+    std::string class_name;
+    std::string field_name;
+    std::string encoding;
+    uint64 count = 0; // times the field was written
+    uint64 bits = 0;
+
+    double average_bits() const { return count ? double(bits) / count : 0.0; }
+  };
+
+  void set_enabled(bool enabled)
+  {
+    is_enabled.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool enabled() const { return is_enabled.load(std::memory_order_relaxed); }
+
+  // Per-field counters of one class, plus one for the changed-field mask at
+  // index schema->fields.size().
+  class Class_Counters
+  {
+  public:
+    void record(size_t field_index, size_t bits)
+    {
+      counters[field_index].count.fetch_add(1, std::memory_order_relaxed);
+      counters[field_index].bits.fetch_add(bits, std::memory_order_relaxed);
+    }
+
+  private:
+    friend class Bandwidth_Profiler;
+
+    struct counter_t
+    {
+      std::atomic<uint64> count = 0;
+      std::atomic<uint64> bits = 0;
+    };
+
+    explicit Class_Counters(const Class_Schema *schema)
+        : schema(schema), counters(schema->fields.size() + 1)
+    {
+    }
+
+    const Class_Schema *schema;
+    std::vector<counter_t> counters;
+  };
+
+  Class_Counters &counters_for(const Class_Schema *schema)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &counters = classes[schema];
+    if (!counters)
+      counters.reset(new Class_Counters(schema));
+    return *counters;
+  }
+
+  // Counts one record that was sent, from its logged field bits.
+  static void record_sent(std::span<const field_bits_t> record);
+
+  // Everything recorded so far, most bits first. Fields never written are
+  // left out.
+  std::vector<row_t> rows() const
+  {
+    std::vector<row_t> result;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &[schema, counters] : classes)
+    {
+      for (size_t i = 0; i < counters->counters.size(); ++i)
+      {
+        const auto &counter = counters->counters[i];
+        uint64 count = counter.count.load(std::memory_order_relaxed);
+        if (count == 0)
+          continue;
+
+        row_t row;
+        row.class_name = schema->class_name;
+        if (i < schema->fields.size())
+        {
+          row.field_name = schema->fields[i].name;
+          row.encoding = field_encoding_name(schema->fields[i]);
+        }
+        else
+        {
+          row.field_name = "(changed mask)";
+          row.encoding = "bit per field";
+        }
+        row.count = count;
+        row.bits = counter.bits.load(std::memory_order_relaxed);
+        result.push_back(std::move(row));
+      }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const row_t &a, const row_t &b) { return a.bits > b.bits; });
+    return result;
+  }
+
+  // rows() as a table, at most `max_rows` of them.
+  std::string report(size_t max_rows = 32) const
+  {
+    std::vector<row_t> all = rows();
+    uint64 total_bits = 0;
+    for (const auto &row : all)
+      total_bits += row.bits;
+
+    std::string text = std::format("{:<20} {:<24} {:<18} {:>10} {:>12} {:>8} "
+                                   "{:>6}\n",
+                                   "class", "field", "encoding", "writes",
+                                   "bytes", "avg bits", "share");
+    for (size_t i = 0; i < all.size() && i < max_rows; ++i)
+    {
+      const row_t &row = all[i];
+      text += std::format("{:<20} {:<24} {:<18} {:>10} {:>12} {:>8.1f} "
+                          "{:>5.1f}%\n",
+                          row.class_name, row.field_name, row.encoding,
+                          row.count, row.bits / 8, row.average_bits(),
+                          100.0 * double(row.bits) / double(total_bits));
+    }
+    text += std::format("{} bytes of field data in total\n", total_bits / 8);
+    return text;
+  }
+
+  // Drops every counter. Not safe while anything is recording.
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    classes.clear();
+  }
+
+private:
+  std::atomic<bool> is_enabled = false;
+  mutable std::mutex mutex;
+  std::unordered_map<const Class_Schema *, std::unique_ptr<Class_Counters>>
+      classes;
+};
+
+// What one record spent on one of its fields (field_index ==
+// schema->fields.size() for the changed-field mask).
+struct field_bits_t
+{
+  Bandwidth_Profiler::Class_Counters *counters;
+  uint32 field_index;
+  uint32 bits;
+};
+
+inline void Bandwidth_Profiler::record_sent(
+    std::span<const field_bits_t> record)
+{
+  for (const field_bits_t &field : record)
+    field.counters->record(field.field_index, field.bits);
+}
+
+} // namespace network
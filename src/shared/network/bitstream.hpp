@@ -2,80 +2,218 @@
 
 #include "network_types.hpp"
 #include <algorithm>
+#include <bit>
 #include <cstring>
 #include <vector>
 
-//@NOTE(SJM): we need to be very careful about aligned reads and writes: I am
-//always
-// under the impression that just advancing bit by bit should be fine but i'm
-// not sure if that's actually true on at least mac / windows.
+// Wire format: bits are packed LSB-first into bytes, bytes are laid out in
+// stream order. The writer accumulates bits in a 64-bit scratch register and
+// only touches the byte buffer when a whole word is full, the reader pulls an
+// (unaligned) 64-bit window from the buffer for every read. Both are
+// bit-for-bit identical to writing / reading the stream one bit at a time.
+// Words are little endian on the wire regardless of the host byte order.
 
 namespace network
 {
 
+namespace bitstream_detail
+{
+
+inline void store_le64(uint8 *out, uint64 value, size_t byte_count)
+{
+  if constexpr (std::endian::native == std::endian::little)
+  {
+    std::memcpy(out, &value, byte_count);
+    return;
+  }
+  for (size_t i = 0; i < byte_count; ++i)
+  {
+    out[i] = static_cast<uint8>(value >> (i * 8));
+  }
+}
+
+inline uint64 load_le64(const uint8 *in, size_t byte_count)
+{
+  uint64 value = 0;
+  if constexpr (std::endian::native == std::endian::little)
+  {
+    std::memcpy(&value, in, byte_count);
+    return value;
+  }
+  for (size_t i = 0; i < byte_count; ++i)
+  {
+    value |= static_cast<uint64>(in[i]) << (i * 8);
+  }
+  return value;
+}
+
+inline uint64 low_bits_mask(int bits)
+{
+  return bits >= 64 ? ~uint64{0} : ((uint64{1} << bits) - 1);
+}
+
+} // namespace bitstream_detail
+
 class Bit_Writer
 {
 public:
-  std::vector<uint8> buffer;
-  int bit_index = 0;
+  // Total number of bits written so far (including align() padding).
+  size_t bits_written() const { return committed_bytes * 8 + scratch_bits; }
+
+  size_t bytes_written() const { return (bits_written() + 7) / 8; }
+
+  // Moves any pending scratch bits into the byte buffer and returns it. The
+  // returned buffer always holds exactly bytes_written() bytes. Writing may
+  // continue after this call.
+  const std::vector<uint8> &flush()
+  {
+    size_t pending_bytes = (scratch_bits + 7) / 8;
+    buffer.resize(committed_bytes + pending_bytes);
+    bitstream_detail::store_le64(buffer.data() + committed_bytes, scratch,
+                                 pending_bytes);
+    return buffer;
+  }
+
+  void reset()
+  {
+    buffer.clear();
+    committed_bytes = 0;
+    scratch = 0;
+    scratch_bits = 0;
+  }
+
+  // Reserve room for a payload of roughly this many bytes up front.
+  void reserve(size_t byte_count) { buffer.reserve(byte_count); }
 
   void align()
   {
-    // Simple byte alignment
-    if (bit_index % 8 != 0)
+    // Simple byte alignment: padding bits are zero.
+    scratch_bits = (scratch_bits + 7) & ~7;
+    if (scratch_bits == 64)
     {
-      bit_index += (8 - (bit_index % 8));
+      commit_word();
     }
   }
 
-  void write_bytes(const void *data, size_t size)
+  void write_bit(bool value) { write_bits(value ? 1u : 0u, 1); }
+
+  // Writes the low `bits` bits of value (bits <= 32).
+  void write_bits(uint32_t value, int bits)
   {
-    align();
-    size_t current_byte = bit_index / 8;
-    size_t needed_size = current_byte + size;
+    if (bits <= 0)
+      return;
+
+    uint64 v =
+        static_cast<uint64>(value) & bitstream_detail::low_bits_mask(bits);
+    scratch |= v << scratch_bits;
+    scratch_bits += bits;
 
-    if (buffer.size() < needed_size)
+    if (scratch_bits >= 64)
     {
-      buffer.resize(needed_size);
+      int overflow = scratch_bits - 64;
+      commit_word();
+      // The bits that did not fit in the previous word.
+      scratch = overflow ? (v >> (bits - overflow)) : 0;
+      scratch_bits = overflow;
     }
+  }
 
-    std::memcpy(buffer.data() + current_byte, data, size);
-    bit_index += size * 8;
+  // Writes the low `bits` bits of value (bits <= 64).
+  void write_bits64(uint64 value, int bits)
+  {
+    if (bits > 32)
+    {
+      write_bits(static_cast<uint32_t>(value), 32);
+      write_bits(static_cast<uint32_t>(value >> 32), bits - 32);
+    }
+    else
+    {
+      write_bits(static_cast<uint32_t>(value), bits);
+    }
   }
 
-  // A real implementation would handle bit-level writes (e.g. Bool as 1 bit)
-  // For this prototype, we'll just write bools as bytes for simplicity or impl
-  // later. Let's implement a simple bit write for bools.
+  void write_byte(uint8_t value) { write_bits(value, 8); }
 
-  void write_bit(bool value)
+  // Byte-aligned bulk copy (aligns first).
+  void write_bytes(const void *data, size_t size)
   {
-    size_t byte_pos = bit_index / 8;
-    size_t bit_pos = bit_index % 8;
+    align();
+    write_bytes_unaligned(data, size);
+  }
+
+  // Copies `size` bytes at the current bit position without aligning. The
+  // result is identical to calling write_byte() for every byte, but whole
+  // words are moved at a time (and a plain memcpy is used when the stream
+  // happens to be byte aligned).
+  void write_bytes_unaligned(const void *data, size_t size)
+  {
+    const uint8 *src = static_cast<const uint8 *>(data);
 
-    if (buffer.size() <= byte_pos)
+    if ((scratch_bits & 7) == 0)
     {
-      buffer.push_back(0);
+      // Byte aligned: drain the scratch register and memcpy the bulk.
+      size_t pending_bytes = scratch_bits / 8;
+      buffer.resize(committed_bytes + pending_bytes + size);
+      bitstream_detail::store_le64(buffer.data() + committed_bytes, scratch,
+                                   pending_bytes);
+      committed_bytes += pending_bytes;
+      scratch = 0;
+      scratch_bits = 0;
+
+      // Keep the tail in the scratch register so subsequent bit writes stay
+      // on the fast path.
+      size_t tail = size % 8;
+      size_t bulk = size - tail;
+      std::memcpy(buffer.data() + committed_bytes, src, bulk);
+      committed_bytes += bulk;
+      scratch = bitstream_detail::load_le64(src + bulk, tail);
+      scratch_bits = static_cast<int>(tail * 8);
+      return;
     }
 
-    if (value)
+    while (size >= 4)
     {
-      buffer[byte_pos] |= (1 << bit_pos);
+      uint32_t word =
+          static_cast<uint32_t>(bitstream_detail::load_le64(src, 4));
+      write_bits(word, 32);
+      src += 4;
+      size -= 4;
     }
-    else
+    while (size > 0)
     {
-      buffer[byte_pos] &= ~(1 << bit_pos);
+      write_bits(*src, 8);
+      ++src;
+      --size;
     }
-    bit_index++;
   }
-  void write_bits(uint32_t value, int bits)
+
+  // Appends `bit_count` bits from a packed LSB-first bit buffer (e.g. the
+  // flushed output of another Bit_Writer) at the current bit position.
+  void write_bit_span(const uint8 *data, size_t bit_count)
   {
-    for (int i = 0; i < bits; ++i)
+    size_t whole_bytes = bit_count / 8;
+    write_bytes_unaligned(data, whole_bytes);
+    int rest = static_cast<int>(bit_count % 8);
+    if (rest)
     {
-      write_bit((value >> i) & 1);
+      write_bits(data[whole_bytes], rest);
     }
   }
 
-  void write_byte(uint8_t value) { write_bits(value, 8); }
+private:
+  void commit_word()
+  {
+    buffer.resize(committed_bytes + 8);
+    bitstream_detail::store_le64(buffer.data() + committed_bytes, scratch, 8);
+    committed_bytes += 8;
+    scratch = 0;
+    scratch_bits = 0;
+  }
+
+  std::vector<uint8> buffer;
+  size_t committed_bytes = 0; // bytes in `buffer` that are final
+  uint64 scratch = 0;         // pending bits, LSB = next bit in the stream
+  int scratch_bits = 0;       // number of valid bits in scratch (< 64)
 };
 
 class Bit_Reader
@@ -83,7 +221,7 @@ class Bit_Reader
 public:
   const uint8 *buffer;
   size_t size;
-  int bit_index = 0;
+  size_t bit_index = 0;
 
   Bit_Reader(const uint8 *buf, size_t sz) : buffer(buf), size(sz) {}
 
@@ -95,6 +233,12 @@ public:
     }
   }
 
+  size_t bits_remaining() const
+  {
+    size_t total = size * 8;
+    return bit_index < total ? total - bit_index : 0;
+  }
+
   uint8_t read_byte()
   {
     align();
@@ -122,6 +266,35 @@ public:
     bit_index += count * 8;
   }
 
+  // Reads `count` bytes at the current bit position without aligning. This is
+  // the counterpart of Bit_Writer::write_bytes_unaligned.
+  void read_bytes_unaligned(void *out_data, size_t count)
+  {
+    uint8 *dst = static_cast<uint8 *>(out_data);
+    if ((bit_index & 7) == 0)
+    {
+      size_t byte_pos = bit_index / 8;
+      size_t available = byte_pos < size ? size - byte_pos : 0;
+      size_t n = std::min(count, available);
+      std::memcpy(dst, buffer + byte_pos, n);
+      std::memset(dst + n, 0, count - n);
+      bit_index += count * 8;
+      return;
+    }
+
+    while (count >= 4)
+    {
+      bitstream_detail::store_le64(dst, read_bits(32), 4);
+      dst += 4;
+      count -= 4;
+    }
+    while (count > 0)
+    {
+      *dst++ = static_cast<uint8>(read_bits(8));
+      --count;
+    }
+  }
+
   bool read_bit()
   {
     size_t byte_pos = bit_index / 8;
@@ -135,17 +308,42 @@ public:
     return val;
   }
 
+  // Reads `bits` bits (bits <= 32). Bits past the end of the buffer read as 0.
   uint32_t read_bits(int bits)
   {
-    uint32_t value = 0;
-    for (int i = 0; i < bits; ++i)
+    if (bits <= 0)
+      return 0;
+
+    // 32 requested bits + up to 7 bits of sub-byte offset always fit in the
+    // 64-bit window.
+    uint64 window = peek_window();
+    int shift = static_cast<int>(bit_index % 8);
+    bit_index += bits;
+    return static_cast<uint32_t>((window >> shift) &
+                                 bitstream_detail::low_bits_mask(bits));
+  }
+
+  uint64 read_bits64(int bits)
+  {
+    if (bits > 32)
     {
-      if (read_bit())
-      {
-        value |= (1 << i);
-      }
+      uint64 low = read_bits(32);
+      uint64 high = read_bits(bits - 32);
+      return low | (high << 32);
     }
-    return value;
+    return read_bits(bits);
+  }
+
+private:
+  // Loads 8 bytes starting at the byte containing bit_index, zero padded
+  // past the end of the buffer.
+  uint64 peek_window() const
+  {
+    size_t byte_pos = bit_index / 8;
+    if (byte_pos >= size)
+      return 0;
+    size_t available = std::min<size_t>(8, size - byte_pos);
+    return bitstream_detail::load_le64(buffer + byte_pos, available);
   }
 };
 
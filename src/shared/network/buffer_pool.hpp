@@ -0,0 +1,121 @@
+#pragma once
+
+#include "network_types.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace network
+{
+
+// Per-connection scratch bytes. Empty until reserved from a Buffer_Pool.
+struct Byte_Buffer
+{
+  std::vector<uint8> data; // data.size() is the capacity
+  size_t cursor = 0;       // byte_offset to insert at.
+};
+
+// Hands out Byte_Buffer storage in power-of-two size classes and keeps
+// released storage for the next connection, so a server only pays for the
+// buffers its players actually grew to, once. Not thread safe; owned by the
+// network thread like the rest of Server_Connection_State.
+class Buffer_Pool
+{
+public:
+  static constexpr size_t min_class_bytes = 256;
+  static constexpr size_t max_class_bytes = 2048 * 2048;
+  static constexpr size_t class_count = 15; // 256 B .. 4 MB
+  static_assert(min_class_bytes << (class_count - 1) == max_class_bytes);
+
+  struct stats_t
+  {
+    size_t bytes_in_use = 0;      // capacity held by Byte_Buffers
+    size_t bytes_pooled = 0;      // capacity released and kept for reuse
+    size_t peak_bytes_in_use = 0;
+    uint64 allocations = 0;       // storage taken from the heap
+    uint64 reuses = 0;            // storage taken from the pool
+  };
+
+  // Makes room for at least `bytes` in `buffer`, moving it up to a larger
+  // size class if needed; the first `cursor` bytes are kept. Returns false
+  // (leaving the buffer as it was) if `bytes` is over max_class_bytes.
+  bool reserve(Byte_Buffer &buffer, size_t bytes)
+  {
+    if (bytes <= buffer.data.size())
+      return true;
+    if (bytes > max_class_bytes)
+      return false;
+
+    std::vector<uint8> storage = take(class_of(bytes));
+    size_t kept = std::min(buffer.cursor, buffer.data.size());
+    if (kept > 0)
+      std::memcpy(storage.data(), buffer.data.data(), kept);
+    give_back(buffer.data);
+    buffer.data = std::move(storage);
+    return true;
+  }
+
+  // Returns the buffer's storage to the pool and empties it.
+  void release(Byte_Buffer &buffer)
+  {
+    give_back(buffer.data);
+    buffer.cursor = 0;
+  }
+
+  // Frees everything kept for reuse.
+  void trim()
+  {
+    for (auto &free_list : free_lists)
+      free_list.clear();
+    pool_stats.bytes_pooled = 0;
+  }
+
+  const stats_t &stats() const { return pool_stats; }
+
+private:
+  static size_t class_of(size_t bytes)
+  {
+    size_t size_class = 0;
+    while ((min_class_bytes << size_class) < bytes)
+      size_class += 1;
+    return size_class;
+  }
+
+  std::vector<uint8> take(size_t size_class)
+  {
+    size_t bytes = min_class_bytes << size_class;
+    pool_stats.bytes_in_use += bytes;
+    pool_stats.peak_bytes_in_use =
+        std::max(pool_stats.peak_bytes_in_use, pool_stats.bytes_in_use);
+
+    auto &free_list = free_lists[size_class];
+    if (free_list.empty())
+    {
+      pool_stats.allocations += 1;
+      return std::vector<uint8>(bytes);
+    }
+    pool_stats.reuses += 1;
+    pool_stats.bytes_pooled -= bytes;
+    std::vector<uint8> storage = std::move(free_list.back());
+    free_list.pop_back();
+    return storage;
+  }
+
+  // Only storage from take() comes back here, so its size is a class size.
+  void give_back(std::vector<uint8> &storage)
+  {
+    if (storage.empty())
+      return;
+    size_t bytes = storage.size();
+    pool_stats.bytes_in_use -= bytes;
+    pool_stats.bytes_pooled += bytes;
+    free_lists[class_of(bytes)].push_back(std::move(storage));
+    storage = {};
+  }
+
+  std::array<std::vector<std::vector<uint8>>, class_count> free_lists;
+  stats_t pool_stats;
+};
+
+} // namespace network
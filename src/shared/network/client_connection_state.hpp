@@ -2,8 +2,12 @@
 
 #include "game.pb.h"
 #include "network_types.hpp"
+#include "reassembly.hpp"
+#include "snapshot_history.hpp"
 #include "udp_socket.hpp"
-#include <map>
+#include "usercmd.hpp"
+#include <array>
+#include <chrono>
 #include <vector>
 
 namespace network
@@ -14,10 +18,20 @@ struct Client_Connection_State
   Udp_Socket socket;
   Address server_address;
   bool connected = false;
+  // From CmdAccept; stamped on every packet we send (0 until accepted).
+  uint16 connection_token = 0;
 
-  // Buffer for packets received FROM the server
-  // Indexed by packet sequence header
-  std::map<uint8, std::vector<Packet>> partial_packets;
+  // Reassembles messages received FROM the server. Full snapshots can take
+  // the whole 255 fragments a sequence allows.
+  Reassembly_Ring reassembly{4, 255};
+
+  // Our latest input, resent in every usercmd datagram; see send_usercmd.
+  Usercmd_Buffer usercmds;
+  Bit_Writer usercmd_writer;
+
+  // Decoded snapshots, kept as baselines for the server's deltas.
+  Snapshot_Ring snapshots;
+  uint32 last_snapshot_tick = 0;
 };
 
 struct ClientInbox
@@ -36,11 +50,33 @@ inline void send_protobuf_message(Client_Connection_State &state, const T &msg)
   constexpr uint8 msg_type_id = static_cast<uint8>(Packet_Traits<T>::type);
 
   auto packets = convert_to_packets(buffer, msg_type_id);
+  for (auto &packet : packets)
+    packet.header.connection_token = state.connection_token;
+  state.socket.send_batch(packets, state.server_address);
+}
 
-  for (const auto &packet : packets)
-  {
-    state.socket.send(packet, state.server_address);
-  }
+// Queues `cmd` (numbered here) and sends it to the server together with the
+// commands before it. One datagram, built in place: nothing is allocated
+// once usercmd_writer has grown.
+inline void send_usercmd(Client_Connection_State &state, const usercmd_t &cmd,
+                         size_t redundancy = max_usercmds_per_packet / 2)
+{
+  state.usercmds.push(cmd);
+
+  Bit_Writer &writer = state.usercmd_writer;
+  writer.reset();
+  state.usercmds.write(writer, redundancy);
+  const std::vector<uint8> &bytes = writer.flush();
+
+  Packet packet;
+  packet.header = {};
+  packet.padding_for_alignment = 0;
+  packet.header.message_type = static_cast<uint8>(Message_Type::C2S_UserCmds);
+  packet.header.sequence_count = 1;
+  packet.header.payload_size = static_cast<uint16>(bytes.size());
+  packet.header.connection_token = state.connection_token;
+  std::memcpy(packet.buffer, bytes.data(), bytes.size());
+  state.socket.send(packet, state.server_address);
 }
 
 inline void poll_client_network(Client_Connection_State &state,
@@ -50,62 +86,97 @@ inline void poll_client_network(Client_Connection_State &state,
   auto start_time = clock::now();
   auto timeout = std::chrono::duration<double>(time_window);
 
+  std::array<Packet, 16> packets;
+  std::array<Address, 16> senders;
+
   while (true)
   {
     auto now = clock::now();
     if (now - start_time >= timeout)
       break;
 
-    Packet packet;
-    Address sender;
-    if (state.socket.receive(packet, sender))
+    size_t received = state.socket.receive_batch(packets, senders);
+    for (size_t i = 0; i < received; ++i)
     {
+      const Packet &packet = packets[i];
+      const Address &sender = senders[i];
+
       if (sender != state.server_address)
         continue;
 
+      std::span<const uint8> buffer =
+          state.reassembly.insert(packet, Reassembly_Ring::clock::now());
+      if (buffer.empty())
+        continue;
+
       if (packet.header.message_type ==
           static_cast<uint8>(Message_Type::NetCommand))
       {
-        auto &fragments = state.partial_packets[packet.header.sequence_id];
-
-        if (fragments.empty())
-          fragments.resize(packet.header.sequence_count);
-
-        // Safety check
-        if (packet.header.sequence_idx < fragments.size())
-          fragments[packet.header.sequence_idx] = packet;
-
-        bool complete = true;
-        size_t total_size = 0;
-        for (const auto &f : fragments)
+        game::NetCommand cmd;
+        if (cmd.ParseFromArray(buffer.data(), static_cast<int>(buffer.size())))
         {
-          if (f.header.sequence_count == 0 || f.header.payload_size == 0)
-          {
-            complete = false;
-            break;
-          }
-          total_size += f.header.payload_size;
+          out_inbox.net_commands.push_back(cmd);
         }
-
-        if (complete)
+      }
+      else if (packet.header.message_type ==
+               static_cast<uint8>(Message_Type::S2C_EntityPackage))
+      {
+        game::S2C_EntityPackage package;
+        if (package.ParseFromArray(buffer.data(),
+                                   static_cast<int>(buffer.size())))
         {
-          std::vector<uint8> buffer;
-          buffer.reserve(total_size);
-          for (const auto &f : fragments)
-            buffer.insert(buffer.end(), f.buffer,
-                          f.buffer + f.header.payload_size);
-
-          game::NetCommand cmd;
-          if (cmd.ParseFromArray(buffer.data(), buffer.size()))
-          {
-            out_inbox.net_commands.push_back(cmd);
-          }
-          state.partial_packets.erase(packet.header.sequence_id);
+          out_inbox.entity_updates.push_back(std::move(package));
         }
       }
-      // TODO: Handle EntityPackage
     }
   }
 }
 
+// Decodes a snapshot against the stored baseline it was encoded against,
+// stores it and acknowledges it to the server. Returns the decoded snapshot,
+// or nullptr if it could not be decoded (its baseline is gone, it is older
+// than what we already have, or it is malformed). In that case nothing is
+// acked and the server keeps encoding against our previous ack, falling back
+// to a full snapshot once that ages out. If `events` is given it receives the
+// entities that entered and left our view since the previous snapshot.
+inline const snapshot_t *
+receive_snapshot(Client_Connection_State &state,
+                 const game::S2C_EntityPackage &package,
+                 snapshot_events_t *events = nullptr)
+{
+  uint32 tick = package.tick();
+  if (tick == 0 || tick <= state.last_snapshot_tick)
+    return nullptr;
+
+  const snapshot_t *baseline = nullptr;
+  if (package.is_delta())
+  {
+    baseline = state.snapshots.find(
+        static_cast<uint32>(package.update_baseline()));
+    if (!baseline)
+      return nullptr;
+  }
+
+  const std::string &data = package.entity_data();
+  Bit_Reader reader(reinterpret_cast<const uint8 *>(data.data()), data.size());
+  snapshot_t decoded;
+  decoded.tick = tick;
+  if (!read_snapshot(reader, baseline, decoded))
+    return nullptr;
+
+  if (events)
+  {
+    diff_snapshot_entities(state.snapshots.find(state.last_snapshot_tick),
+                           decoded, *events);
+  }
+  state.snapshots.store(std::move(decoded));
+  state.last_snapshot_tick = tick;
+
+  game::NetCommand ack;
+  ack.mutable_snapshot_ack()->set_tick(tick);
+  send_protobuf_message(state, ack);
+
+  return state.snapshots.find(tick);
+}
+
 } // namespace network
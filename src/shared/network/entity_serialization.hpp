@@ -23,7 +23,8 @@ void pack_entity_delta_for_update(game::S2C_EntityPackage &out_packet,
   entity.serialize(writer, baseline);
 
   // set_entity_data takes a std::string or char* buffer
-  out_packet.set_entity_data(writer.buffer.data(), writer.buffer.size());
+  const auto &bytes = writer.flush();
+  out_packet.set_entity_data(bytes.data(), bytes.size());
 }
 
 } // namespace network
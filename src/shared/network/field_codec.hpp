@@ -0,0 +1,181 @@
+#pragma once
+
+#include "quantization.hpp"
+#include "schema.hpp"
+#include <cmath>
+#include <cstring>
+
+// The per-field encoders behind serialize_fields() / deserialize_fields().
+// Each one handles a single (Field_Type, encoding) pair with the encoding
+// fixed at compile time; make_field_codec() picks the right pair for every
+// field once, when its class is registered, and stores them in
+// Class_Schema::codecs. Serializing an entity is then a walk over the set
+// bits of its change mask with one indirect call per changed field.
+
+namespace network
+{
+
+namespace codec_detail
+{
+
+template <typename T> T load(const uint8 *field)
+{
+  T value;
+  std::memcpy(&value, field, sizeof(T));
+  return value;
+}
+
+template <typename T> void store(uint8 *field, const T &value)
+{
+  std::memcpy(field, &value, sizeof(T));
+}
+
+// --- Int32 ---
+
+template <Int_Coding Coding>
+void write_int_coded(Bit_Writer &w, const uint8 *field,
+                     const Field_Quantization &)
+{
+  write_coded_int_as<Coding>(w, load<int32_t>(field));
+}
+
+template <Int_Coding Coding>
+void read_int_coded(Bit_Reader &r, uint8 *field, const Field_Quantization &)
+{
+  store(field, read_coded_int_as<Coding>(r));
+}
+
+inline void write_int_range(Bit_Writer &w, const uint8 *field,
+                            const Field_Quantization &q)
+{
+  w.write_bits(encode_fixed(float(load<int32_t>(field)), q), q.bits);
+}
+
+inline void read_int_range(Bit_Reader &r, uint8 *field,
+                           const Field_Quantization &q)
+{
+  float value = decode_fixed(r.read_bits(q.bits), q);
+  store(field, static_cast<int32_t>(std::lround(value)));
+}
+
+// --- Float32 / Vec3f ---
+
+template <Quantization Mode>
+void write_float(Bit_Writer &w, const uint8 *field,
+                 const Field_Quantization &q)
+{
+  write_quantized_as<Mode>(w, load<float>(field), q);
+}
+
+template <Quantization Mode>
+void read_float(Bit_Reader &r, uint8 *field, const Field_Quantization &q)
+{
+  store(field, read_quantized_as<Mode>(r, q));
+}
+
+template <Quantization Mode>
+void write_vec3(Bit_Writer &w, const uint8 *field, const Field_Quantization &q)
+{
+  float v[3];
+  std::memcpy(v, field, sizeof(v));
+  if constexpr (Mode == Quantization::Unit_Normal)
+  {
+    write_unit_normal(w, v, q.bits);
+  }
+  else
+  {
+    for (float component : v)
+      write_quantized_as<Mode>(w, component, q);
+  }
+}
+
+template <Quantization Mode>
+void read_vec3(Bit_Reader &r, uint8 *field, const Field_Quantization &q)
+{
+  float v[3];
+  if constexpr (Mode == Quantization::Unit_Normal)
+  {
+    read_unit_normal(r, v, q.bits);
+  }
+  else
+  {
+    for (float &component : v)
+      component = read_quantized_as<Mode>(r, q);
+  }
+  std::memcpy(field, v, sizeof(v));
+}
+
+// --- Bool / strings / components ---
+
+inline void write_bool(Bit_Writer &w, const uint8 *field,
+                       const Field_Quantization &)
+{
+  w.write_bit(load<bool>(field));
+}
+
+inline void read_bool(Bit_Reader &r, uint8 *field, const Field_Quantization &)
+{
+  store(field, r.read_bit());
+}
+
+inline void write_pascal(Bit_Writer &w, const pascal_string &ps)
+{
+  w.write_bits(ps.length, 8);
+  w.write_bytes_unaligned(ps.data, ps.length);
+}
+
+inline void read_pascal(Bit_Reader &r, pascal_string &ps)
+{
+  ps.length = static_cast<uint8>(r.read_bits(8));
+  r.read_bytes_unaligned(ps.data, ps.length);
+  if (ps.length < ps.max_length())
+    ps.data[ps.length] = '\0';
+}
+
+inline void write_pascal_string(Bit_Writer &w, const uint8 *field,
+                                const Field_Quantization &)
+{
+  write_pascal(w, *reinterpret_cast<const pascal_string *>(field));
+}
+
+inline void read_pascal_string(Bit_Reader &r, uint8 *field,
+                               const Field_Quantization &)
+{
+  read_pascal(r, *reinterpret_cast<pascal_string *>(field));
+}
+
+inline void write_render_component(Bit_Writer &w, const uint8 *field,
+                                   const Field_Quantization &)
+{
+  const auto *rc = reinterpret_cast<const render_component_t *>(field);
+  write_var_int(w, rc->mesh_id);
+  write_pascal(w, rc->mesh_path);
+  w.write_bit(rc->visible);
+  w.write_bit(rc->is_wireframe);
+  for (const vec3f *v : {&rc->offset, &rc->scale, &rc->rotation})
+  {
+    write_coord(w, v->x);
+    write_coord(w, v->y);
+    write_coord(w, v->z);
+  }
+}
+
+inline void read_render_component(Bit_Reader &r, uint8 *field,
+                                  const Field_Quantization &)
+{
+  auto *rc = reinterpret_cast<render_component_t *>(field);
+  rc->mesh_id = read_var_int(r);
+  read_pascal(r, rc->mesh_path);
+  rc->visible = r.read_bit();
+  rc->is_wireframe = r.read_bit();
+  for (vec3f *v : {&rc->offset, &rc->scale, &rc->rotation})
+  {
+    v->x = read_coord(r);
+    v->y = read_coord(r);
+    v->z = read_coord(r);
+  }
+}
+
+} // namespace codec_detail
+
+} // namespace network
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "../transform_stream.hpp"
+#include "snapshot_history.hpp"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Interest management: which entities of a snapshot each client is sent.
+//
+// Every tick the server packs the positions of the snapshot's replicated
+// entities, taken from the entity system's transform stream, into one array.
+// A client's interest is a sphere cull of that array around its player (as
+// large as the largest relevancy radius), refined per entity by its
+// class's radius (see Class_Relevancy in schema.hpp) with a bias towards
+// where the player is looking. Classes can also be relevant to everyone
+// (Always) or to nobody (Never). The result feeds the Snapshot_Builder; what
+// each client ended up holding at each tick is kept in an Interest_Ring per
+// client, because that is what the client's baselines contain.
+
+namespace network
+{
+
+// One client's point of view.
+struct interest_viewer_t
+{
+  vec3f origin = {0, 0, 0};
+  vec3f forward = {0, 0, 0}; // unit length, or zero for no view bias
+  // The client's own entity, which is always relevant to it.
+  Entity_Id entity = null_entity_id;
+};
+
+struct interest_settings_t
+{
+  // Radius for classes that do not set one.
+  float default_radius = 3000.0f;
+  // Radius multiplier for entities behind the viewer (1 = no view bias).
+  float behind_scale = 0.5f;
+  // Priority rate of the viewer's own entity, which should never wait.
+  float own_entity_priority = 1000.0f;
+};
+
+// Direction a player with these view angles (degrees) is looking at; yaw 0
+// looks down +X and yaw 90 down +Z, like camera_t.
+inline vec3f view_forward(float yaw_degrees, float pitch_degrees)
+{
+  float yaw = linalg::to_radians(yaw_degrees);
+  float pitch = linalg::to_radians(pitch_degrees);
+  return {std::cos(pitch) * std::cos(yaw), std::sin(pitch),
+          std::cos(pitch) * std::sin(yaw)};
+}
+
+class Relevancy_Index
+{
+public:
+  // Indexes the entities of `snapshot`, which must outlive the queries.
+  // Positions come from the transform stream of `system`, the world the
+  // snapshot was captured from, which must have been synced since the last
+  // time entities moved (see Entity_System::sync_transforms).
+  void build(const snapshot_t &snapshot, const shared::Entity_System &system,
+             const interest_settings_t &settings)
+  {
+    current = &snapshot;
+    config = settings;
+    always.clear();
+    indexed.clear();
+    indexed_centers.clear();
+    max_radius = 0.0f;
+    centers.resize(snapshot.entities.size());
+    radii.resize(snapshot.entities.size());
+
+    const shared::Transform_Stream &transforms = system.transforms;
+    for (size_t i = 0; i < snapshot.entities.size(); ++i)
+    {
+      const snapshot_entity_t &entity = snapshot.entities[i];
+      const Class_Relevancy &relevancy = entity.schema->relevancy;
+      radii[i] = 0.0f;
+      if (relevancy.mode == Relevancy::Always)
+      {
+        always.push_back(static_cast<uint32>(i));
+        continue;
+      }
+      if (relevancy.mode == Relevancy::Never)
+        continue;
+
+      size_t transform = system.transform_index(entity.id);
+      if (transform >= transforms.size())
+        continue; // not live at the last sync
+      centers[i] = transforms.positions[transform];
+      float radius =
+          relevancy.radius > 0.0f ? relevancy.radius : config.default_radius;
+      radii[i] = radius;
+      max_radius = std::max(max_radius, radius);
+      indexed.push_back(static_cast<uint32>(i));
+      indexed_centers.push_back(centers[i]);
+    }
+    bounds = shared::enclosing_bounds(indexed_centers);
+  }
+
+  // Fills `visible` with the ascending positions (into the indexed
+  // snapshot's entities) of everything relevant to `viewer`. If
+  // `priority_rates` is given it receives, per visible entity, how fast its
+  // pending updates gain priority: the class weight, scaled down with
+  // distance to 10% at the edge of its radius.
+  void query(const interest_viewer_t &viewer, std::vector<uint32> &visible,
+             std::vector<float> *priority_rates = nullptr) const
+  {
+    visible.clear();
+    if (!current)
+      return;
+
+    // Nothing indexed within reach of the viewer: skip the pass. Otherwise
+    // the candidates (indices into indexed_centers) are culled into
+    // `visible` and narrowed down to snapshot positions in place, so a
+    // query allocates nothing once the caller's vector has grown.
+    vec3f extent = {max_radius, max_radius, max_radius};
+    vec3f reach_min = viewer.origin - extent;
+    vec3f reach_max = viewer.origin + extent;
+    if (reach_min.x <= bounds.max.x && reach_max.x >= bounds.min.x &&
+        reach_min.y <= bounds.max.y && reach_max.y >= bounds.min.y &&
+        reach_min.z <= bounds.max.z && reach_max.z >= bounds.min.z)
+      shared::cull_sphere(indexed_centers, viewer.origin, max_radius, visible);
+    size_t kept = 0;
+    for (size_t i = 0; i < visible.size(); ++i)
+    {
+      uint32 hit = visible[i];
+      uint32 position = indexed[hit];
+      vec3f to_entity = indexed_centers[hit] - viewer.origin;
+      float radius = radii[position];
+      if (dot(to_entity, viewer.forward) < 0.0f)
+        radius *= config.behind_scale;
+      if (dot(to_entity, to_entity) <= radius * radius)
+        visible[kept++] = position;
+    }
+    visible.resize(kept);
+
+    visible.insert(visible.end(), always.begin(), always.end());
+    if (const snapshot_entity_t *own = current->find(viewer.entity))
+      visible.push_back(static_cast<uint32>(own - current->entities.data()));
+
+    std::sort(visible.begin(), visible.end());
+    visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+
+    if (!priority_rates)
+      return;
+    priority_rates->clear();
+    for (uint32 position : visible)
+    {
+      const snapshot_entity_t &entity = current->entities[position];
+      float rate = entity.schema->relevancy.priority;
+      if (entity.id == viewer.entity)
+        rate = config.own_entity_priority;
+      else if (radii[position] > 0.0f)
+      {
+        float distance = length(centers[position] - viewer.origin);
+        rate *= 1.0f - 0.9f * std::min(distance / radii[position], 1.0f);
+      }
+      priority_rates->push_back(rate);
+    }
+  }
+
+  // Entities culled by distance (the rest are Always or Never).
+  size_t indexed_count() const { return indexed.size(); }
+
+private:
+  const snapshot_t *current = nullptr;
+  interest_settings_t config;
+  std::vector<uint32> always;
+  float max_radius = 0.0f;
+  // Snapshot positions of the entities culled by distance, and their
+  // positions in the world, packed for cull_sphere().
+  std::vector<uint32> indexed;
+  std::vector<vec3f> indexed_centers;
+  shared::aabb_bounds_t bounds;
+  // Per snapshot position; radius 0 = not indexed.
+  std::vector<vec3f> centers;
+  std::vector<float> radii;
+};
+
+// What one client held after each of the last snapshot_history_length ticks,
+// next to the server's Snapshot_Ring: a delta for that client must be encoded
+// against what it holds at the tick it acked, not the whole acked snapshot.
+struct sent_view_t
+{
+  uint32 tick = 0;
+  // Ascending positions into the snapshot of `tick`.
+  std::vector<uint32> visible;
+  // Per visible entity: the tick its copy is from (older than `tick` if its
+  // updates were deferred by the bandwidth budget).
+  std::vector<uint32> held_ticks;
+
+  void clear()
+  {
+    visible.clear();
+    held_ticks.clear();
+  }
+
+  // This view of `snapshot`, the server's snapshot of the same tick.
+  snapshot_view_t of(const snapshot_t *snapshot) const
+  {
+    return {snapshot, &visible, &held_ticks};
+  }
+};
+
+class Interest_Ring
+{
+public:
+  // Returns the (cleared) view for `tick`, overwriting whatever was there.
+  sent_view_t &begin(uint32 tick)
+  {
+    sent_view_t &slot = slots[tick % snapshot_history_length];
+    slot.clear();
+    slot.tick = tick;
+    return slot;
+  }
+
+  // nullptr if `tick` is 0 or has aged out of the ring.
+  const sent_view_t *find(uint32 tick) const
+  {
+    if (tick == 0)
+      return nullptr;
+    const sent_view_t &slot = slots[tick % snapshot_history_length];
+    return slot.tick == tick ? &slot : nullptr;
+  }
+
+  void clear()
+  {
+    for (auto &slot : slots)
+    {
+      slot.clear();
+      slot.tick = 0;
+    }
+  }
+
+private:
+  std::array<sent_view_t, snapshot_history_length> slots;
+};
+
+} // namespace network
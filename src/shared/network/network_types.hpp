@@ -2,6 +2,7 @@
 
 #include "linalg.hpp"
 #include <cstdint>
+#include <string_view>
 
 namespace network
 {
@@ -44,6 +45,17 @@ template <uint8 N = 250> struct pascal_string_t
     }
   }
 
+  // Truncated to N characters. Clears the rest, so c_str() stays
+  // terminated after a shorter string replaces a longer one.
+  void set(std::string_view str)
+  {
+    length = static_cast<uint8>(str.size() < N ? str.size() : N);
+    for (uint8 i = 0; i < length; ++i)
+      data[i] = str[i];
+    for (size_t i = length; i < N; ++i)
+      data[i] = '\0';
+  }
+
   const char *c_str() const
   {
     // data is always null-terminated within capacity since we zero-init
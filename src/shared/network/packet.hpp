@@ -15,6 +15,7 @@ enum class Message_Type : uint8
   C2S_PlayerMoveCommand,
   S2C_EntityPackage,
   NetCommand,
+  C2S_UserCmds, // not protobuf: see usercmd.hpp
 };
 
 // --------------------------------------------------------------------------------
@@ -65,13 +66,16 @@ template <> struct Packet_Traits<game::C2S_PlayerMoveCommand>
 
 struct Packet_Header
 {
-  uint64 timestamp;     //  when was this sent?
-  uint8 sequence_id;    // is this part of a sequence of packets?
-  uint8 sequence_count; // how many packets in this sequence?
-  uint8 sequence_idx;   // w  hich packet is this in the sequence?
-  uint8 message_type;   // what type of message is this? (enum )
-  uint16 payload_size;  // how big is the payload?
+  uint64 timestamp;        //  when was this sent?
+  uint8 sequence_id;       // is this part of a sequence of packets?
+  uint8 sequence_count;    // how many packets in this sequence?
+  uint8 sequence_idx;      // w  hich packet is this in the sequence?
+  uint8 message_type;      // what type of message is this? (enum )
+  uint16 payload_size;     // how big is the payload?
+  uint16 connection_token; // issued by the server on accept (0 = none)
 };
+// connection_token lives in what used to be tail padding.
+static_assert(sizeof(Packet_Header) == 16);
 
 // Alignment and sizing
 // 1452 is a common MTU size (Ethernet 1500 - IP 20 - UDP 8 - potential PPPoE 8)
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "bitstream.hpp"
+#include "schema.hpp"
+#include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstdlib>
 
@@ -21,6 +24,15 @@ inline void write_var_uint(Bit_Writer &w, uint32_t value)
   } while (value != 0);
 }
 
+// Bits write_var_uint() takes for `value`.
+inline size_t var_uint_bits(uint32_t value)
+{
+  size_t bits = 5;
+  while (value >>= 4)
+    bits += 5;
+  return bits;
+}
+
 inline uint32_t read_var_uint(Bit_Reader &r)
 {
   uint32_t value = 0;
@@ -45,43 +57,35 @@ inline uint32_t read_var_uint(Bit_Reader &r)
 inline void write_string(Bit_Writer &w, const std::string &value)
 {
   write_var_uint(w, static_cast<uint32_t>(value.size()));
-  for (auto c : value)
-  {
-    w.write_byte(static_cast<uint8_t>(c));
-  }
+  w.write_bytes_unaligned(value.data(), value.size());
 }
 
 inline void read_string(Bit_Reader &r, std::string &value)
 {
   uint32_t size = read_var_uint(r);
   value.resize(size);
-  for (size_t i = 0; i < size; ++i)
-  {
-    value[i] = static_cast<char>(r.read_byte());
-  }
+  r.read_bytes_unaligned(value.data(), size);
 }
 
 inline void read_c_string(Bit_Reader &r, char *value, size_t max_size)
 {
   uint32_t size = read_var_uint(r);
-  if (size >= max_size)
-  {
-    size = max_size - 1;
-  }
-  for (size_t i = 0; i < size; ++i)
+  size_t kept = size;
+  if (kept >= max_size)
   {
-    value[i] = static_cast<char>(r.read_byte());
+    kept = max_size - 1;
   }
-  value[size] = '\0';
+  r.read_bytes_unaligned(value, kept);
+  value[kept] = '\0';
+  // Skip whatever did not fit so the stream stays in sync.
+  r.bit_index += (size - kept) * 8;
 }
 
 inline void write_c_string(Bit_Writer &w, const char *value)
 {
-  write_var_uint(w, static_cast<uint32_t>(strlen(value)));
-  for (size_t i = 0; i < strlen(value); ++i)
-  {
-    w.write_byte(static_cast<uint8_t>(value[i]));
-  }
+  size_t length = strlen(value);
+  write_var_uint(w, static_cast<uint32_t>(length));
+  w.write_bytes_unaligned(value, length);
 }
 
 inline void write_var_int(Bit_Writer &w, int32_t value)
@@ -101,6 +105,160 @@ inline int32_t read_var_int(Bit_Reader &r)
   return negative ? -int32_t(magnitude) : int32_t(magnitude);
 }
 
+// --- Integer codings (Int_Coding) ---
+
+// Interleaves signs so small magnitudes stay small: 0, -1, 1, -2, ...
+inline uint32_t zig_zag(int32_t value)
+{
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t un_zig_zag(uint32_t value)
+{
+  return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+// The codings with the coding fixed at compile time; the runtime-coding
+// versions below dispatch to these, Field_Codec uses them directly.
+template <Int_Coding Coding>
+inline void write_coded_uint_as(Bit_Writer &w, uint32_t value)
+{
+  if constexpr (Coding == Int_Coding::Group7)
+  {
+    while (value >= 0x80)
+    {
+      w.write_bits((value & 0x7F) | 0x80, 8); // continuation in the top bit
+      value >>= 7;
+    }
+    w.write_bits(value, 8);
+  }
+  else if constexpr (Coding == Int_Coding::Length_Prefixed)
+  {
+    int width = std::max<int>(std::bit_width(value), 1);
+    w.write_bits(static_cast<uint32_t>(width - 1), 5);
+    w.write_bits(value, width);
+  }
+  else
+  {
+    write_var_uint(w, value);
+  }
+}
+
+template <Int_Coding Coding> inline uint32_t read_coded_uint_as(Bit_Reader &r)
+{
+  if constexpr (Coding == Int_Coding::Group7)
+  {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+      uint32_t group = r.read_bits(8);
+      value |= (group & 0x7F) << shift;
+      if (!(group & 0x80))
+        break;
+    }
+    return value;
+  }
+  else if constexpr (Coding == Int_Coding::Length_Prefixed)
+  {
+    return r.read_bits(static_cast<int>(r.read_bits(5)) + 1);
+  }
+  else
+  {
+    return read_var_uint(r);
+  }
+}
+
+inline void write_coded_uint(Bit_Writer &w, uint32_t value, Int_Coding coding)
+{
+  switch (coding)
+  {
+  case Int_Coding::Group7:
+    write_coded_uint_as<Int_Coding::Group7>(w, value);
+    return;
+  case Int_Coding::Length_Prefixed:
+    write_coded_uint_as<Int_Coding::Length_Prefixed>(w, value);
+    return;
+  default:
+    write_coded_uint_as<Int_Coding::Nibble>(w, value);
+    return;
+  }
+}
+
+inline uint32_t read_coded_uint(Bit_Reader &r, Int_Coding coding)
+{
+  switch (coding)
+  {
+  case Int_Coding::Group7:
+    return read_coded_uint_as<Int_Coding::Group7>(r);
+  case Int_Coding::Length_Prefixed:
+    return read_coded_uint_as<Int_Coding::Length_Prefixed>(r);
+  default:
+    return read_coded_uint_as<Int_Coding::Nibble>(r);
+  }
+}
+
+// Bits write_coded_uint() takes for `value`.
+inline size_t coded_uint_bits(uint32_t value, Int_Coding coding)
+{
+  switch (coding)
+  {
+  case Int_Coding::Group7:
+    return 8 * (1 + (std::max<int>(std::bit_width(value), 1) - 1) / 7);
+  case Int_Coding::Length_Prefixed:
+    return 5 + std::max<int>(std::bit_width(value), 1);
+  default:
+    return var_uint_bits(value);
+  }
+}
+
+// Nibble keeps its sign bit so existing streams decode unchanged; the newer
+// codings zig-zag instead.
+template <Int_Coding Coding>
+inline void write_coded_int_as(Bit_Writer &w, int32_t value)
+{
+  if constexpr (Coding == Int_Coding::Nibble)
+    write_var_int(w, value);
+  else
+    write_coded_uint_as<Coding>(w, zig_zag(value));
+}
+
+template <Int_Coding Coding> inline int32_t read_coded_int_as(Bit_Reader &r)
+{
+  if constexpr (Coding == Int_Coding::Nibble)
+    return read_var_int(r);
+  else
+    return un_zig_zag(read_coded_uint_as<Coding>(r));
+}
+
+inline void write_coded_int(Bit_Writer &w, int32_t value, Int_Coding coding)
+{
+  if (coding == Int_Coding::Nibble)
+    write_var_int(w, value);
+  else
+    write_coded_uint(w, zig_zag(value), coding);
+}
+
+inline int32_t read_coded_int(Bit_Reader &r, Int_Coding coding)
+{
+  if (coding == Int_Coding::Nibble)
+    return read_var_int(r);
+  return un_zig_zag(read_coded_uint(r, coding));
+}
+
+inline const char *int_coding_name(Int_Coding coding)
+{
+  switch (coding)
+  {
+  case Int_Coding::Group7:
+    return "group7";
+  case Int_Coding::Length_Prefixed:
+    return "length_prefixed";
+  default:
+    return "nibble";
+  }
+}
+
 inline void write_coord(Bit_Writer &w, float value)
 {
   if (value == 0.0f)
@@ -198,4 +356,218 @@ inline float read_coord(Bit_Reader &r)
   return value;
 }
 
+// --- Fixed-width encodings (Field_Quantization) ---
+
+// Degrees to a fraction of a turn in `bits` bits, and back to (-180, 180].
+inline uint32_t encode_angle(float degrees, int bits)
+{
+  float turns = degrees / 360.0f;
+  turns -= std::floor(turns);
+  return static_cast<uint32_t>(std::llround(std::ldexp(turns, bits))) &
+         static_cast<uint32_t>(bitstream_detail::low_bits_mask(bits));
+}
+
+inline float decode_angle(uint32_t value, int bits)
+{
+  float degrees = std::ldexp(float(value), -bits) * 360.0f;
+  return degrees > 180.0f ? degrees - 360.0f : degrees;
+}
+
+inline uint32_t max_fixed_step(const Field_Quantization &q)
+{
+  return static_cast<uint32_t>(bitstream_detail::low_bits_mask(q.bits));
+}
+
+inline bool in_fixed_range(float value, const Field_Quantization &q)
+{
+  return value >= q.min && value <= q.min + q.precision * max_fixed_step(q);
+}
+
+// Step index of `value` for Range / Position, clamped to the range.
+inline uint32_t encode_fixed(float value, const Field_Quantization &q)
+{
+  float step = std::round((value - q.min) / q.precision);
+  return static_cast<uint32_t>(
+      std::clamp(step, 0.0f, float(max_fixed_step(q))));
+}
+
+inline float decode_fixed(uint32_t step, const Field_Quantization &q)
+{
+  return q.min + float(step) * q.precision;
+}
+
+// write_quantized() / read_quantized() with the mode fixed at compile time.
+template <Quantization Mode>
+inline void write_quantized_as(Bit_Writer &w, float value,
+                               const Field_Quantization &q)
+{
+  if constexpr (Mode == Quantization::Range)
+  {
+    w.write_bits(encode_fixed(value, q), q.bits);
+  }
+  else if constexpr (Mode == Quantization::Angle)
+  {
+    w.write_bits(encode_angle(value, q.bits), q.bits);
+  }
+  else if constexpr (Mode == Quantization::Position)
+  {
+    bool inside = in_fixed_range(value, q);
+    w.write_bit(inside);
+    if (inside)
+      w.write_bits(encode_fixed(value, q), q.bits);
+    else
+      w.write_bits(std::bit_cast<uint32_t>(value), 32);
+  }
+  else
+  {
+    write_coord(w, value);
+  }
+}
+
+template <Quantization Mode>
+inline float read_quantized_as(Bit_Reader &r, const Field_Quantization &q)
+{
+  if constexpr (Mode == Quantization::Range)
+  {
+    return decode_fixed(r.read_bits(q.bits), q);
+  }
+  else if constexpr (Mode == Quantization::Angle)
+  {
+    return decode_angle(r.read_bits(q.bits), q.bits);
+  }
+  else if constexpr (Mode == Quantization::Position)
+  {
+    if (r.read_bit())
+      return decode_fixed(r.read_bits(q.bits), q);
+    return std::bit_cast<float>(r.read_bits(32));
+  }
+  else
+  {
+    return read_coord(r);
+  }
+}
+
+inline void write_quantized(Bit_Writer &w, float value,
+                            const Field_Quantization &q)
+{
+  switch (q.mode)
+  {
+  case Quantization::Range:
+    write_quantized_as<Quantization::Range>(w, value, q);
+    return;
+  case Quantization::Angle:
+    write_quantized_as<Quantization::Angle>(w, value, q);
+    return;
+  case Quantization::Position:
+    write_quantized_as<Quantization::Position>(w, value, q);
+    return;
+  default:
+    write_quantized_as<Quantization::None>(w, value, q);
+    return;
+  }
+}
+
+inline float read_quantized(Bit_Reader &r, const Field_Quantization &q)
+{
+  switch (q.mode)
+  {
+  case Quantization::Range:
+    return read_quantized_as<Quantization::Range>(r, q);
+  case Quantization::Angle:
+    return read_quantized_as<Quantization::Angle>(r, q);
+  case Quantization::Position:
+    return read_quantized_as<Quantization::Position>(r, q);
+  default:
+    return read_quantized_as<Quantization::None>(r, q);
+  }
+}
+
+// Octahedral encoding: the direction is projected onto the octahedron
+// |x| + |y| + |z| = 1, whose lower half is folded over the upper one, so two
+// components in [-1, 1] describe it. A zero vector comes back as +Z.
+inline void write_unit_normal(Bit_Writer &w, const float v[3], int bits)
+{
+  float length = std::abs(v[0]) + std::abs(v[1]) + std::abs(v[2]);
+  float x = length > 0.0f ? v[0] / length : 0.0f;
+  float y = length > 0.0f ? v[1] / length : 0.0f;
+  if (length > 0.0f && v[2] < 0.0f)
+  {
+    float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+  float max_step = float(bitstream_detail::low_bits_mask(bits));
+  auto step = [&](float component)
+  {
+    float scaled = (component + 1.0f) * 0.5f * max_step;
+    return static_cast<uint32_t>(std::lround(scaled));
+  };
+  w.write_bits(step(x), bits);
+  w.write_bits(step(y), bits);
+}
+
+inline void read_unit_normal(Bit_Reader &r, float v[3], int bits)
+{
+  float max_step = float(bitstream_detail::low_bits_mask(bits));
+  float x = r.read_bits(bits) / max_step * 2.0f - 1.0f;
+  float y = r.read_bits(bits) / max_step * 2.0f - 1.0f;
+  float z = 1.0f - std::abs(x) - std::abs(y);
+  if (z < 0.0f)
+  {
+    float unfolded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float unfolded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = unfolded_x;
+    y = unfolded_y;
+  }
+  float length = std::sqrt(x * x + y * y + z * z);
+  v[0] = x / length;
+  v[1] = y / length;
+  v[2] = z / length;
+}
+
+inline void write_quantized_vec3(Bit_Writer &w, const float v[3],
+                                 const Field_Quantization &q)
+{
+  if (q.mode == Quantization::Unit_Normal)
+  {
+    write_unit_normal(w, v, q.bits);
+    return;
+  }
+  for (int i = 0; i < 3; ++i)
+    write_quantized(w, v[i], q);
+}
+
+inline void read_quantized_vec3(Bit_Reader &r, float v[3],
+                                const Field_Quantization &q)
+{
+  if (q.mode == Quantization::Unit_Normal)
+  {
+    read_unit_normal(r, v, q.bits);
+    return;
+  }
+  for (int i = 0; i < 3; ++i)
+    v[i] = read_quantized(r, q);
+}
+
+// Ints only know Range; anything else uses the field's Int_Coding.
+inline void write_quantized_int(Bit_Writer &w, int32_t value,
+                                const Field_Quantization &q)
+{
+  if (q.mode == Quantization::Range)
+    w.write_bits(encode_fixed(float(value), q), q.bits);
+  else
+    write_coded_int(w, value, q.int_coding);
+}
+
+inline int32_t read_quantized_int(Bit_Reader &r, const Field_Quantization &q)
+{
+  if (q.mode == Quantization::Range)
+  {
+    float value = decode_fixed(r.read_bits(q.bits), q);
+    return static_cast<int32_t>(std::lround(value));
+  }
+  return read_coded_int(r, q.int_coding);
+}
+
 } // namespace network
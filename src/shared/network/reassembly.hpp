@@ -0,0 +1,188 @@
+#pragma once
+
+#include "network_types.hpp"
+#include "packet.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace network
+{
+
+// Reassembles fragmented messages (see convert_to_packets) for one
+// connection in fixed storage, with O(1) work per fragment.
+//
+// A message in flight occupies one of `slot_count` slots, picked by its
+// (message_type, sequence_id). Every slot owns room for `max_fragments`
+// payloads; fragment i is copied straight to offset i * payload size, so the
+// finished message is already contiguous and is handed out as a span into
+// the slot. A 256-bit mask tracks which fragments arrived, so duplicates are
+// dropped and completion is a counter compare. A message that does not
+// complete within `timeout` of its first fragment is evicted, and a newer
+// message mapping to a busy slot replaces the one in it.
+//
+// Single-fragment messages, the common case, are not copied at all: their
+// span points into the packet itself.
+class Reassembly_Ring
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct stats_t
+  {
+    uint64 completed = 0;
+    uint64 duplicates = 0;
+    uint64 evicted = 0;   // timed out or replaced before completing
+    uint64 malformed = 0; // inconsistent or oversized fragments
+  };
+
+  // Not explicit, so arrays of rings can be value-initialized.
+  Reassembly_Ring() : Reassembly_Ring(4) {}
+
+  explicit Reassembly_Ring(size_t slot_count, size_t max_fragments = 16,
+                           clock::duration timeout = std::chrono::seconds(1))
+      : slots(slot_count), max_fragments(std::min<size_t>(max_fragments, 255)),
+        timeout(timeout)
+  {
+  }
+
+  // Adds one fragment and returns the complete message once its last
+  // fragment arrived (an empty span otherwise). The span points into
+  // `packet` or into the ring, and stays valid until the next insert().
+  std::span<const uint8> insert(const Packet &packet, clock::time_point now)
+  {
+    const Packet_Header &header = packet.header;
+    if (header.sequence_count == 0 ||
+        header.sequence_idx >= header.sequence_count ||
+        header.payload_size > MAX_PAYLOAD_SIZE_IN_BYTES)
+    {
+      ring_stats.malformed += 1;
+      return {};
+    }
+
+    if (header.sequence_count == 1)
+    {
+      ring_stats.completed += 1;
+      return {packet.buffer, header.payload_size};
+    }
+
+    if (header.sequence_count > max_fragments ||
+        (header.sequence_idx + 1 < header.sequence_count &&
+         header.payload_size != MAX_PAYLOAD_SIZE_IN_BYTES))
+    {
+      ring_stats.malformed += 1; // only the last fragment may be short
+      return {};
+    }
+
+    if (storage.empty())
+      storage.resize(slots.size() * max_fragments * MAX_PAYLOAD_SIZE_IN_BYTES);
+
+    uint16 key = static_cast<uint16>(header.message_type << 8 |
+                                     header.sequence_id);
+    size_t slot_index = key % slots.size();
+    slot_t &slot = slots[slot_index];
+    if (slot.in_use && (slot.key != key ||
+                        slot.sequence_count != header.sequence_count ||
+                        now - slot.started > timeout))
+    {
+      ring_stats.evicted += 1;
+      slot.in_use = false;
+    }
+    if (!slot.in_use)
+    {
+      slot = {};
+      slot.in_use = true;
+      slot.key = key;
+      slot.sequence_count = header.sequence_count;
+      slot.started = now;
+    }
+
+    uint64 &word = slot.received[header.sequence_idx / 64];
+    uint64 bit = uint64(1) << (header.sequence_idx % 64);
+    if (word & bit)
+    {
+      ring_stats.duplicates += 1;
+      return {};
+    }
+    word |= bit;
+
+    uint8 *payload = slot_storage(slot_index) +
+                     size_t(header.sequence_idx) * MAX_PAYLOAD_SIZE_IN_BYTES;
+    std::memcpy(payload, packet.buffer, header.payload_size);
+    slot.received_count += 1;
+    if (header.sequence_idx + 1 == header.sequence_count)
+      slot.last_size = header.payload_size;
+
+    if (slot.received_count < slot.sequence_count)
+      return {};
+
+    slot.in_use = false;
+    ring_stats.completed += 1;
+    size_t size = size_t(slot.sequence_count - 1) * MAX_PAYLOAD_SIZE_IN_BYTES +
+                  slot.last_size;
+    return {slot_storage(slot_index), size};
+  }
+
+  // Drops messages whose first fragment is older than the timeout. insert()
+  // also catches them lazily; this keeps pending() honest for idle slots.
+  void evict_stale(clock::time_point now)
+  {
+    for (slot_t &slot : slots)
+    {
+      if (slot.in_use && now - slot.started > timeout)
+      {
+        slot.in_use = false;
+        ring_stats.evicted += 1;
+      }
+    }
+  }
+
+  // Forgets every message in flight; keeps the storage.
+  void clear()
+  {
+    for (slot_t &slot : slots)
+      slot.in_use = false;
+  }
+
+  // Messages with some but not all fragments received.
+  size_t pending() const
+  {
+    size_t count = 0;
+    for (const slot_t &slot : slots)
+      count += slot.in_use ? 1 : 0;
+    return count;
+  }
+
+  const stats_t &stats() const { return ring_stats; }
+
+private:
+  struct slot_t
+  {
+    bool in_use = false;
+    uint16 key = 0; // message_type << 8 | sequence_id
+    uint8 sequence_count = 0;
+    uint8 received_count = 0;
+    uint16 last_size = 0; // payload size of the last fragment
+    std::array<uint64, 4> received{};
+    clock::time_point started{};
+  };
+
+  uint8 *slot_storage(size_t slot_index)
+  {
+    return storage.data() +
+           slot_index * max_fragments * MAX_PAYLOAD_SIZE_IN_BYTES;
+  }
+
+  std::vector<slot_t> slots;
+  size_t max_fragments;
+  clock::duration timeout;
+  // slots x max_fragments payloads, allocated with the first fragmented
+  // message.
+  std::vector<uint8> storage;
+  stats_t ring_stats;
+};
+
+} // namespace network
@@ -1,125 +1,210 @@
 #include "schema.hpp"
+#include "field_codec.hpp"
+#include <cctype>
+#include <charconv>
 #include <cstring>
 #include <sstream>
 
 namespace network
 {
 
-bool parse_string_to_field(const std::string &value, Field_Type type,
-                           void *out_ptr)
+Field_Codec make_field_codec(const Field_Prop &field)
 {
-  if (!out_ptr)
-    return false;
+  using namespace codec_detail;
+  const Field_Quantization &q = field.quantization;
+  Field_Codec codec = {nullptr, nullptr, field.offset, q};
+  auto use = [&codec](auto write, auto read)
+  {
+    codec.write = write;
+    codec.read = read;
+  };
 
-  switch (type)
+  switch (field.type)
   {
   case Field_Type::Int32:
-  {
-    try
+    if (q.mode == Quantization::Range)
+      use(write_int_range, read_int_range);
+    else if (q.int_coding == Int_Coding::Group7)
+      use(write_int_coded<Int_Coding::Group7>,
+          read_int_coded<Int_Coding::Group7>);
+    else if (q.int_coding == Int_Coding::Length_Prefixed)
+      use(write_int_coded<Int_Coding::Length_Prefixed>,
+          read_int_coded<Int_Coding::Length_Prefixed>);
+    else
+      use(write_int_coded<Int_Coding::Nibble>,
+          read_int_coded<Int_Coding::Nibble>);
+    break;
+  case Field_Type::Float32:
+    // Unit_Normal only means something for Vec3f; a float falls back to
+    // write_coord, as write_quantized() does.
+    switch (q.mode)
     {
-      *static_cast<int32 *>(out_ptr) = std::stoi(value);
-      return true;
+    case Quantization::Range:
+      use(write_float<Quantization::Range>, read_float<Quantization::Range>);
+      break;
+    case Quantization::Angle:
+      use(write_float<Quantization::Angle>, read_float<Quantization::Angle>);
+      break;
+    case Quantization::Position:
+      use(write_float<Quantization::Position>,
+          read_float<Quantization::Position>);
+      break;
+    default:
+      use(write_float<Quantization::None>, read_float<Quantization::None>);
+      break;
     }
-    catch (...)
+    break;
+  case Field_Type::Vec3f:
+    switch (q.mode)
     {
-      return false;
+    case Quantization::Range:
+      use(write_vec3<Quantization::Range>, read_vec3<Quantization::Range>);
+      break;
+    case Quantization::Angle:
+      use(write_vec3<Quantization::Angle>, read_vec3<Quantization::Angle>);
+      break;
+    case Quantization::Unit_Normal:
+      use(write_vec3<Quantization::Unit_Normal>,
+          read_vec3<Quantization::Unit_Normal>);
+      break;
+    case Quantization::Position:
+      use(write_vec3<Quantization::Position>,
+          read_vec3<Quantization::Position>);
+      break;
+    default:
+      use(write_vec3<Quantization::None>, read_vec3<Quantization::None>);
+      break;
     }
+    break;
+  case Field_Type::Bool:
+    use(write_bool, read_bool);
+    break;
+  case Field_Type::PascalString:
+    use(write_pascal_string, read_pascal_string);
+    break;
+  case Field_Type::RenderComponent:
+    use(write_render_component, read_render_component);
+    break;
   }
-  case Field_Type::Float32:
+  assert(codec.write && codec.read && "Unknown field type");
+  return codec;
+}
+
+namespace
+{
+
+// Parsers for parse_string_to_field(). Each reads from the front of `text`
+// and advances it past what it used. Like std::stoi/std::stof they skip
+// leading whitespace and a '+', and ignore whatever follows the number.
+std::string_view skip_space(std::string_view text)
+{
+  size_t i = 0;
+  while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i])))
+    ++i;
+  return text.substr(i);
+}
+
+template <typename T> bool parse_number(std::string_view &text, T &out)
+{
+  text = skip_space(text);
+  if (!text.empty() && text.front() == '+')
+    text.remove_prefix(1);
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(),
+                                      out);
+  if (error != std::errc())
+    return false;
+  text.remove_prefix(static_cast<size_t>(end - text.data()));
+  return true;
+}
+
+bool parse_vec3(std::string_view &text, vec3f &out)
+{
+  vec3f v;
+  if (!parse_number(text, v.x) || !parse_number(text, v.y) ||
+      !parse_number(text, v.z))
+    return false;
+  out = v;
+  return true;
+}
+
+bool equals_ignoring_case(std::string_view a, std::string_view b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
   {
-    try
-    {
-      *static_cast<float32 *>(out_ptr) = std::stof(value);
-      return true;
-    }
-    catch (...)
-    {
+    if (std::tolower(static_cast<unsigned char>(a[i])) != b[i])
       return false;
-    }
   }
+  return true;
+}
+
+// The text up to the next '|' (or the end), and `text` past the '|'.
+// Returns false if `text` was empty.
+bool next_part(std::string_view &text, std::string_view &part)
+{
+  if (text.empty())
+    return false;
+  size_t bar = text.find('|');
+  part = text.substr(0, bar);
+  text = bar == std::string_view::npos ? std::string_view{}
+                                       : text.substr(bar + 1);
+  return true;
+}
+
+} // namespace
+
+bool parse_string_to_field(std::string_view value, Field_Type type,
+                           void *out_ptr)
+{
+  if (!out_ptr)
+    return false;
+
+  switch (type)
+  {
+  case Field_Type::Int32:
+    return parse_number(value, *static_cast<int32 *>(out_ptr));
+  case Field_Type::Float32:
+    return parse_number(value, *static_cast<float32 *>(out_ptr));
   case Field_Type::Bool:
   {
-    // "1", "true", "True" -> true
-    // "0", "false", "False" -> false
-    std::string v = value;
-    // Lowercase
-    for (auto &c : v)
-      c = std::tolower(c);
-
-    bool result = false;
-    if (v == "1" || v == "true")
-      result = true;
-    else if (v == "0" || v == "false")
-      result = false;
-    // else default to false or fail? Source usually treats valid non-zero as
-    // true, but strict checking is fine.
-    *static_cast<bool *>(out_ptr) = result;
+    // "1", "true", "True" -> true; anything else -> false.
+    *static_cast<bool *>(out_ptr) =
+        value == "1" || equals_ignoring_case(value, "true");
     return true;
   }
   case Field_Type::Vec3f:
-  {
-    float x = 0, y = 0, z = 0;
-    std::stringstream ss(value);
-    ss >> x >> y >> z;
-    if (!ss.fail())
-    {
-      auto *vec = static_cast<vec3f *>(out_ptr);
-      vec->x = x;
-      vec->y = y;
-      vec->z = z;
-      return true;
-    }
-    return false;
-  }
+    return parse_vec3(value, *static_cast<vec3f *>(out_ptr));
   case Field_Type::PascalString:
   {
-    auto *ps = static_cast<pascal_string *>(out_ptr);
-    ps->set(value.c_str());
+    static_cast<pascal_string *>(out_ptr)->set(value);
     return true;
   }
   case Field_Type::RenderComponent:
   {
     // Format: mesh_id|mesh_path|visible|is_wireframe|ox oy oz|sx sy sz|rx ry rz
     auto *rc = static_cast<render_component_t *>(out_ptr);
-    std::stringstream ss(value);
-    std::string token;
-
-    // mesh_id
-    if (!std::getline(ss, token, '|'))
-      return false;
-    try { rc->mesh_id = std::stoi(token); }
-    catch (...) { return false; }
-
-    // mesh_path
-    if (!std::getline(ss, token, '|'))
-      return false;
-    rc->mesh_path.set(token.c_str());
-
-    // visible
-    if (!std::getline(ss, token, '|'))
-      return false;
-    rc->visible = (token == "1" || token == "true");
+    std::string_view part;
 
-    // is_wireframe
-    if (!std::getline(ss, token, '|'))
+    if (!next_part(value, part) || !parse_number(part, rc->mesh_id))
       return false;
-    rc->is_wireframe = (token == "1" || token == "true");
-
-    // offset (3 floats space-separated)
-    if (!std::getline(ss, token, '|'))
+    if (!next_part(value, part))
       return false;
-    { std::stringstream vs(token); vs >> rc->offset.x >> rc->offset.y >> rc->offset.z; }
-
-    // scale (3 floats space-separated)
-    if (!std::getline(ss, token, '|'))
+    rc->mesh_path.set(part);
+    if (!next_part(value, part))
       return false;
-    { std::stringstream vs(token); vs >> rc->scale.x >> rc->scale.y >> rc->scale.z; }
-
-    // rotation (3 floats space-separated)
-    if (!std::getline(ss, token, '|'))
+    rc->visible = (part == "1" || part == "true");
+    if (!next_part(value, part))
       return false;
-    { std::stringstream vs(token); vs >> rc->rotation.x >> rc->rotation.y >> rc->rotation.z; }
+    rc->is_wireframe = (part == "1" || part == "true");
 
+    // offset, scale and rotation (3 floats space-separated each)
+    for (vec3f *v : {&rc->offset, &rc->scale, &rc->rotation})
+    {
+      if (!next_part(value, part))
+        return false;
+      parse_vec3(part, *v);
+    }
     return true;
   }
   default:
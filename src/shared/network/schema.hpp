@@ -1,9 +1,17 @@
 #pragma once
 
+#include "diff_kernel.hpp"
 #include "network_types.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstddef>
+#include <initializer_list>
 #include <iostream>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -49,6 +57,146 @@ enum class Field_Type
   RenderComponent,
 };
 
+constexpr size_t field_type_count =
+    static_cast<size_t>(Field_Type::RenderComponent) + 1;
+
+// Signature of how a value of `type` is laid out in this build: its size and,
+// for the compound types, the offset of each member. Raw copies of a field
+// (the binary map format) are only meaningful between builds where it
+// matches; a reordered render_component_t changes it even if its size does
+// not.
+inline uint32_t field_type_layout(Field_Type type)
+{
+  // FNV-1a over the sizes and offsets.
+  auto hash = [](std::initializer_list<size_t> values)
+  {
+    uint32_t result = 2166136261u;
+    for (size_t value : values)
+    {
+      result ^= static_cast<uint32_t>(value);
+      result *= 16777619u;
+    }
+    return result;
+  };
+  switch (type)
+  {
+  case Field_Type::Int32:
+    return hash({sizeof(int32)});
+  case Field_Type::Float32:
+    return hash({sizeof(float32)});
+  case Field_Type::Bool:
+    return hash({sizeof(bool)});
+  case Field_Type::Vec3f:
+    return hash({sizeof(vec3f)});
+  case Field_Type::PascalString:
+    return hash({sizeof(pascal_string), offsetof(pascal_string, length),
+                 offsetof(pascal_string, data)});
+  case Field_Type::RenderComponent:
+    return hash({sizeof(render_component_t),
+                 offsetof(render_component_t, mesh_id),
+                 offsetof(render_component_t, mesh_path),
+                 offsetof(render_component_t, visible),
+                 offsetof(render_component_t, is_wireframe),
+                 offsetof(render_component_t, offset),
+                 offsetof(render_component_t, scale),
+                 offsetof(render_component_t, rotation),
+                 field_type_layout(Field_Type::PascalString)});
+  }
+  return 0;
+}
+
+// --- Quantization ---
+
+// How a field is sent over the network. By default ints are var_ints and
+// floats use write_coord (integer part + 5-bit fraction); fields that know
+// their range or meaning can declare a fixed bit width instead, via
+// SCHEMA_FIELD_QUANTIZED, and ints without a range can pick a different
+// variable-length coding via SCHEMA_FIELD_CODED. Widths are computed at
+// compile time.
+enum class Quantization : uint8_t
+{
+  None,
+  Range,       // fixed point over [min, min + precision * (2^bits - 1)]
+  Angle,       // degrees, wrapped to a full turn in 2^bits steps
+  Unit_Normal, // Vec3f direction, octahedral: two components of `bits` bits
+  Position,    // fixed point inside the world box, raw float outside it
+};
+
+// Variable-length codings for ints that are not Range quantized. The
+// Bandwidth_Profiler report shows which one pays off for a field.
+enum class Int_Coding : uint8_t
+{
+  Nibble,          // 4-bit groups + continuation bit, sign bit (default)
+  Group7,          // 7-bit groups + continuation bit, zig-zag
+  Length_Prefixed, // 5-bit bit length, then that many bits, zig-zag
+};
+
+struct Field_Quantization
+{
+  Quantization mode = Quantization::None;
+  float min = 0.0f;
+  float precision = 0.0f; // step size (Range, Position)
+  uint8_t bits = 0;       // per component
+  Int_Coding int_coding = Int_Coding::Nibble;
+};
+
+constexpr Field_Quantization code_int(Int_Coding coding)
+{
+  return {Quantization::None, 0.0f, 0.0f, 0, coding};
+}
+
+// Bits needed to tell `steps` values apart.
+constexpr uint8_t bits_for_steps(uint64_t steps)
+{
+  uint8_t bits = 0;
+  while ((uint64_t(1) << bits) < steps)
+    bits += 1;
+  return bits;
+}
+
+constexpr Field_Quantization quantize_range(float min, float max,
+                                            float precision)
+{
+  uint64_t steps = static_cast<uint64_t>((max - min) / precision + 0.5f) + 1;
+  return {Quantization::Range, min, precision, bits_for_steps(steps)};
+}
+
+constexpr Field_Quantization quantize_angle(uint8_t bits)
+{
+  return {Quantization::Angle, 0.0f, 360.0f / float(uint64_t(1) << bits),
+          bits};
+}
+
+constexpr Field_Quantization quantize_unit_normal(uint8_t bits)
+{
+  return {Quantization::Unit_Normal, -1.0f, 0.0f, bits};
+}
+
+// The box Position fields are fixed point in. The server runs without a map
+// (and the client may not have loaded one yet), so both ends use this fixed
+// box rather than the map's own bounds; entities outside it are sent as raw
+// floats.
+constexpr float world_half_extent = 16384.0f;
+
+constexpr Field_Quantization quantize_position(float precision)
+{
+  Field_Quantization quantization =
+      quantize_range(-world_half_extent, world_half_extent, precision);
+  quantization.mode = Quantization::Position;
+  return quantization;
+}
+
+// One bit per schema field, by field index.
+using Field_Mask = uint64_t;
+constexpr size_t max_schema_fields = 64;
+
+constexpr Field_Mask all_fields_mask(size_t field_count)
+{
+  return field_count >= max_schema_fields
+             ? ~Field_Mask(0)
+             : (Field_Mask(1) << field_count) - 1;
+}
+
 struct Field_Prop
 {
   std::string name;
@@ -57,18 +205,116 @@ struct Field_Prop
   size_t size;
   Field_Type type;
   Schema_Flags flags;
+  Field_Quantization quantization = {};
 };
 
-bool parse_string_to_field(const std::string &value, Field_Type type,
+class Bit_Writer;
+class Bit_Reader;
+
+// How serialize_fields() / deserialize_fields() write and read one field:
+// the encoder for its type and quantization, chosen once at registration
+// (make_field_codec, see field_codec.hpp) instead of per field per entity.
+struct Field_Codec
+{
+  void (*write)(Bit_Writer &w, const uint8_t *field,
+                const Field_Quantization &q);
+  void (*read)(Bit_Reader &r, uint8_t *field, const Field_Quantization &q);
+  size_t offset;
+  Field_Quantization quantization;
+};
+
+Field_Codec make_field_codec(const Field_Prop &field);
+
+// Parses a map/editor property value (the format serialize_field_to_string
+// writes) into the field at `out_ptr`. Reads `value` in place; numbers are
+// parsed with std::from_chars, so nothing is allocated.
+bool parse_string_to_field(std::string_view value, Field_Type type,
                            void *out_ptr);
 
 bool serialize_field_to_string(const void *in_ptr, Field_Type type,
                                std::string &out_value);
 
+// --- Relevancy ---
+
+// Which clients an entity of a class is replicated to.
+enum class Relevancy : uint8_t
+{
+  Radius, // clients whose player is within `radius` of the entity
+  Always, // every client, wherever they are
+  Never,  // nobody (e.g. static geometry the client loads from the map)
+};
+
+struct Class_Relevancy
+{
+  Relevancy mode = Relevancy::Radius;
+  float radius = 0.0f; // 0: use the server's sv_relevancy_radius
+  // How fast the class's pending updates gain priority when a client's
+  // bandwidth budget is tight.
+  float priority = 1.0f;
+  // Every write to a networked field goes through Entity::set(), so
+  // snapshots can take the changed fields from the entity instead of
+  // comparing it against the baseline. See SCHEMA_TRACK_CHANGES.
+  bool track_changes = false;
+};
+
 struct Class_Schema
 {
   std::string class_name;
+  // Dense, assigned at registration: the index into Schema_Registry. The
+  // shared entity classes are registered first, in SHARED_ENTITIES_LIST
+  // order (register_entity_schemas), so theirs equal their entity_type in
+  // every binary and are what snapshots put on the wire.
+  uint16_t class_id = 0;
   std::vector<Field_Prop> fields;
+  // Bytes from the start of the object up to the end of the last field. A
+  // copy of this prefix holds every field and is what snapshots store.
+  size_t state_size = 0;
+  Class_Relevancy relevancy;
+  // Field bytes per diff lane, for changed_field_mask().
+  Diff_Layout diff_layout;
+  // One per field, by field index.
+  std::vector<Field_Codec> codecs;
+  // Per Field_Type, the offset of the first field of that type, or -1. What
+  // Entity::get_component<T>() returns.
+  std::array<int32_t, field_type_count> component_offsets;
+  // Field indices sorted by field name, for find_fields().
+  std::vector<uint16_t> fields_by_name;
+  // Hash of the class name and each field's name, type, size and type layout
+  // (field_type_layout), in order: equal hashes mean a packed copy of the
+  // fields (binary maps) can be read back field for field.
+  uint64_t layout_hash = 0;
+
+  // The indices of the fields called `name` (more than one if a class
+  // registers an inherited field again), by binary search.
+  std::span<const uint16_t> find_fields(std::string_view name) const
+  {
+    auto [first, last] = std::equal_range(
+        fields_by_name.begin(), fields_by_name.end(), name,
+        [this](const auto &a, const auto &b)
+        { return field_name(a) < field_name(b); });
+    return {first, last};
+  }
+
+  // The fields that start at byte `offset` (more than one if a class
+  // registers an inherited field again).
+  Field_Mask fields_at_offset(size_t offset) const
+  {
+    Field_Mask mask = 0;
+    for (const auto &field : fields)
+    {
+      if (field.offset == offset)
+        mask |= Field_Mask(1) << field.index;
+    }
+    return mask;
+  }
+
+private:
+  // For find_fields(), which compares indices and names both ways.
+  std::string_view field_name(uint16_t index) const
+  {
+    return fields[index].name;
+  }
+  static std::string_view field_name(std::string_view name) { return name; }
 };
 
 class Schema_Registry
@@ -80,27 +326,105 @@ public:
     return instance;
   }
 
-  void register_class(const std::string &name,
-                      const std::vector<Field_Prop> &fields)
+  // Registering a name again replaces its schema in place; the class keeps
+  // its id and existing Class_Schema pointers stay valid.
+  const Class_Schema *register_class(const std::string &name,
+                                     const std::vector<Field_Prop> &fields,
+                                     Class_Relevancy relevancy = {})
   {
-    schemas[name] = {name, fields};
+    assert(fields.size() <= max_schema_fields && "Field_Mask is too small");
+    size_t state_size = 0;
+    for (const auto &field : fields)
+    {
+      state_size = std::max(state_size, field.offset + field.size);
+    }
+
+    auto [it, inserted] =
+        ids_by_name.try_emplace(name, static_cast<uint16_t>(classes.size()));
+    if (inserted)
+    {
+      assert(classes.size() < UINT16_MAX && "Too many schema classes");
+      classes.push_back(std::make_unique<Class_Schema>());
+    }
+    Class_Schema &schema = *classes[it->second];
+    schema = Class_Schema{};
+    schema.class_name = name;
+    schema.class_id = it->second;
+    schema.fields = fields;
+    schema.state_size = state_size;
+    schema.relevancy = relevancy;
+    schema.diff_layout.build(schema.fields, state_size);
+    schema.component_offsets.fill(-1);
+    for (const auto &field : schema.fields)
+    {
+      schema.codecs.push_back(make_field_codec(field));
+      int32_t &offset =
+          schema.component_offsets[static_cast<size_t>(field.type)];
+      if (offset < 0)
+        offset = static_cast<int32_t>(field.offset);
+    }
+    schema.fields_by_name.resize(schema.fields.size());
+    for (size_t i = 0; i < schema.fields.size(); ++i)
+      schema.fields_by_name[i] = static_cast<uint16_t>(i);
+    std::stable_sort(schema.fields_by_name.begin(),
+                     schema.fields_by_name.end(),
+                     [&schema](uint16_t a, uint16_t b)
+                     { return schema.fields[a].name < schema.fields[b].name; });
+    schema.layout_hash = compute_layout_hash(schema);
+    return &schema;
+  }
+
+  const Class_Schema *get_schema(const std::string &name) const
+  {
+    auto it = ids_by_name.find(name);
+    return it != ids_by_name.end() ? classes[it->second].get() : nullptr;
   }
 
-  const Class_Schema *get_schema(const std::string &name)
+  const Class_Schema *get_schema(uint16_t class_id) const
   {
-    if (schemas.find(name) != schemas.end())
+    return class_id < classes.size() ? classes[class_id].get() : nullptr;
+  }
+
+  size_t class_count() const { return classes.size(); }
+
+private:
+  // FNV-1a.
+  static uint64_t compute_layout_hash(const Class_Schema &schema)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void *data, size_t size)
     {
-      return &schemas[name];
+      for (size_t i = 0; i < size; ++i)
+      {
+        hash ^= static_cast<const uint8_t *>(data)[i];
+        hash *= 1099511628211ull;
+      }
+    };
+    mix(schema.class_name.data(), schema.class_name.size() + 1);
+    for (const auto &field : schema.fields)
+    {
+      uint32_t type_and_size[3] = {static_cast<uint32_t>(field.type),
+                                   static_cast<uint32_t>(field.size),
+                                   field_type_layout(field.type)};
+      mix(field.name.data(), field.name.size() + 1);
+      mix(type_and_size, sizeof(type_and_size));
     }
-    return nullptr;
+    return hash;
   }
 
-private:
-  std::unordered_map<std::string, Class_Schema> schemas;
+  std::vector<std::unique_ptr<Class_Schema>> classes; // by class_id
+  std::unordered_map<std::string, uint16_t> ids_by_name;
 };
 
+// Registers Entity and then every class in SHARED_ENTITIES_LIST, in list
+// order, before anything else gets an id. Every register_schema() calls it
+// first, so whichever class static initialization reaches first, the table
+// starts out the same. Defined in entity.cpp.
+void register_entity_schemas();
+
 // Generates a list of updates to transform 'baseline' into 'current'
-// based on the provided schema.
+// based on the provided schema. A null baseline (full update) yields every
+// field.
 inline std::vector<Field_Update> diff(const void *baseline, const void *current,
                                       const Class_Schema *schema)
 {
@@ -110,8 +434,8 @@ inline std::vector<Field_Update> diff(const void *baseline, const void *current,
 
   for (const auto &field : schema->fields)
   {
-    if (std::memcmp(base_ptr + field.offset, curr_ptr + field.offset,
-                    field.size) != 0)
+    if (!base_ptr || std::memcmp(base_ptr + field.offset,
+                                 curr_ptr + field.offset, field.size) != 0)
     {
       Field_Update update;
       update.field_id = (uint16_t)field.index;
@@ -167,22 +491,22 @@ inline void apply_diff(void *target, const std::vector<Field_Update> &updates,
   uint8_t *target_ptr = static_cast<uint8_t *>(target);
   for (const auto &update : updates)
   {
-    for (const auto &field : schema->fields)
+    // Field ids are indices into schema->fields.
+    if (update.field_id >= schema->fields.size())
     {
-      if (field.index == update.field_id)
-      {
-        if (update.data.size() == field.size)
-        {
-          std::memcpy(target_ptr + field.offset, update.data.data(),
-                      field.size);
-        }
-        else
-        {
-          std::cerr << "Error: Field size mismatch applying diff for field "
-                    << field.name << "\n";
-        }
-        break;
-      }
+      std::cerr << "Error: Unknown field id " << update.field_id
+                << " applying diff for " << schema->class_name << "\n";
+      continue;
+    }
+    const Field_Prop &field = schema->fields[update.field_id];
+    if (update.data.size() == field.size)
+    {
+      std::memcpy(target_ptr + field.offset, update.data.data(), field.size);
+    }
+    else
+    {
+      std::cerr << "Error: Field size mismatch applying diff for field "
+                << field.name << "\n";
     }
   }
 }
@@ -231,6 +555,7 @@ struct Field_Meta
   size_t size;
   Field_Type type;
   Schema_Flags flags;
+  Field_Quantization quantization = {};
 };
 
 // --- Macros for Schema declaration ---
@@ -256,12 +581,39 @@ public:                                                                        \
   static constexpr ::network::Field_Meta _schema_meta_##Name = {               \
       #Name, sizeof(Type), ::network::Schema_Type_Info<Type>::type, Flags};
 
+// A field with a fixed-width network encoding (see Field_Quantization).
+// Usage: SCHEMA_FIELD_QUANTIZED(float32, yaw, Schema_Flags::Networked,
+//                               ::network::quantize_angle(16));
+#define SCHEMA_FIELD_QUANTIZED(Type, Name, Flags, Quantization)                \
+  Type Name{};                                                                 \
+  static constexpr ::network::Field_Meta _schema_meta_##Name = {               \
+      #Name, sizeof(Type), ::network::Schema_Type_Info<Type>::type, Flags,     \
+      Quantization};                                                           \
+  static_assert(_schema_meta_##Name.quantization.bits >= 1 &&                  \
+                    _schema_meta_##Name.quantization.bits <= 32,               \
+                "Quantized field " #Name " needs 1 to 32 bits");
+
+// An int field with a non-default variable-length coding (see Int_Coding).
+// Usage: SCHEMA_FIELD_CODED(int32, score, Schema_Flags::Networked,
+//                           ::network::Int_Coding::Group7);
+#define SCHEMA_FIELD_CODED(Type, Name, Flags, Coding)                          \
+  Type Name{};                                                                 \
+  static constexpr ::network::Field_Meta _schema_meta_##Name = {               \
+      #Name, sizeof(Type), ::network::Schema_Type_Info<Type>::type, Flags,     \
+      ::network::code_int(Coding)};                                            \
+  static_assert(_schema_meta_##Name.type == ::network::Field_Type::Int32,      \
+                "Coded field " #Name " must be an int32");
+
 // Begin schema registration in .cpp file
 #define BEGIN_SCHEMA(ClassName)                                                \
   void ClassName::register_schema()                                            \
   {                                                                            \
+    network::register_entity_schemas();                                        \
+    if (network::Schema_Registry::get().get_schema(#ClassName))                \
+      return;                                                                  \
     using ThisClass = ClassName;                                               \
-    std::vector<network::Field_Prop> props;
+    std::vector<network::Field_Prop> props;                                    \
+    network::Class_Relevancy _schema_relevancy;
 
 // Register a field that was declared with SCHEMA_FIELD
 // Uses the stored metadata and computes offset
@@ -273,15 +625,22 @@ public:                                                                        \
                    (uint32_t)props.size(), offsetof(ThisClass, MemberName),    \
                    ThisClass::_schema_meta_##MemberName.size,                  \
                    ThisClass::_schema_meta_##MemberName.type,                  \
-                   ThisClass::_schema_meta_##MemberName.flags});
+                   ThisClass::_schema_meta_##MemberName.flags,                 \
+                   ThisClass::_schema_meta_##MemberName.quantization});
 
-// End schema registration
+// End schema registration. get_schema() registers on first use (static
+// initialization order across files is unspecified) and then returns the
+// cached pointer.
 #define END_SCHEMA(ClassName)                                                  \
-  network::Schema_Registry::get().register_class(#ClassName, props);           \
+  network::Schema_Registry::get().register_class(#ClassName, props,           \
+                                                 _schema_relevancy);           \
   }                                                                            \
   const network::Class_Schema *ClassName::get_schema() const                   \
   {                                                                            \
-    return network::Schema_Registry::get().get_schema(#ClassName);             \
+    static const network::Class_Schema *schema =                               \
+        (ClassName::register_schema(),                                         \
+         network::Schema_Registry::get().get_schema(#ClassName));              \
+    return schema;                                                             \
   }                                                                            \
   namespace                                                                    \
   {                                                                            \
@@ -306,8 +665,9 @@ public:                                                                        \
       for (const auto &pf : parent_schema->fields)                             \
       {                                                                        \
         props.push_back({pf.name, (uint32_t)props.size(), pf.offset, pf.size,  \
-                         pf.type, pf.flags});                                  \
+                         pf.type, pf.flags, pf.quantization});                 \
       }                                                                        \
+      _schema_relevancy = parent_schema->relevancy;                            \
     }                                                                          \
   }
 
@@ -336,7 +696,10 @@ public:                                                                        \
 #define DEFINE_SCHEMA_CLASS(ClassName, ...)                                    \
   const network::Class_Schema *ClassName::get_schema() const                   \
   {                                                                            \
-    return network::Schema_Registry::get().get_schema(#ClassName);             \
+    static const network::Class_Schema *schema =                               \
+        (ClassName::register_schema(),                                         \
+         network::Schema_Registry::get().get_schema(#ClassName));              \
+    return schema;                                                             \
   }                                                                            \
   namespace                                                                    \
   {                                                                            \
@@ -348,10 +711,14 @@ public:                                                                        \
   }                                                                            \
   void ClassName::register_schema()                                            \
   {                                                                            \
+    network::register_entity_schemas();                                        \
+    if (network::Schema_Registry::get().get_schema(#ClassName))                \
+      return;                                                                  \
     using ThisClass = ClassName;                                               \
     static constexpr const char *_schema_class_name = #ClassName;              \
     (void)sizeof(ThisClass);                                                   \
     std::vector<network::Field_Prop> props;                                    \
+    network::Class_Relevancy _schema_relevancy;                                \
     _SCHEMA_INHERIT_FIELDS(ClassName __VA_OPT__(, ) __VA_ARGS__)
 
 #define BEGIN_SCHEMA_FIELDS()
@@ -364,10 +731,25 @@ public:                                                                        \
                    (uint32_t)props.size(), offsetof(ThisClass, MemberName),    \
                    ThisClass::_schema_meta_##MemberName.size,                  \
                    ThisClass::_schema_meta_##MemberName.type,                  \
-                   ThisClass::_schema_meta_##MemberName.flags});
+                   ThisClass::_schema_meta_##MemberName.flags,                 \
+                   ThisClass::_schema_meta_##MemberName.quantization});
+
+// Overrides the relevancy inherited from the parent class.
+// Usage: SCHEMA_RELEVANCY(Radius, 1500.0f) or SCHEMA_RELEVANCY(Never, 0.0f)
+#define SCHEMA_RELEVANCY(Mode, Radius)                                         \
+  _schema_relevancy.mode = ::network::Relevancy::Mode;                         \
+  _schema_relevancy.radius = Radius;
+
+// Overrides the inherited bandwidth priority weight (default 1).
+#define SCHEMA_PRIORITY(Weight) _schema_relevancy.priority = Weight;
+
+// Opts the class into change tracking: its networked fields must only be
+// written through Entity::set() (see Class_Relevancy::track_changes).
+#define SCHEMA_TRACK_CHANGES() _schema_relevancy.track_changes = true;
 
 #define END_SCHEMA_FIELDS()                                                    \
-  network::Schema_Registry::get().register_class(_schema_class_name, props);   \
+  network::Schema_Registry::get().register_class(_schema_class_name, props,    \
+                                                 _schema_relevancy);           \
   }
 
 } // namespace network
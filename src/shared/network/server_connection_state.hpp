@@ -1,102 +1,304 @@
 #pragma once
 
+#include "address_table.hpp"
+#include "buffer_pool.hpp"
 #include "game.pb.h"
 #include "network_types.hpp"
+#include "reassembly.hpp"
 #include "udp_socket.hpp"
+#include "usercmd.hpp"
 #include <algorithm>
 #include <array>
 #include <cassert>
 #include <chrono>
-#include <iostream>
-#include <map>
+#include <random>
 #include <vector>
 
 namespace network
 {
 
-struct Byte_Buffer
-{
-  std::vector<uint8> data = std::vector<uint8>(2048 * 2048);
-  size_t cursor = 0; // byte_offset to insert at.
-};
-
 struct TimestampedMove
 {
   uint64 timestamp;
   game::CmdMove move;
 };
 
+// Most unknown senders a ServerInbox collects between two reads.
+constexpr size_t max_potential_joins = 16;
+
 struct ServerInbox
 {
   // Pair of player_idx and move
   std::vector<std::pair<int, TimestampedMove>> moves;
+  // Unknown senders, deduplicated, at most max_potential_joins.
   std::vector<Address> potential_joins;
   // Commands from players (or potential players)
   std::vector<std::pair<Address, game::NetCommand>> net_commands;
 };
 
+// Token bucket for packets from addresses that hold no slot. Those cost a
+// protobuf parse and can come from anywhere, so past the rate they are
+// dropped unread.
+class Unknown_Sender_Limiter
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  float packets_per_second = 64.0f;
+  float burst = 16.0f;
+
+  bool admit(clock::time_point now)
+  {
+    std::chrono::duration<float> elapsed = now - last_refill;
+    last_refill = now;
+    tokens = std::min(burst, tokens + elapsed.count() * packets_per_second);
+    if (tokens < 1.0f)
+    {
+      dropped += 1;
+      return false;
+    }
+    tokens -= 1.0f;
+    return true;
+  }
+
+  uint64 dropped_count() const { return dropped; }
+
+private:
+  float tokens = 0.0f;
+  clock::time_point last_refill{};
+  uint64 dropped = 0;
+};
+
 struct Server_Connection_State
 {
   // things we thought about
   std::array<bool, sv_max_player_count> player_slots{};
   std::array<Address, sv_max_player_count> player_ips{};
+  // Token handed to each connected client in CmdAccept; it stamps every
+  // packet with it. Zero for free slots. See connection_token_slot().
+  std::array<uint16, sv_max_player_count> connection_tokens{};
+  // player_ips, inverted. Kept in sync by connect_player/disconnect_player.
+  Address_Table<sv_max_player_count> slot_by_address;
+  Unknown_Sender_Limiter unknown_senders;
+  std::mt19937 token_rng{std::random_device{}()};
+  // Empty until a connection reserves from buffer_pool; released on
+  // disconnect and reused by the next player.
   std::array<Byte_Buffer, sv_max_player_count> player_byte_buffers{};
+  Buffer_Pool buffer_pool;
+
+  // Packet reassembly only. Client messages are small, so a few short
+  // messages in flight per player are plenty.
+  std::array<Reassembly_Ring, sv_max_player_count> reassembly;
 
-  // Packet reassembly only
-  std::array<std::map<uint8, std::vector<Packet>>, sv_max_player_count>
-      partial_packets{};
+  // Input received from each player, in command order.
+  std::array<Usercmd_Ring, sv_max_player_count> usercmds{};
+
+  // Last snapshot tick each client acknowledged (0 = none yet). Snapshots for
+  // a slot are delta encoded against this tick.
+  std::array<uint32, sv_max_player_count> last_acked_tick{};
 };
 
+// The slot a connection token was issued for. Tokens are
+// salt * sv_max_player_count + slot with a random non-zero salt, so a packet
+// names its slot directly and a stale or forged token is unlikely to match.
+inline size_t connection_token_slot(uint16 token)
+{
+  return token % sv_max_player_count;
+}
+
+// Occupies `slot` for `ip` and resets its per-connection state. Returns the
+// connection token for the client.
+inline uint16 connect_player(Server_Connection_State &state, size_t slot,
+                             const Address &ip)
+{
+  static_assert(sv_max_player_count <= 0xFFFF / 2);
+  constexpr uint32 max_salt = 0xFFFF / sv_max_player_count;
+  uint32 salt = std::uniform_int_distribution<uint32>(1, max_salt)(
+      state.token_rng);
+  uint16 token = static_cast<uint16>(salt * sv_max_player_count + slot);
+
+  state.player_slots[slot] = true;
+  state.player_ips[slot] = ip;
+  state.connection_tokens[slot] = token;
+  state.slot_by_address.insert(ip, static_cast<int>(slot));
+  state.buffer_pool.release(state.player_byte_buffers[slot]);
+  state.reassembly[slot].clear();
+  state.usercmds[slot].clear();
+  state.last_acked_tick[slot] = 0;
+  return token;
+}
+
+// Returns the player slot of `ip`, or -1 if it has none.
+inline size_t get_player_idx(const Server_Connection_State &state,
+                             const Address &ip)
+{
+  int slot = state.slot_by_address.find(ip);
+  return slot < 0 ? size_t(-1) : size_t(slot);
+}
+
 inline void disconnect_player(Server_Connection_State &server_connection_state,
                               const Address &ip)
 {
-  int idx = 0;
-  for (auto &player_ip : server_connection_state.player_ips)
-  {
-    if (server_connection_state.player_slots[idx] && ip == player_ip)
-    {
-      server_connection_state.player_ips[idx] = {};
-      server_connection_state.player_slots[idx] = false;
-      server_connection_state.partial_packets[idx].clear();
+  size_t idx = get_player_idx(server_connection_state, ip);
+  if (idx == size_t(-1))
+    return;
 
-      return;
-    }
-    idx += 1;
-  }
+  server_connection_state.slot_by_address.erase(ip);
+  server_connection_state.player_ips[idx] = {};
+  server_connection_state.player_slots[idx] = false;
+  server_connection_state.connection_tokens[idx] = 0;
+  server_connection_state.buffer_pool.release(
+      server_connection_state.player_byte_buffers[idx]);
+  server_connection_state.reassembly[idx].clear();
+  server_connection_state.usercmds[idx].clear();
+  server_connection_state.last_acked_tick[idx] = 0;
 }
 
 // can return null
 inline Byte_Buffer *get_player_packet_byte_buffer_from_ip(
     Server_Connection_State &server_connection_state, const Address &ip)
 {
-  int idx = 0;
-  for (auto &player_ip : server_connection_state.player_ips)
+  size_t idx = get_player_idx(server_connection_state, ip);
+  if (idx == size_t(-1))
+    return nullptr;
+  return &server_connection_state.player_byte_buffers[idx];
+}
+
+// The slot a received packet belongs to, or -1. A valid connection token
+// indexes the slot directly; packets without one (the connect handshake,
+// older clients) fall back to the address table.
+inline size_t find_sender_slot(const Server_Connection_State &state,
+                               const Packet_Header &header,
+                               const Address &sender)
+{
+  if (header.connection_token != 0)
   {
-    if (server_connection_state.player_slots[idx] && ip == player_ip)
-      return &server_connection_state.player_byte_buffers[idx];
-    idx += 1;
+    size_t slot = connection_token_slot(header.connection_token);
+    if (state.connection_tokens[slot] == header.connection_token &&
+        state.player_ips[slot] == sender)
+      return slot;
   }
+  return get_player_idx(state, sender);
+}
 
-  return nullptr;
+inline bool parse_net_command(const Packet &packet, game::NetCommand &cmd)
+{
+  // NetCommands are small (a connect is the largest), so they are only
+  // accepted as single packets; unknown senders get no reassembly state.
+  return packet.header.sequence_count == 1 &&
+         cmd.ParseFromArray(packet.buffer, packet.header.payload_size);
 }
 
-inline size_t get_player_idx(Server_Connection_State &server_connection_state,
-                             const Address &ip)
+// Routes one received packet: net commands go to the inbox, fragments of
+// known players are reassembled. Packets from unknown senders are
+// rate limited (see Unknown_Sender_Limiter) and their addresses collected
+// in potential_joins.
+inline void handle_received_packet(Server_Connection_State &state,
+                                   const Packet &packet, const Address &sender,
+                                   ServerInbox &out_inbox)
+{
+  bool is_net_command = packet.header.message_type ==
+                        static_cast<uint8>(Message_Type::NetCommand);
+
+  size_t player_idx = find_sender_slot(state, packet.header, sender);
+  if (player_idx == size_t(-1))
+  {
+    if (!state.unknown_senders.admit(Unknown_Sender_Limiter::clock::now()))
+      return;
+
+    game::NetCommand cmd;
+    if (is_net_command && parse_net_command(packet, cmd))
+      out_inbox.net_commands.push_back({sender, cmd});
+
+    auto &joins = out_inbox.potential_joins;
+    if (joins.size() < max_potential_joins &&
+        std::find(joins.begin(), joins.end(), sender) == joins.end())
+      joins.push_back(sender);
+    return;
+  }
+
+  if (is_net_command)
+  {
+    game::NetCommand cmd;
+    if (parse_net_command(packet, cmd))
+      out_inbox.net_commands.push_back({sender, cmd});
+    return;
+  }
+
+  // Usercmds always fit one datagram and go straight into the player's ring.
+  if (packet.header.message_type ==
+      static_cast<uint8>(Message_Type::C2S_UserCmds))
+  {
+    Bit_Reader reader(packet.buffer, packet.header.payload_size);
+    if (packet.header.sequence_count == 1)
+      state.usercmds[player_idx].read(reader);
+    return;
+  }
+
+  std::span<const uint8> message = state.reassembly[player_idx].insert(
+      packet, Reassembly_Ring::clock::now());
+  if (message.empty())
+    return;
+
+  if (packet.header.message_type ==
+      static_cast<uint8>(Message_Type::C2S_PlayerMoveCommand))
+  {
+    game::CmdMove move_cmd;
+    if (move_cmd.ParseFromArray(message.data(),
+                                static_cast<int>(message.size())))
+    {
+      out_inbox.moves.push_back({static_cast<int>(player_idx),
+                                 {packet.header.timestamp, move_cmd}});
+    }
+  }
+}
+
+// Serializes `msg` and sends it to `destination`, fragmented as needed.
+// `sequence_id` tells concurrent multi-packet messages apart on the receiver.
+template <typename T>
+inline void send_protobuf_message(Udp_Socket &socket,
+                                  const Address &destination, const T &msg,
+                                  uint8 sequence_id = 0)
+{
+  std::vector<uint8> buffer(msg.ByteSizeLong());
+  msg.SerializeToArray(buffer.data(), static_cast<int>(buffer.size()));
+
+  constexpr uint8 msg_type_id = static_cast<uint8>(Packet_Traits<T>::type);
+  auto packets = convert_to_packets(buffer, msg_type_id);
+  for (auto &packet : packets)
+    packet.header.sequence_id = sequence_id;
+  socket.send_batch(packets, destination);
+}
+
+// How many datagrams poll_network pulls per receive_batch call.
+constexpr size_t server_receive_batch_size = 32;
+
+// Reads everything currently queued on the socket without waiting.
+inline void drain_network(Server_Connection_State &state, Udp_Socket &socket,
+                          ServerInbox &out_inbox)
 {
-  size_t idx = 0;
-  for (auto &player_ip : server_connection_state.player_ips)
+  std::array<Packet, server_receive_batch_size> packets;
+  std::array<Address, server_receive_batch_size> senders;
+
+  size_t received;
+  while ((received = socket.receive_batch(packets, senders)) > 0)
   {
-    if (server_connection_state.player_slots[idx] && ip == player_ip)
+    for (size_t i = 0; i < received; ++i)
     {
-      return idx;
+      handle_received_packet(state, packets[i], senders[i], out_inbox);
     }
-    idx += 1;
   }
 
-  std::cerr << "player not found while get_player_idx is invoked...\n";
-  return -1;
+  auto now = Reassembly_Ring::clock::now();
+  for (size_t slot = 0; slot < sv_max_player_count; ++slot)
+  {
+    if (state.player_slots[slot])
+      state.reassembly[slot].evict_stale(now);
+  }
 }
 
+// Receives for a fixed time window, blocking on the socket in between
+// packets rather than spinning.
 inline void poll_network(Server_Connection_State &state, Udp_Socket &socket,
                          double time_window_seconds, ServerInbox &out_inbox)
 {
@@ -106,94 +308,14 @@ inline void poll_network(Server_Connection_State &state, Udp_Socket &socket,
 
   while (true)
   {
-    auto now = clock::now();
-    if (now - start_time >= timeout)
+    auto elapsed = clock::now() - start_time;
+    if (elapsed >= timeout)
       break;
 
-    Packet packet;
-    Address sender;
-    if (socket.receive(packet, sender))
-    {
-      if (packet.header.message_type ==
-          static_cast<uint8>(Message_Type::NetCommand))
-      {
-        // For now, assume NetCommands are single-packet for simplicity
-        // regarding unknown senders. Or use a temporary buffer. Since Connect
-        // is small, strict single-packet check.
-        if (packet.header.sequence_count == 1)
-        {
-          game::NetCommand cmd;
-          if (cmd.ParseFromArray(packet.buffer, packet.header.payload_size))
-          {
-            out_inbox.net_commands.push_back({sender, cmd});
-          }
-        }
-      }
-
-      size_t player_idx = get_player_idx(state, sender);
-      if (player_idx == -1)
-      {
-        // Unknown player, maybe they want to join?
-        // Deduplicate? For now, just add.
-        out_inbox.potential_joins.push_back(sender);
-        continue; // Unknown player
-      }
-
-      // Store packet fragment
-      auto &fragments =
-          state.partial_packets[player_idx][packet.header.sequence_id];
-
-      // Resize if new sequence
-      if (fragments.empty())
-      {
-        fragments.resize(packet.header.sequence_count);
-      }
-      // Ensure we don't overflow if sequence_count changed (malicious/buggy?)
-      if (packet.header.sequence_idx < fragments.size())
-      {
-        fragments[packet.header.sequence_idx] = packet;
-      }
-
-      // Check if complete
-      bool complete = true;
-      size_t total_payload = 0;
-      for (const auto &frag : fragments)
-      {
-        if (frag.header.sequence_count == 0)
-        {
-          complete = false;
-          break;
-        }
-        total_payload += frag.header.payload_size;
-      }
-
-      if (complete)
-      {
-        // Reassemble
-        std::vector<uint8> buffer;
-        buffer.reserve(total_payload);
-        for (const auto &frag : fragments)
-        {
-          buffer.insert(buffer.end(), frag.buffer,
-                        frag.buffer + frag.header.payload_size);
-        }
-
-        // Parse
-        if (packet.header.message_type ==
-            static_cast<uint8>(Message_Type::C2S_PlayerMoveCommand))
-        {
-          game::CmdMove move_cmd;
-          if (move_cmd.ParseFromArray(buffer.data(), buffer.size()))
-          {
-            out_inbox.moves.push_back({static_cast<int>(player_idx),
-                                       {packet.header.timestamp, move_cmd}});
-          }
-        }
-
-        // Cleanup sequence
-        state.partial_packets[player_idx].erase(packet.header.sequence_id);
-      }
-    }
+    drain_network(state, socket, out_inbox);
+
+    auto remaining = std::chrono::duration<double>(timeout - elapsed).count();
+    socket.wait_readable(remaining);
   }
 }
 
@@ -0,0 +1,383 @@
+#pragma once
+
+#include "../task_system.hpp"
+#include "interest.hpp"
+#include "snapshot_history.hpp"
+#include "snapshot_priority.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace network
+{
+
+// Builds every client's snapshot payload for one tick, optionally fanned out
+// over a Task_System. Three stages, each joined before the next:
+//
+//   1. plan:     match every client's view against what it holds and mark
+//                which records anybody needs. A record is encoded against the
+//                copy of the entity the client holds, so records are grouped
+//                by the tick that copy is from (its held tick); entities new
+//                to a client need a full record, shared by everyone in group
+//                0.
+//   2. encode:   every group x chunk of entities is one job that encodes the
+//                needed records into its own Delta_Encode_Cache and notes
+//                where each one landed (by entity position).
+//   3. assemble: one job per client picks the records that fit its bandwidth
+//                budget, highest priority first, and splices them from the
+//                (now read-only) caches into the client's own Bit_Writer.
+//                Only spliced records count in the Bandwidth_Profiler.
+//
+// Jobs share nothing mutable, so the payloads are bit-identical to
+// write_snapshot_view() (for clients without a budget) regardless of the
+// number of workers, and entities nobody can see cost nothing to encode.
+class Snapshot_Builder
+{
+public:
+  static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+  // Entities per encode job.
+  size_t encode_chunk_size = 256;
+
+  struct Client
+  {
+    // What the client holds at the tick it acked (empty = full snapshot).
+    snapshot_view_t baseline;
+    // What is relevant to it now (null = everything).
+    const std::vector<uint32> *visible = nullptr;
+    // Per visible entity: how fast a pending update gains priority (null =
+    // 1 for all).
+    const std::vector<float> *priority_rates = nullptr;
+    // Bytes of entity data this tick. Removal records and the end marker are
+    // always written; entity records that do not fit are deferred.
+    size_t budget_bytes = unlimited;
+    // The client's accumulated priorities; required with a budget.
+    Priority_Accumulator *priorities = nullptr;
+    // Receives what the client holds after this snapshot (optional).
+    sent_view_t *sent = nullptr;
+  };
+
+  // Builds one payload per entry of `baselines` (null = full snapshot), each
+  // containing the whole of `current`.
+  void build(const snapshot_t &current,
+             std::span<const snapshot_t *const> baselines,
+             Task_System *tasks = nullptr)
+  {
+    whole_views.clear();
+    for (const snapshot_t *baseline : baselines)
+      whole_views.push_back({{baseline}});
+    build(current, std::span<const Client>(whole_views), nullptr, tasks);
+  }
+
+  // Builds one payload per client. `history` resolves the held ticks of
+  // deferred entities; without it those are sent in full.
+  void build(const snapshot_t &current, std::span<const Client> clients,
+             const Snapshot_Ring *history, Task_System *tasks = nullptr)
+  {
+    size_t chunk_size = std::max<size_t>(encode_chunk_size, 1);
+    size_t entity_count = current.entities.size();
+    chunk_count = (entity_count + chunk_size - 1) / chunk_size;
+
+    // 1. Plan. Cheap next to encoding (no field compares), so not worth
+    // splitting across threads.
+    groups.assign(1, nullptr);
+    group_by_slot.fill(0);
+    needed.assign(entity_count, 0);
+    if (plans.size() < clients.size())
+      plans.resize(clients.size());
+    uint64 records = 0;
+    for (size_t c = 0; c < clients.size(); ++c)
+    {
+      const Client &client = clients[c];
+      std::vector<plan_entry_t> &plan = plans[c];
+      plan.clear();
+      uint32 visible_slot = 0;
+      snapshot_detail::match_views(
+          {&current, client.visible}, client.baseline,
+          [&](size_t position, const snapshot_entity_t *base_entity,
+              size_t base_slot)
+          {
+            plan_entry_t entry;
+            entry.position = static_cast<uint32>(position);
+            entry.visible_slot = visible_slot++;
+            if (base_entity &&
+                snapshot_detail::held_state(client.baseline, base_slot,
+                                            *base_entity, history,
+                                            entry.held_tick))
+            {
+              entry.group = group_for(entry.held_tick, client.baseline,
+                                      history, entity_count);
+            }
+            needed[entry.group * entity_count + position] = 1;
+            plan.push_back(entry);
+            records += 1;
+          },
+          [&](const snapshot_entity_t &removed)
+          {
+            plan_entry_t entry;
+            entry.removed = &removed;
+            plan.push_back(entry);
+          });
+    }
+
+    caches.resize(groups.size() * chunk_count);
+    spans.resize(groups.size() * entity_count);
+
+    // 2. Encode.
+    auto encode_job = [&](size_t job)
+    {
+      size_t group = job / chunk_count;
+      const snapshot_t *source = groups[group];
+      size_t first = (job % chunk_count) * chunk_size;
+      size_t last = std::min(first + chunk_size, entity_count);
+
+      Delta_Encode_Cache &cache = caches[job];
+      cache.begin_tick(current.tick);
+      cache.reset_stats();
+      for (size_t i = first; i < last; ++i)
+      {
+        if (!needed[group * entity_count + i])
+          continue;
+        const snapshot_entity_t &entity = current.entities[i];
+        const snapshot_entity_t *base_entity =
+            source ? source->find(entity.id) : nullptr;
+        const uint8 *base_state =
+            base_entity && base_entity->type == entity.type
+                ? source->state_of(*base_entity)
+                : nullptr;
+        uint32 base_tick = source ? source->tick : 0;
+        // Untouched tracked entities cost neither a compare nor a cache slot.
+        if (base_state && snapshot_detail::unchanged_since(entity, base_tick))
+        {
+          spans[group * entity_count + i] = {};
+          continue;
+        }
+        spans[group * entity_count + i] = cache.find_or_encode(
+            entity.id.index, base_tick,
+            [&](Bit_Writer &w, std::vector<field_bits_t> *profile)
+            {
+              snapshot_detail::write_entity_record(w, entity,
+                                                   current.state_of(entity),
+                                                   base_state, base_tick,
+                                                   profile);
+            });
+      }
+    };
+    run(tasks, caches.size(), encode_job);
+
+    // 3. Assemble.
+    if (writers.size() < clients.size())
+    {
+      writers.resize(clients.size());
+      selections.resize(clients.size());
+      candidates.resize(clients.size());
+    }
+    auto assemble_job = [&](size_t c)
+    {
+      const Client &client = clients[c];
+      const std::vector<plan_entry_t> &plan = plans[c];
+      std::vector<uint8> &selected = selections[c];
+      select_records(current, client, plan, entity_count, selected,
+                     candidates[c]);
+
+      Bit_Writer &writer = writers[c];
+      writer.reset();
+      for (size_t i = 0; i < plan.size(); ++i)
+      {
+        const plan_entry_t &entry = plan[i];
+        if (entry.removed)
+        {
+          snapshot_detail::write_record_header(writer, true,
+                                               entry.removed->id);
+          continue;
+        }
+
+        const Delta_Encode_Cache::Span &span = span_of(entry, entity_count);
+        if (selected[i])
+        {
+          caches[entry.group * chunk_count + entry.position / chunk_size]
+              .splice(writer, span);
+        }
+        if (!client.sent)
+          continue;
+
+        // What the client holds of this entity once it applied the snapshot.
+        bool unchanged = entry.group != 0 && span.bit_count == 0;
+        uint32 held_tick =
+            selected[i] || unchanged ? current.tick : entry.held_tick;
+        if (held_tick != 0)
+        {
+          client.sent->visible.push_back(entry.position);
+          client.sent->held_ticks.push_back(held_tick);
+        }
+      }
+      writer.write_bit(false); // end
+      writer.flush();
+    };
+    run(tasks, clients.size(), assemble_job);
+
+    uint64 encoded = 0;
+    for (const Delta_Encode_Cache &cache : caches)
+      encoded += cache.stats().lookups - cache.stats().hits;
+    build_stats.lookups += records;
+    build_stats.hits += records - encoded;
+    client_count = clients.size();
+  }
+
+  // The payload built for client `client` by the last build().
+  std::span<const uint8> payload(size_t client)
+  {
+    const auto &bytes = writers[client].flush();
+    return {bytes.data(), bytes.size()};
+  }
+
+  size_t payload_count() const { return client_count; }
+
+  // Record lookups across all clients; a hit is a record that another client
+  // holding the same copy of the entity already paid to encode.
+  const Delta_Encode_Cache::stats_t &stats() const { return build_stats; }
+  void reset_stats() { build_stats = {}; }
+
+private:
+  // One step of a client's walk, in id order.
+  struct plan_entry_t
+  {
+    const snapshot_entity_t *removed = nullptr; // a removal record if set
+    uint32 position = 0;                        // in current.entities
+    uint32 visible_slot = 0;                    // index into Client::visible
+    uint32 group = 0;                           // 0: full record
+    uint32 held_tick = 0;                       // 0: client has no copy
+  };
+
+  const Delta_Encode_Cache::Span &span_of(const plan_entry_t &entry,
+                                          size_t entity_count) const
+  {
+    return spans[entry.group * entity_count + entry.position];
+  }
+
+  static uint32 tick_of(const snapshot_t *snapshot)
+  {
+    return snapshot ? snapshot->tick : 0;
+  }
+
+  // The encode group for copies from `held_tick`, added on first use.
+  uint32 group_for(uint32 held_tick, const snapshot_view_t &baseline,
+                   const Snapshot_Ring *history, size_t entity_count)
+  {
+    uint32 &group = group_by_slot[held_tick % snapshot_history_length];
+    if (group != 0 && tick_of(groups[group]) == held_tick)
+      return group;
+
+    // held_state() found the copy, so this cannot miss.
+    const snapshot_t *source = held_tick == baseline.tick()
+                                   ? baseline.snapshot
+                                   : history->find(held_tick);
+    group = static_cast<uint32>(groups.size());
+    groups.push_back(source);
+    needed.resize(needed.size() + entity_count, 0);
+    return group;
+  }
+
+  // A record waiting for room in a client's budget.
+  struct candidate_t
+  {
+    float priority;
+    uint32 plan_index;
+  };
+
+  // Decides which of the client's entity records go out this tick and
+  // updates its priorities. Without a budget everything does. `candidates`
+  // is scratch space.
+  void select_records(const snapshot_t &current, const Client &client,
+                      const std::vector<plan_entry_t> &plan,
+                      size_t entity_count, std::vector<uint8> &selected,
+                      std::vector<candidate_t> &candidates) const
+  {
+    selected.assign(plan.size(), 1);
+    if (client.budget_bytes == unlimited || !client.priorities)
+      return;
+
+    candidates.clear();
+    size_t used_bits = 1; // end marker
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      const plan_entry_t &entry = plan[i];
+      if (entry.removed)
+      {
+        Entity_Id id = entry.removed->id;
+        used_bits += 2 + var_uint_bits(id.index) + var_uint_bits(id.generation);
+        client.priorities->set(id.index, 0.0f);
+        continue;
+      }
+
+      uint32 index = current.entities[entry.position].id.index;
+      if (span_of(entry, entity_count).bit_count == 0)
+      {
+        client.priorities->set(index, 0.0f); // nothing pending
+        continue;
+      }
+
+      float rate = client.priority_rates
+                       ? (*client.priority_rates)[entry.visible_slot]
+                       : 1.0f;
+      float priority = client.priorities->get(index) + rate;
+      client.priorities->set(index, priority);
+      candidates.push_back({priority, static_cast<uint32>(i)});
+      selected[i] = 0;
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const candidate_t &a, const candidate_t &b)
+                     { return a.priority > b.priority; });
+
+    // Greedy fill: a record that does not fit leaves the room to smaller ones
+    // further down the list.
+    size_t budget_bits = client.budget_bytes * 8;
+    for (const candidate_t &candidate : candidates)
+    {
+      const plan_entry_t &entry = plan[candidate.plan_index];
+      size_t bits = span_of(entry, entity_count).bit_count;
+      if (used_bits + bits > budget_bits)
+        continue;
+      used_bits += bits;
+      selected[candidate.plan_index] = 1;
+      client.priorities->set(current.entities[entry.position].id.index, 0.0f);
+    }
+  }
+
+  template <typename Job_Fn>
+  static void run(Task_System *tasks, size_t job_count, Job_Fn &job)
+  {
+    if (tasks)
+    {
+      tasks->parallel_for(job_count, job);
+      return;
+    }
+    for (size_t i = 0; i < job_count; ++i)
+      job(i);
+  }
+
+  std::vector<Client> whole_views;
+  // The snapshot each encode group's records are relative to (0: none).
+  std::vector<const snapshot_t *> groups;
+  // Group of each held tick, by ring slot (0: not seen this build).
+  std::array<uint32, snapshot_history_length> group_by_slot{};
+  size_t chunk_count = 0;
+  // groups.size() x entity count: whether anybody needs the record.
+  std::vector<uint8> needed;
+  // groups.size() x chunk_count, group major.
+  std::vector<Delta_Encode_Cache> caches;
+  // groups.size() x entity count: where each entity's record is cached.
+  std::vector<Delta_Encode_Cache::Span> spans;
+  // Per client, reused across ticks.
+  std::vector<std::vector<plan_entry_t>> plans;
+  std::vector<std::vector<uint8>> selections;
+  std::vector<std::vector<candidate_t>> candidates;
+  std::vector<Bit_Writer> writers;
+  size_t client_count = 0;
+  Delta_Encode_Cache::stats_t build_stats;
+};
+
+} // namespace network
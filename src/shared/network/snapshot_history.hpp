@@ -0,0 +1,680 @@
+#pragma once
+
+#include "../entity_system.hpp"
+#include "bandwidth_profiler.hpp"
+#include "bitstream.hpp"
+#include "quantization.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Snapshot history for acked-baseline delta compression.
+//
+// Every tick the server copies the replicated world into a snapshot_t and
+// keeps the last snapshot_history_length of them in a Snapshot_Ring. Each
+// client acknowledges the ticks it received; the next snapshot for that client
+// is encoded against the last tick it acknowledged, so unchanged entities cost
+// nothing and changed ones only send their changed fields. If the acked tick
+// has already been overwritten in the ring (or the client never acked), the
+// snapshot is sent in full.
+//
+// With interest management a client is only sent part of each snapshot (a
+// snapshot_view_t, see interest.hpp). Its baseline is then the view it was
+// sent at the acked tick: an entity that entered its view since is sent in
+// full, one that left it (or was destroyed) gets a removal record. When a
+// bandwidth budget defers an entity's update, the client keeps an older copy
+// of it; the view then records which tick that copy is from (its held tick)
+// and the next delta for the entity is encoded against that tick instead.
+//
+// Wire format of a snapshot (the S2C_EntityPackage entity_data), one record
+// per entity that differs from the baseline, in ascending id order:
+//   1 bit    more records follow
+//   1 bit    removed
+//   var_uint id.index, var_uint id.generation
+//   if not removed:
+//     8 bits   class id (Class_Schema::class_id, equal to the entity_type)
+//     1 bit    delta (fields are relative to the baseline copy of this entity)
+//     fields   (serialize_fields)
+
+namespace network
+{
+
+struct snapshot_entity_t
+{
+  Entity_Id id;
+  entity_type type;
+  const Class_Schema *schema;
+  uint32 state_offset; // into snapshot_t::state
+
+  // Change tracking (see SCHEMA_TRACK_CHANGES), from the entity at capture.
+  bool tracked = false;
+  uint32 last_changed_tick = 0; // state is the same as at any later capture
+  uint32 changed_since = 0;     // previous capture of the entity (0 = none)
+  Field_Mask changed_fields = 0; // fields changed since `changed_since`
+};
+
+struct snapshot_t
+{
+  uint32 tick = 0; // 0 = empty / no snapshot
+  // Sorted by id.index.
+  std::vector<snapshot_entity_t> entities;
+  // Flat copies of every entity's first schema->state_size bytes.
+  std::vector<uint8> state;
+
+  void clear()
+  {
+    tick = 0;
+    entities.clear();
+    state.clear();
+  }
+
+  const uint8 *state_of(const snapshot_entity_t &entity) const
+  {
+    return state.data() + entity.state_offset;
+  }
+
+  uint8 *state_of(const snapshot_entity_t &entity)
+  {
+    return state.data() + entity.state_offset;
+  }
+
+  const snapshot_entity_t *find(Entity_Id id) const
+  {
+    auto it = std::lower_bound(entities.begin(), entities.end(), id.index,
+                               [](const snapshot_entity_t &e, uint32 index)
+                               { return e.id.index < index; });
+    if (it == entities.end() || !(it->id == id))
+      return nullptr;
+    return &*it;
+  }
+
+  // Appends an entity and returns its (uninitialized) state bytes.
+  uint8 *append(Entity_Id id, entity_type type, const Class_Schema *schema)
+  {
+    uint32 offset = static_cast<uint32>(state.size());
+    entities.push_back({id, type, schema, offset});
+    state.resize(state.size() + schema->state_size);
+    return state.data() + offset;
+  }
+};
+
+// The part of a snapshot one client sees: the entities at `visible`
+// (ascending positions into snapshot->entities), or all of them if `visible`
+// is null. A null snapshot is an empty view.
+struct snapshot_view_t
+{
+  const snapshot_t *snapshot = nullptr;
+  const std::vector<uint32> *visible = nullptr;
+  // Per visible entity: the tick of the state the client holds for it. Null
+  // if that is snapshot->tick for all of them.
+  const std::vector<uint32> *held_ticks = nullptr;
+
+  size_t size() const
+  {
+    if (!snapshot)
+      return 0;
+    return visible ? visible->size() : snapshot->entities.size();
+  }
+
+  // Position in snapshot->entities of the i-th visible entity.
+  size_t position(size_t i) const { return visible ? (*visible)[i] : i; }
+
+  uint32 held_tick(size_t i) const
+  {
+    return held_ticks ? (*held_ticks)[i] : tick();
+  }
+
+  uint32 tick() const { return snapshot ? snapshot->tick : 0; }
+};
+
+// Entities that appeared in / disappeared from a client's view between two
+// snapshots, so the game can spawn and despawn them.
+struct snapshot_events_t
+{
+  std::vector<Entity_Id> entered;
+  std::vector<Entity_Id> left; // destroyed or out of interest
+
+  void clear()
+  {
+    entered.clear();
+    left.clear();
+  }
+};
+
+// ~1 second of history at 60 Hz.
+constexpr size_t snapshot_history_length = 64;
+
+class Snapshot_Ring
+{
+public:
+  // Returns the (cleared) slot for `tick`, overwriting whatever snapshot was
+  // stored there. The slot keeps its allocations.
+  snapshot_t &begin(uint32 tick)
+  {
+    snapshot_t &slot = slots[tick % snapshot_history_length];
+    slot.clear();
+    slot.tick = tick;
+    return slot;
+  }
+
+  void store(snapshot_t &&snapshot)
+  {
+    slots[snapshot.tick % snapshot_history_length] = std::move(snapshot);
+  }
+
+  // nullptr if `tick` is 0 or has aged out of the ring.
+  const snapshot_t *find(uint32 tick) const
+  {
+    if (tick == 0)
+      return nullptr;
+    const snapshot_t &slot = slots[tick % snapshot_history_length];
+    return slot.tick == tick ? &slot : nullptr;
+  }
+
+  void clear()
+  {
+    for (auto &slot : slots)
+      slot.clear();
+  }
+
+private:
+  std::array<snapshot_t, snapshot_history_length> slots;
+};
+
+namespace snapshot_detail
+{
+
+template <typename System>
+inline void capture_entities(System &system, snapshot_t &out)
+{
+  constexpr bool consume_changes = !std::is_const_v<System>;
+  for (const auto &[type, pool] : system.pools)
+  {
+    const Class_Schema *schema = shared::schema_for_type(type);
+    if (!schema)
+      continue;
+
+    for (size_t i = 0; i < pool->size(); ++i)
+    {
+      auto *entity = pool->at(i);
+      if (entity->id.index == 0)
+        continue; // never given a network id
+      uint8 *state = out.append(entity->id, type, schema);
+      std::memcpy(state, reinterpret_cast<const uint8 *>(entity),
+                  schema->state_size);
+
+      if constexpr (consume_changes)
+      {
+        if (!schema->relevancy.track_changes)
+          continue;
+        if (entity->changed_fields)
+          entity->last_changed_tick = out.tick;
+        snapshot_entity_t &captured = out.entities.back();
+        captured.tracked = true;
+        captured.last_changed_tick = entity->last_changed_tick;
+        captured.changed_since = entity->last_captured_tick;
+        captured.changed_fields = entity->changed_fields;
+        entity->changed_fields = 0;
+        entity->last_captured_tick = out.tick;
+      }
+    }
+  }
+
+  std::sort(out.entities.begin(), out.entities.end(),
+            [](const snapshot_entity_t &a, const snapshot_entity_t &b)
+            { return a.id.index < b.id.index; });
+}
+
+} // namespace snapshot_detail
+
+// Copies every entity of the entity system into `out` (which should be empty,
+// see Snapshot_Ring::begin, with its tick set). Takes the changes tracked
+// since the previous capture off the entities, so every tick of one world
+// should be captured into the same history.
+inline void capture_snapshot(shared::Entity_System &system, snapshot_t &out)
+{
+  snapshot_detail::capture_entities(system, out);
+}
+
+// The same without touching change tracking: every entity is captured as
+// untracked and its records are found by comparing against the baseline.
+inline void capture_snapshot(const shared::Entity_System &system,
+                             snapshot_t &out)
+{
+  snapshot_detail::capture_entities(system, out);
+}
+
+namespace snapshot_detail
+{
+
+inline void write_record_header(Bit_Writer &writer, bool removed, Entity_Id id)
+{
+  writer.write_bit(true); // more
+  writer.write_bit(removed);
+  write_var_uint(writer, id.index);
+  write_var_uint(writer, id.generation);
+}
+
+// True if a tracked entity is known not to have changed since the capture
+// at `tick`, so its record against that copy is empty.
+inline bool unchanged_since(const snapshot_entity_t &entity, uint32 tick)
+{
+  return entity.tracked && tick != 0 && entity.last_changed_tick <= tick;
+}
+
+// The fields of `entity` that differ from its copy at `base_tick`. Tracked
+// entities know this without looking at the states as long as the copy is
+// from their previous capture (the usual case for clients in lockstep) or
+// nothing changed since.
+inline Field_Mask changed_fields_since(const snapshot_entity_t &entity,
+                                       const uint8 *state,
+                                       const uint8 *base_state,
+                                       uint32 base_tick)
+{
+  if (unchanged_since(entity, base_tick))
+    return 0;
+  if (entity.tracked && base_tick != 0 && base_tick == entity.changed_since)
+    return entity.changed_fields &
+           all_fields_mask(entity.schema->fields.size());
+  return changed_field_mask(entity.schema, state, base_state);
+}
+
+// Writes the record for one entity, or nothing if it did not change since
+// the baseline copy (from tick `base_tick`; 0 if unknown). `profile` receives
+// the bits of each field written (see serialize_changed_fields).
+inline void write_entity_record(Bit_Writer &writer,
+                                const snapshot_entity_t &entity,
+                                const uint8 *state, const uint8 *base_state,
+                                uint32 base_tick = 0,
+                                std::vector<field_bits_t> *profile = nullptr)
+{
+  Field_Mask changed = all_fields_mask(entity.schema->fields.size());
+  if (base_state)
+  {
+    changed = changed_fields_since(entity, state, base_state, base_tick);
+    if (!changed)
+      return;
+  }
+
+  write_record_header(writer, false, entity.id);
+  writer.write_bits(entity.schema->class_id, 8);
+  writer.write_bit(base_state != nullptr);
+  serialize_changed_fields(writer, entity.schema, state, changed, profile);
+}
+
+} // namespace snapshot_detail
+
+// Per-tick cache of encoded entity records, shared by all clients.
+//
+// An entity's record depends only on the current snapshot and the baseline
+// it is encoded against, so clients that acked the same tick need the exact
+// same bits. The first client to need a (entity, baseline tick) pair encodes
+// it into the cache; everyone else splices the cached bit span into their own
+// stream. With clients in lockstep this makes the encode cost roughly
+// O(entities) instead of O(clients x entities).
+//
+// While the Bandwidth_Profiler is enabled the cache also keeps each record's
+// field bits, and counts them every time the record is spliced.
+class Delta_Encode_Cache
+{
+public:
+  struct stats_t
+  {
+    uint64 lookups = 0;
+    uint64 hits = 0;
+
+    double hit_rate() const
+    {
+      return lookups ? double(hits) / double(lookups) : 0.0;
+    }
+  };
+
+  // Drops everything cached for a previous tick.
+  void begin_tick(uint32 tick)
+  {
+    if (tick == current_tick)
+      return;
+    current_tick = tick;
+    spans.clear();
+    storage.clear();
+    profile.clear();
+  }
+
+  // Location of one encoded record inside the cache.
+  struct Span
+  {
+    size_t byte_offset = 0;
+    size_t bit_count = 0; // 0: entity unchanged, nothing to write
+    // The record's field bits, if profiled.
+    uint32 profile_offset = 0;
+    uint32 profile_count = 0;
+  };
+
+  // Writes the record for (entity_index, baseline_tick) into `out`, calling
+  // `encode(Bit_Writer &, std::vector<field_bits_t> *profile)` to produce it
+  // on a miss; `profile` is null unless the Bandwidth_Profiler is enabled.
+  template <typename Encode_Fn>
+  void write(Bit_Writer &out, uint32 entity_index, uint32 baseline_tick,
+             Encode_Fn &&encode)
+  {
+    splice(out, find_or_encode(entity_index, baseline_tick, encode));
+  }
+
+  // Returns the cached record for (entity_index, baseline_tick), encoding it
+  // first on a miss.
+  template <typename Encode_Fn>
+  Span find_or_encode(uint32 entity_index, uint32 baseline_tick,
+                      Encode_Fn &&encode)
+  {
+    cache_stats.lookups += 1;
+
+    auto [it, inserted] = spans.try_emplace(key(entity_index, baseline_tick));
+    if (!inserted)
+    {
+      cache_stats.hits += 1;
+      return it->second;
+    }
+
+    // Records are stored byte aligned so they can be spliced from the start
+    // of a byte.
+    size_t profile_offset = profile.size();
+    scratch.reset();
+    encode(scratch, Bandwidth_Profiler::get().enabled() ? &profile : nullptr);
+    const auto &bytes = scratch.flush();
+    it->second = {storage.size(), scratch.bits_written(),
+                  static_cast<uint32>(profile_offset),
+                  static_cast<uint32>(profile.size() - profile_offset)};
+    storage.insert(storage.end(), bytes.begin(), bytes.end());
+    return it->second;
+  }
+
+  // Appends a record to `out`. Read-only, so any number of threads may
+  // splice from a cache nobody is encoding into.
+  void splice(Bit_Writer &out, const Span &span) const
+  {
+    if (!span.bit_count)
+      return;
+    out.write_bit_span(storage.data() + span.byte_offset, span.bit_count);
+    if (span.profile_count)
+      Bandwidth_Profiler::record_sent(
+          {profile.data() + span.profile_offset, span.profile_count});
+  }
+
+  const stats_t &stats() const { return cache_stats; }
+  void reset_stats() { cache_stats = {}; }
+
+private:
+  static uint64 key(uint32 entity_index, uint32 baseline_tick)
+  {
+    return (static_cast<uint64>(entity_index) << 32) | baseline_tick;
+  }
+
+  uint32 current_tick = 0;
+  std::unordered_map<uint64, Span> spans;
+  std::vector<uint8> storage;
+  std::vector<field_bits_t> profile;
+  Bit_Writer scratch;
+  stats_t cache_stats;
+};
+
+namespace snapshot_detail
+{
+
+// Matches the entities of `current` against those of `baseline` in id order.
+// Calls `on_removed(base_entity)` for baseline entities that are no longer
+// visible and `on_entity(position, base_entity, base_slot)` for every current
+// entity, where base_entity is null if the client does not have it yet and
+// base_slot is its index in the baseline view. Both views index into their
+// own snapshot.
+template <typename Entity_Fn, typename Removed_Fn>
+inline void match_views(const snapshot_view_t &current,
+                        const snapshot_view_t &baseline, Entity_Fn &&on_entity,
+                        Removed_Fn &&on_removed)
+{
+  size_t b = 0;
+  size_t base_count = baseline.size();
+  for (size_t i = 0; i < current.size(); ++i)
+  {
+    size_t position = current.position(i);
+    const snapshot_entity_t &entity = current.snapshot->entities[position];
+
+    // Baseline entities that are gone by now.
+    while (b < base_count && baseline.snapshot->entities[baseline.position(b)]
+                                     .id.index < entity.id.index)
+    {
+      on_removed(baseline.snapshot->entities[baseline.position(b)]);
+      ++b;
+    }
+
+    const snapshot_entity_t *base_entity = nullptr;
+    size_t base_slot = b;
+    if (b < base_count)
+    {
+      const snapshot_entity_t &candidate =
+          baseline.snapshot->entities[baseline.position(b)];
+      if (candidate.id.index == entity.id.index)
+      {
+        if (candidate.id == entity.id && candidate.type == entity.type)
+          base_entity = &candidate;
+        ++b;
+      }
+    }
+    on_entity(position, base_entity, base_slot);
+  }
+
+  for (; b < base_count; ++b)
+    on_removed(baseline.snapshot->entities[baseline.position(b)]);
+}
+
+// The state the client holds for `base_entity`, the `base_slot`-th entity of
+// `baseline`: the baseline's own copy, or an older one from `history` if its
+// updates were deferred. Null if that one has aged out. `held_tick` receives
+// the tick it is from.
+inline const uint8 *held_state(const snapshot_view_t &baseline,
+                               size_t base_slot,
+                               const snapshot_entity_t &base_entity,
+                               const Snapshot_Ring *history, uint32 &held_tick)
+{
+  held_tick = baseline.held_tick(base_slot);
+  if (held_tick == baseline.tick())
+    return baseline.snapshot->state_of(base_entity);
+
+  const snapshot_t *source = history ? history->find(held_tick) : nullptr;
+  const snapshot_entity_t *held =
+      source ? source->find(base_entity.id) : nullptr;
+  if (!held || held->type != base_entity.type)
+    return nullptr;
+  return source->state_of(*held);
+}
+
+// Walks `current` against `baseline`, writing the removal records and the end
+// marker itself and handing every current entity to
+// `emit_entity(position, entity, state, base_state, held_tick)`, where
+// base_state is null if the client does not have the entity (or its copy
+// aged out of `history`).
+template <typename Emit_Fn>
+inline void walk_snapshot(Bit_Writer &writer, const snapshot_view_t &current,
+                          const snapshot_view_t &baseline,
+                          const Snapshot_Ring *history, Emit_Fn &&emit_entity)
+{
+  // Removals are written as soon as they are found so that the records stay
+  // in id order; an entity whose id slot was reused is written as a new one.
+  match_views(
+      current, baseline,
+      [&](size_t position, const snapshot_entity_t *base_entity,
+          size_t base_slot)
+      {
+        const snapshot_entity_t &entity = current.snapshot->entities[position];
+        uint32 held_tick = 0;
+        const uint8 *base_state =
+            base_entity ? held_state(baseline, base_slot, *base_entity,
+                                     history, held_tick)
+                        : nullptr;
+        emit_entity(position, entity, current.snapshot->state_of(entity),
+                    base_state, held_tick);
+      },
+      [&](const snapshot_entity_t &removed)
+      { write_record_header(writer, true, removed.id); });
+
+  writer.write_bit(false); // end
+}
+
+} // namespace snapshot_detail
+
+// Encodes what a client sees of `current` against the view it acked
+// (an empty view = full snapshot); `history` resolves the held ticks of
+// deferred entities. With a cache, entity records are shared with other
+// clients holding the same copy of an entity; full records are the same for
+// everyone and cached under tick 0.
+inline void write_snapshot_view(Bit_Writer &writer,
+                                const snapshot_view_t &current,
+                                const snapshot_view_t &baseline,
+                                Delta_Encode_Cache *cache = nullptr,
+                                const Snapshot_Ring *history = nullptr)
+{
+  if (cache)
+    cache->begin_tick(current.tick());
+
+  std::vector<field_bits_t> profile;
+  bool profiling = Bandwidth_Profiler::get().enabled();
+  snapshot_detail::walk_snapshot(
+      writer, current, baseline, history,
+      [&](size_t, const snapshot_entity_t &entity, const uint8 *state,
+          const uint8 *base_state, uint32 held_tick)
+      {
+        if (cache)
+        {
+          cache->write(writer, entity.id.index, base_state ? held_tick : 0,
+                       [&](Bit_Writer &w, std::vector<field_bits_t> *bits)
+                       {
+                         snapshot_detail::write_entity_record(
+                             w, entity, state, base_state, held_tick, bits);
+                       });
+        }
+        else
+        {
+          profile.clear();
+          snapshot_detail::write_entity_record(writer, entity, state,
+                                               base_state, held_tick,
+                                               profiling ? &profile : nullptr);
+          Bandwidth_Profiler::record_sent(profile);
+        }
+      });
+}
+
+// Encodes all of `current` against `baseline` (null = full snapshot).
+inline void write_snapshot(Bit_Writer &writer, const snapshot_t &current,
+                           const snapshot_t *baseline,
+                           Delta_Encode_Cache *cache = nullptr)
+{
+  write_snapshot_view(writer, {&current}, {baseline}, cache);
+}
+
+// Decodes a snapshot written by write_snapshot into `out`. `baseline` must be
+// the client's copy of the snapshot it was encoded against (null for a full
+// snapshot). Returns false on malformed input.
+inline bool read_snapshot(Bit_Reader &reader, const snapshot_t *baseline,
+                          snapshot_t &out)
+{
+  static const snapshot_t empty;
+  const snapshot_t &base = baseline ? *baseline : empty;
+
+  out.entities.clear();
+  out.state.clear();
+
+  auto copy_from_base = [&](const snapshot_entity_t &entity)
+  {
+    uint8 *state = out.append(entity.id, entity.type, entity.schema);
+    std::memcpy(state, base.state_of(entity), entity.schema->state_size);
+  };
+
+  size_t b = 0;
+  uint32 last_index = 0;
+  while (reader.read_bit())
+  {
+    if (reader.bits_remaining() == 0)
+      return false;
+
+    bool removed = reader.read_bit();
+    Entity_Id id;
+    id.index = read_var_uint(reader);
+    id.generation = read_var_uint(reader);
+    if (id.index <= last_index)
+      return false; // records are strictly ascending
+    last_index = id.index;
+
+    // Unchanged entities carried over from the baseline.
+    while (b < base.entities.size() && base.entities[b].id.index < id.index)
+      copy_from_base(base.entities[b++]);
+
+    const snapshot_entity_t *base_entity = nullptr;
+    if (b < base.entities.size() && base.entities[b].id.index == id.index)
+      base_entity = &base.entities[b++];
+
+    if (removed)
+      continue;
+
+    auto type = static_cast<entity_type>(reader.read_bits(8)); // class id
+    bool delta = reader.read_bit();
+    const Class_Schema *schema = shared::schema_for_type(type);
+    if (!schema)
+      return false;
+
+    uint8 *state = out.append(id, type, schema);
+    if (delta)
+    {
+      if (!base_entity || !(base_entity->id == id) || base_entity->type != type)
+        return false;
+      std::memcpy(state, base.state_of(*base_entity), schema->state_size);
+    }
+    else
+    {
+      std::memset(state, 0, schema->state_size);
+    }
+    deserialize_fields(reader, schema, state);
+  }
+
+  for (; b < base.entities.size(); ++b)
+    copy_from_base(base.entities[b]);
+
+  return true;
+}
+
+// The entities that entered and left between the snapshot the client applied
+// last (null = none) and `next`. Computed against what the client has rather
+// than the delta's baseline, so an entity that re-arrives in a delta against
+// an older ack is not reported twice.
+inline void diff_snapshot_entities(const snapshot_t *previous,
+                                   const snapshot_t &next,
+                                   snapshot_events_t &events)
+{
+  events.clear();
+  static const snapshot_t empty;
+  const snapshot_t &prev = previous ? *previous : empty;
+
+  size_t p = 0;
+  for (const snapshot_entity_t &entity : next.entities)
+  {
+    while (p < prev.entities.size() &&
+           prev.entities[p].id.index < entity.id.index)
+      events.left.push_back(prev.entities[p++].id);
+
+    if (p < prev.entities.size() &&
+        prev.entities[p].id.index == entity.id.index)
+    {
+      const snapshot_entity_t &old = prev.entities[p++];
+      if (old.id == entity.id && old.type == entity.type)
+        continue;
+      events.left.push_back(old.id); // id slot reused
+    }
+    events.entered.push_back(entity.id);
+  }
+
+  for (; p < prev.entities.size(); ++p)
+    events.left.push_back(prev.entities[p].id);
+}
+
+} // namespace network
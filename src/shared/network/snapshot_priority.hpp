@@ -0,0 +1,76 @@
+#pragma once
+
+#include "network_types.hpp"
+#include "packet.hpp"
+#include <algorithm>
+#include <vector>
+
+// Per-client bandwidth control for snapshots.
+//
+// Each client gets a byte budget per tick from its rate (a token bucket,
+// capped at what fits in one datagram). When a snapshot's pending entity
+// updates do not fit, the Snapshot_Builder sends the ones with the highest
+// accumulated priority and defers the rest; a deferred update keeps gaining
+// priority every tick until it is sent, so nothing starves.
+
+namespace network
+{
+
+// Room for the S2C_EntityPackage fields around entity_data, so a budgeted
+// snapshot never needs a second fragment.
+constexpr size_t snapshot_envelope_bytes = 32;
+constexpr size_t max_snapshot_data_bytes =
+    MAX_PAYLOAD_SIZE_IN_BYTES - snapshot_envelope_bytes;
+
+// One client's priority per entity (by id.index). An entity's priority grows
+// by its rate every tick an update for it is pending and resets once sent.
+class Priority_Accumulator
+{
+public:
+  float get(uint32 entity_index) const
+  {
+    return entity_index < priorities.size() ? priorities[entity_index] : 0.0f;
+  }
+
+  void set(uint32 entity_index, float priority)
+  {
+    if (entity_index >= priorities.size())
+    {
+      if (priority == 0.0f)
+        return;
+      priorities.resize(entity_index + 1, 0.0f);
+    }
+    priorities[entity_index] = priority;
+  }
+
+  void clear() { priorities.clear(); }
+
+private:
+  std::vector<float> priorities;
+};
+
+// Token bucket for one client's snapshot bytes.
+class Bandwidth_Budget
+{
+public:
+  // Adds one tick's worth of `bytes_per_second` and returns how many bytes
+  // this tick's snapshot may use, at most `max_bytes`. Savings are capped at
+  // `max_bytes` too, so an idle client cannot build up a burst.
+  size_t begin_tick(float bytes_per_second, float tickrate, size_t max_bytes)
+  {
+    available += bytes_per_second / std::max(tickrate, 1.0f);
+    available = std::min(available, static_cast<float>(max_bytes));
+    return available > 0.0f ? static_cast<size_t>(available) : 0;
+  }
+
+  // Records what was actually sent. Going over (records that must be sent
+  // regardless, see Snapshot_Builder) is paid back over the next ticks.
+  void spend(size_t bytes) { available -= static_cast<float>(bytes); }
+
+  void reset() { available = 0.0f; }
+
+private:
+  float available = 0.0f;
+};
+
+} // namespace network
@@ -1,4 +1,6 @@
 #include "udp_socket.hpp"
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <string>
 
@@ -17,6 +19,7 @@
     #include <arpa/inet.h>
     #include <fcntl.h>
     #include <netinet/in.h>
+    #include <poll.h>
     #include <sys/socket.h>
     #include <unistd.h>
     
@@ -25,6 +28,21 @@
     #define SOCKET_ERROR -1
 #endif
 
+#if defined(__linux__)
+    #include <netinet/udp.h>
+    #include <sys/uio.h>
+    #define HAS_MMSG 1
+    // Older libc headers may not carry the GSO constants yet.
+    #ifndef SOL_UDP
+        #define SOL_UDP 17
+    #endif
+    #ifndef UDP_SEGMENT
+        #define UDP_SEGMENT 103
+    #endif
+#else
+    #define HAS_MMSG 0
+#endif
+
 namespace network
 {
 
@@ -60,6 +78,47 @@ std::string Address::to_string() const
     return std::string(buffer);
 }
 
+// --- Helpers ---
+
+namespace
+{
+
+// A full fragment from convert_to_packets is exactly one Packet on the wire,
+// which is what lets us hand a span of packets to the kernel as one GSO
+// buffer without copying.
+static_assert(sizeof(Packet) == MAX_PACKET_SIZE_IN_BYTES,
+              "Packet must have no trailing padding for batched sends");
+
+constexpr size_t packet_header_wire_size = sizeof(Packet_Header) + sizeof(int);
+
+size_t packet_wire_size(const Packet &packet)
+{
+    size_t send_size = packet_header_wire_size + packet.header.payload_size;
+    return std::min(send_size, sizeof(Packet));
+}
+
+sockaddr_in to_sockaddr(const Address &address)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(address.ip_v4);
+    addr.sin_port = htons(address.port);
+    return addr;
+}
+
+Address from_sockaddr(const sockaddr_in &addr)
+{
+    return Address(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port));
+}
+
+#if HAS_MMSG
+// The kernel caps a single GSO send at 64 segments and 64 KB.
+constexpr size_t max_gso_segments =
+    std::min<size_t>(64, 65000 / MAX_PACKET_SIZE_IN_BYTES);
+#endif
+
+} // namespace
+
 // --- Udp_Socket Implementation ---
 
 Udp_Socket::Udp_Socket() : m_socket_handle(INVALID_SOCKET) {}
@@ -105,6 +164,14 @@ bool Udp_Socket::open(uint16 port)
     }
 #endif
 
+#if HAS_MMSG
+    // Probe for UDP GSO support (Linux 4.18+).
+    int gso_size = 0;
+    socklen_t gso_len = sizeof(gso_size);
+    m_gso_supported =
+        getsockopt(m_socket_handle, SOL_UDP, UDP_SEGMENT, &gso_size, &gso_len) == 0;
+#endif
+
     return true;
 }
 
@@ -119,6 +186,7 @@ void Udp_Socket::close()
 #endif
         m_socket_handle = INVALID_SOCKET;
     }
+    m_gso_supported = false;
 }
 
 bool Udp_Socket::is_open() const { return m_socket_handle != INVALID_SOCKET; }
@@ -127,15 +195,8 @@ bool Udp_Socket::send(const Packet &packet, const Address &address)
 {
     if (m_socket_handle == INVALID_SOCKET) return false;
 
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = htonl(address.ip_v4);
-    addr.sin_port = htons(address.port);
-
-    size_t header_plus_padding = sizeof(Packet_Header) + sizeof(int);
-    size_t send_size = header_plus_padding + packet.header.payload_size;
-
-    if (send_size > sizeof(Packet)) send_size = sizeof(Packet);
+    sockaddr_in addr = to_sockaddr(address);
+    size_t send_size = packet_wire_size(packet);
 
     int sent_bytes = sendto(m_socket_handle, (const char *)&packet, static_cast<int>(send_size), 0,
                             (struct sockaddr *)&addr, sizeof(addr));
@@ -155,8 +216,7 @@ bool Udp_Socket::receive(Packet &packet, Address &sender)
 
     if (bytes_received <= 0) return false;
 
-    sender.ip_v4 = ntohl(from.sin_addr.s_addr);
-    sender.port = ntohs(from.sin_port);
+    sender = from_sockaddr(from);
 
     if (static_cast<size_t>(bytes_received) < sizeof(Packet_Header))
         return false; 
@@ -164,4 +224,238 @@ bool Udp_Socket::receive(Packet &packet, Address &sender)
     return true;
 }
 
+bool Udp_Socket::wait_readable(double timeout_seconds)
+{
+    if (m_socket_handle == INVALID_SOCKET) return false;
+
+    if (timeout_seconds < 0.0) timeout_seconds = 0.0;
+
+#ifdef _WIN32
+    int timeout_ms = static_cast<int>(timeout_seconds * 1000.0);
+    WSAPOLLFD pfd = {};
+    pfd.fd = m_socket_handle;
+    pfd.events = POLLRDNORM;
+    int result = WSAPoll(&pfd, 1, timeout_ms);
+#else
+    pollfd pfd = {};
+    pfd.fd = m_socket_handle;
+    pfd.events = POLLIN;
+#if defined(__linux__)
+    // ppoll takes a timespec, so sub-millisecond timeouts actually wait.
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout_seconds);
+    ts.tv_nsec = static_cast<long>((timeout_seconds - double(ts.tv_sec)) * 1e9);
+    int result = ppoll(&pfd, 1, &ts, nullptr);
+#else
+    int timeout_ms = static_cast<int>(timeout_seconds * 1000.0);
+    int result = poll(&pfd, 1, timeout_ms);
+#endif
+#endif
+
+    return result > 0;
+}
+
+size_t Udp_Socket::receive_batch(std::span<Packet> packets, std::span<Address> senders)
+{
+    if (m_socket_handle == INVALID_SOCKET) return 0;
+
+    size_t capacity = std::min(packets.size(), senders.size());
+
+#if HAS_MMSG
+    size_t valid = 0;
+    while (valid < capacity)
+    {
+        size_t batch = std::min(capacity - valid, max_datagram_batch);
+
+        mmsghdr msgs[max_datagram_batch] = {};
+        iovec iovs[max_datagram_batch];
+        sockaddr_in froms[max_datagram_batch];
+
+        for (size_t i = 0; i < batch; ++i)
+        {
+            iovs[i].iov_base = &packets[valid + i];
+            iovs[i].iov_len = sizeof(Packet);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &froms[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+
+        int received = recvmmsg(m_socket_handle, msgs, static_cast<unsigned int>(batch),
+                                MSG_DONTWAIT, nullptr);
+        if (received <= 0) break;
+
+        // Compact: drop runt datagrams, keep the rest at the front.
+        size_t write_idx = valid;
+        for (int i = 0; i < received; ++i)
+        {
+            if (msgs[i].msg_len < sizeof(Packet_Header)) continue;
+            if (write_idx != valid + i) packets[write_idx] = packets[valid + i];
+            senders[write_idx] = from_sockaddr(froms[i]);
+            ++write_idx;
+        }
+        valid = write_idx;
+
+        // The socket queue is drained.
+        if (static_cast<size_t>(received) < batch) break;
+    }
+    return valid;
+#else
+    size_t valid = 0;
+    while (valid < capacity && receive(packets[valid], senders[valid]))
+    {
+        ++valid;
+    }
+    return valid;
+#endif
+}
+
+size_t Udp_Socket::send_batch(std::span<const Packet> packets,
+                              std::span<const Address> addresses)
+{
+    if (m_socket_handle == INVALID_SOCKET) return 0;
+
+    size_t count = std::min(packets.size(), addresses.size());
+
+#if HAS_MMSG
+    size_t sent_total = 0;
+    while (sent_total < count)
+    {
+        size_t batch = std::min(count - sent_total, max_datagram_batch);
+
+        mmsghdr msgs[max_datagram_batch] = {};
+        iovec iovs[max_datagram_batch];
+        sockaddr_in tos[max_datagram_batch];
+
+        for (size_t i = 0; i < batch; ++i)
+        {
+            const Packet &packet = packets[sent_total + i];
+            tos[i] = to_sockaddr(addresses[sent_total + i]);
+            iovs[i].iov_base = const_cast<Packet *>(&packet);
+            iovs[i].iov_len = packet_wire_size(packet);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &tos[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+
+        int sent = sendmmsg(m_socket_handle, msgs, static_cast<unsigned int>(batch), 0);
+        if (sent <= 0) break;
+        sent_total += sent;
+        if (static_cast<size_t>(sent) < batch) break;
+    }
+    return sent_total;
+#else
+    size_t sent_total = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (send(packets[i], addresses[i])) ++sent_total;
+    }
+    return sent_total;
+#endif
+}
+
+size_t Udp_Socket::send_batch(std::span<const Packet> packets, const Address &address)
+{
+    if (m_socket_handle == INVALID_SOCKET) return 0;
+
+    if (gso_enabled() && packets.size() > 1)
+    {
+        return send_gso(packets, address);
+    }
+
+#if HAS_MMSG
+    Address addresses[max_datagram_batch];
+    std::fill(std::begin(addresses), std::end(addresses), address);
+
+    size_t sent_total = 0;
+    while (sent_total < packets.size())
+    {
+        size_t batch = std::min(packets.size() - sent_total, max_datagram_batch);
+        size_t sent = send_batch(packets.subspan(sent_total, batch),
+                                 std::span<const Address>(addresses, batch));
+        sent_total += sent;
+        if (sent < batch) break;
+    }
+    return sent_total;
+#else
+    size_t sent_total = 0;
+    for (const auto &packet : packets)
+    {
+        if (send(packet, address)) ++sent_total;
+    }
+    return sent_total;
+#endif
+}
+
+size_t Udp_Socket::send_gso(std::span<const Packet> packets, const Address &address)
+{
+#if HAS_MMSG
+    sockaddr_in to = to_sockaddr(address);
+    size_t sent_total = 0;
+
+    while (sent_total < packets.size())
+    {
+        // A GSO send is a run of full-size segments, optionally followed by
+        // one shorter segment. Collect the longest such run.
+        size_t run = 0;
+        size_t limit = std::min(packets.size() - sent_total, max_gso_segments);
+        while (run < limit)
+        {
+            bool is_full = packet_wire_size(packets[sent_total + run]) == sizeof(Packet);
+            ++run;
+            if (!is_full) break;
+        }
+
+        if (run == 1)
+        {
+            if (!send(packets[sent_total], address)) break;
+            ++sent_total;
+            continue;
+        }
+
+        const Packet &last = packets[sent_total + run - 1];
+        iovec iov;
+        iov.iov_base = const_cast<Packet *>(&packets[sent_total]);
+        iov.iov_len = (run - 1) * sizeof(Packet) + packet_wire_size(last);
+
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+        msghdr msg = {};
+        msg.msg_name = &to;
+        msg.msg_namelen = sizeof(to);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t segment_size = static_cast<uint16_t>(sizeof(Packet));
+        std::memcpy(CMSG_DATA(cm), &segment_size, sizeof(segment_size));
+
+        ssize_t sent = sendmsg(m_socket_handle, &msg, 0);
+        if (sent < 0)
+        {
+            if (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)
+            {
+                // No GSO on this path (e.g. no checksum offload); fall back
+                // to sendmmsg for this socket from now on.
+                m_gso_supported = false;
+                return sent_total + send_batch(packets.subspan(sent_total), address);
+            }
+            break;
+        }
+        sent_total += run;
+    }
+    return sent_total;
+#else
+    // gso_enabled() is never true without HAS_MMSG.
+    (void)packets;
+    (void)address;
+    return 0;
+#endif
+}
+
 } // namespace network
\ No newline at end of file
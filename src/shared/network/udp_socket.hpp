@@ -1,6 +1,7 @@
 #pragma once
 
 #include "packet.hpp"
+#include <span>
 #include <string>
 
 namespace network
@@ -50,8 +51,46 @@ public:
   // by default).
   bool receive(Packet &packet, Address &sender);
 
+  // Blocks until a datagram is pending or the timeout expires. Returns true
+  // if the socket is readable. Uses ppoll() on Linux (sub-millisecond
+  // timeouts), poll() / WSAPoll() with millisecond resolution elsewhere.
+  bool wait_readable(double timeout_seconds);
+
+  // --- Batched I/O ---
+  // On Linux these map to recvmmsg / sendmmsg (one syscall per batch of up to
+  // max_datagram_batch datagrams). Elsewhere they fall back to looping over
+  // send / receive.
+
+  // Receives up to min(packets.size(), senders.size()) packets. Returns the
+  // number of valid packets written to the front of both spans (0 if nothing
+  // was pending). Never blocks.
+  size_t receive_batch(std::span<Packet> packets, std::span<Address> senders);
+
+  // Sends packets[i] to addresses[i]. Returns the number of packets sent.
+  size_t send_batch(std::span<const Packet> packets,
+                    std::span<const Address> addresses);
+
+  // Sends all packets to one destination, e.g. the fragments produced by
+  // convert_to_packets. When UDP GSO is available every run of full-size
+  // fragments goes out in a single sendmsg, and the kernel splits it into
+  // datagrams. Returns the number of packets sent.
+  size_t send_batch(std::span<const Packet> packets, const Address &address);
+
+  // UDP generic segmentation offload (Linux UDP_SEGMENT). Probed in open();
+  // can be switched off, and is switched off automatically if the kernel
+  // refuses a segmented send.
+  bool gso_supported() const { return m_gso_supported; }
+  bool gso_enabled() const { return m_gso_supported && m_gso_enabled; }
+  void set_gso_enabled(bool enabled) { m_gso_enabled = enabled; }
+
+  static constexpr size_t max_datagram_batch = 64;
+
 private:
+  size_t send_gso(std::span<const Packet> packets, const Address &address);
+
   int m_socket_handle;
+  bool m_gso_supported = false;
+  bool m_gso_enabled = true;
 };
 
 } // namespace network
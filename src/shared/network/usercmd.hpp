@@ -0,0 +1,248 @@
+#pragma once
+
+#include "quantization.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// Player input (usercmds), client to server.
+//
+// A usercmd is what the player did during one client frame, already in its
+// wire precision: view angles as 16-bit fractions of a turn, move axes as
+// signed bytes and buttons as a bitfield. The client keeps its last few
+// commands and sends them all in every datagram, each delta encoded against
+// the one before it, so a lost datagram costs nothing as long as one of the
+// next few arrives. The server decodes them into a per-player Usercmd_Ring
+// and executes them in order.
+
+namespace network
+{
+
+enum Usercmd_Button : uint16
+{
+  Button_Jump = 1 << 0,
+  Button_Crouch = 1 << 1,
+  Button_Attack = 1 << 2,
+  Button_Attack2 = 1 << 3,
+  Button_Use = 1 << 4,
+  Button_Reload = 1 << 5,
+};
+
+struct usercmd_t
+{
+  uint32 command_number = 0; // assigned by Usercmd_Buffer, from 1
+  uint32 tick = 0;           // client tick the command was sampled at
+  uint16 pitch = 0;          // 65536 steps per turn, see angle_to_degrees()
+  uint16 yaw = 0;
+  int8 forward_move = 0; // -127 .. 127 (full speed backward .. forward)
+  int8 side_move = 0;    // -127 .. 127 (left .. right)
+  int8 up_move = 0;
+  uint16 buttons = 0; // Usercmd_Button bits
+};
+
+inline uint16 degrees_to_angle(float degrees)
+{
+  return static_cast<uint16>(encode_angle(degrees, 16));
+}
+
+// In (-180, 180].
+inline float angle_to_degrees(uint16 angle) { return decode_angle(angle, 16); }
+
+// `value` in [-1, 1].
+inline int8 quantize_move(float value)
+{
+  return static_cast<int8>(
+      std::lround(std::fmax(-1.0f, std::fmin(value, 1.0f)) * 127.0f));
+}
+
+inline float move_to_float(int8 move) { return move / 127.0f; }
+
+// Most commands one datagram carries (Usercmd_Buffer::write redundancy).
+constexpr size_t max_usercmds_per_packet = 8;
+
+namespace usercmd_detail
+{
+
+// One command against the previous one in the same datagram (or against a
+// zeroed command for the first). An unchanged command costs 7 bits.
+inline void write_usercmd(Bit_Writer &w, const usercmd_t &cmd,
+                          const usercmd_t &previous)
+{
+  uint32 tick_delta = cmd.tick - previous.tick;
+  w.write_bit(tick_delta == 1);
+  if (tick_delta != 1)
+    write_var_uint(w, tick_delta);
+
+  auto field = [&](uint32 value, uint32 previous_value, int bits)
+  {
+    w.write_bit(value != previous_value);
+    if (value != previous_value)
+      w.write_bits(value, bits);
+  };
+  field(cmd.pitch, previous.pitch, 16);
+  field(cmd.yaw, previous.yaw, 16);
+  field(static_cast<uint8>(cmd.forward_move),
+        static_cast<uint8>(previous.forward_move), 8);
+  field(static_cast<uint8>(cmd.side_move),
+        static_cast<uint8>(previous.side_move), 8);
+  field(static_cast<uint8>(cmd.up_move), static_cast<uint8>(previous.up_move),
+        8);
+  field(cmd.buttons, previous.buttons, 16);
+}
+
+inline void read_usercmd(Bit_Reader &r, usercmd_t &cmd)
+{
+  // `cmd` holds the previous command on entry.
+  cmd.tick += r.read_bit() ? 1 : read_var_uint(r);
+  if (r.read_bit())
+    cmd.pitch = static_cast<uint16>(r.read_bits(16));
+  if (r.read_bit())
+    cmd.yaw = static_cast<uint16>(r.read_bits(16));
+  if (r.read_bit())
+    cmd.forward_move = static_cast<int8>(r.read_bits(8));
+  if (r.read_bit())
+    cmd.side_move = static_cast<int8>(r.read_bits(8));
+  if (r.read_bit())
+    cmd.up_move = static_cast<int8>(r.read_bits(8));
+  if (r.read_bit())
+    cmd.buttons = static_cast<uint16>(r.read_bits(16));
+}
+
+} // namespace usercmd_detail
+
+// The client's most recent commands.
+class Usercmd_Buffer
+{
+public:
+  // Numbers `cmd` and keeps it; returns the stored command.
+  const usercmd_t &push(usercmd_t cmd)
+  {
+    cmd.command_number = ++newest_number;
+    commands[newest_number % max_usercmds_per_packet] = cmd;
+    return commands[newest_number % max_usercmds_per_packet];
+  }
+
+  // Writes the newest `redundancy` commands (at most as many as exist),
+  // oldest first.
+  void write(Bit_Writer &w,
+             size_t redundancy = max_usercmds_per_packet / 2) const
+  {
+    size_t count = std::min<size_t>({redundancy, max_usercmds_per_packet,
+                                     newest_number});
+    write_var_uint(w, newest_number);
+    w.write_bits(static_cast<uint32>(count), 4);
+    usercmd_t previous;
+    for (uint32 n = newest_number - uint32(count) + 1; n <= newest_number; ++n)
+    {
+      const usercmd_t &cmd = commands[n % max_usercmds_per_packet];
+      usercmd_detail::write_usercmd(w, cmd, previous);
+      previous = cmd;
+    }
+  }
+
+  uint32 newest() const { return newest_number; }
+
+  void clear() { newest_number = 0; }
+
+private:
+  std::array<usercmd_t, max_usercmds_per_packet> commands{};
+  uint32 newest_number = 0;
+};
+
+// One player's received commands on the server, executed in order. Gaps
+// (every copy of a command lost) are skipped once a later command is in.
+class Usercmd_Ring
+{
+public:
+  static constexpr size_t capacity = 64;
+
+  struct stats_t
+  {
+    uint64 received = 0;   // distinct commands stored
+    uint64 redundant = 0;  // copies of commands already stored or executed
+    uint64 lost = 0;       // commands skipped because no copy arrived
+  };
+
+  // Decodes one datagram written by Usercmd_Buffer::write(). Returns false
+  // if it is malformed; commands before the damage are kept.
+  bool read(Bit_Reader &r)
+  {
+    uint32 newest = read_var_uint(r);
+    uint32 count = r.read_bits(4);
+    if (count == 0 || count > max_usercmds_per_packet || count > newest ||
+        r.bits_remaining() == 0)
+      return false;
+
+    usercmd_t cmd;
+    for (uint32 n = newest - count + 1; n <= newest; ++n)
+    {
+      usercmd_detail::read_usercmd(r, cmd);
+      if (r.bit_index > r.size * 8)
+        return false; // truncated
+      cmd.command_number = n;
+      store(cmd);
+    }
+    return true;
+  }
+
+  // Keeps `cmd` unless it was executed, is already stored, or is too far
+  // behind the newest stored command.
+  void store(const usercmd_t &cmd)
+  {
+    uint32 number = cmd.command_number;
+    usercmd_t &slot = commands[number % capacity];
+    if (number <= executed_number || slot.command_number == number ||
+        number + capacity <= newest_number)
+    {
+      ring_stats.redundant += 1;
+      return;
+    }
+    slot = cmd;
+    newest_number = std::max(newest_number, number);
+    ring_stats.received += 1;
+  }
+
+  // The next command to execute, or nullptr if none arrived yet.
+  const usercmd_t *next()
+  {
+    // Nothing stored means no later command to skip a gap for either.
+    if (newest_number <= executed_number)
+      return nullptr;
+
+    // Every command between here and the newest one was received or lost
+    // for good; the redundant copies in later datagrams would have had it.
+    if (newest_number - executed_number > capacity)
+    {
+      ring_stats.lost += newest_number - executed_number - capacity;
+      executed_number = newest_number - capacity;
+    }
+    while (commands[(executed_number + 1) % capacity].command_number !=
+           executed_number + 1)
+    {
+      executed_number += 1;
+      ring_stats.lost += 1;
+    }
+    executed_number += 1;
+    return &commands[executed_number % capacity];
+  }
+
+  uint32 newest() const { return newest_number; }
+  uint32 executed() const { return executed_number; }
+  const stats_t &stats() const { return ring_stats; }
+
+  void clear()
+  {
+    commands.fill({});
+    newest_number = 0;
+    executed_number = 0;
+    ring_stats = {};
+  }
+
+private:
+  std::array<usercmd_t, capacity> commands{};
+  uint32 newest_number = 0;
+  uint32 executed_number = 0;
+  stats_t ring_stats;
+};
+
+} // namespace network
@@ -1,28 +1,31 @@
 #include "task_system.hpp"
 #include "log.hpp" // For logging if needed
+#include <chrono>
 #include <thread>
 
 Task_System::Task_System() {}
 
 Task_System::~Task_System() { shutdown(); }
 
-void Task_System::initialize() {
+void Task_System::initialize(size_t worker_count) {
   if (running_)
     return;
   running_ = true;
 
-  unsigned int core_count = std::thread::hardware_concurrency();
+  size_t core_count = worker_count;
+  if (core_count == 0)
+    core_count = std::thread::hardware_concurrency();
   if (core_count == 0)
     core_count = 4; // Fallback
 
   // Create one queue per worker
   workers_.reserve(core_count);
   queues_.reserve(core_count);
-  for (unsigned int i = 0; i < core_count; ++i) {
+  for (size_t i = 0; i < core_count; ++i) {
     queues_.push_back(std::make_unique<Queue_Type>());
   }
 
-  for (unsigned int i = 0; i < core_count; ++i) {
+  for (size_t i = 0; i < core_count; ++i) {
     workers_.emplace_back([this, i]() { worker_thread_func(i); });
   }
 
@@ -63,34 +66,62 @@ void Task_System::submit(std::function<void()> task) {
   }
 }
 
-void Task_System::worker_thread_func(size_t thread_index) {
-  size_t num_queues = queues_.size();
-  while (running_) {
-    std::function<void()> task;
+void Task_System::parallel_for(size_t job_count,
+                               const std::function<void(size_t)> &job) {
+  if (!running_ || queues_.empty()) {
+    for (size_t i = 0; i < job_count; ++i)
+      job(i);
+    return;
+  }
+
+  std::atomic<size_t> remaining{job_count};
+  for (size_t i = 0; i < job_count; ++i) {
+    submit([&job, &remaining, i]() {
+      job(i);
+      remaining.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  // Help out instead of idling; this also keeps a single-worker system from
+  // serializing behind the caller.
+  size_t first_queue = 0;
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    if (!try_run_one(first_queue++ % queues_.size()))
+      std::this_thread::yield();
+  }
+}
 
-    // 1. Try local queue
-    if (queues_[thread_index]->pop(task)) {
+bool Task_System::try_run_one(size_t first_queue) {
+  size_t num_queues = queues_.size();
+  std::function<void()> task;
+  for (size_t i = 0; i < num_queues; ++i) {
+    // Calculate victim index: (first_queue + i) % num_queues
+    size_t victim = (first_queue + i) % num_queues;
+    if (queues_[victim]->pop(task)) {
       task();
-      continue;
+      return true;
     }
+  }
+  return false;
+}
 
-    // 2. Steal from others
-    // Start from (index + 1) to spread contention?
-    // Random victim is also popular. Let's do deterministic offset to avoid RNG
-    // overhead for now. We will loop through all other queues.
-    bool stole = false;
-    for (size_t i = 1; i < num_queues; ++i) {
-      // Calculate victim index: (thread_index + i) % num_queues
-      size_t victim = (thread_index + i) % num_queues;
-      if (queues_[victim]->pop(task)) {
-        task();
-        stole = true;
-        break;
-      }
-    }
+void Task_System::worker_thread_func(size_t thread_index) {
+  // After this many empty polls in a row a worker starts sleeping between
+  // polls, so an idle system (e.g. a server between ticks) does not keep
+  // every core busy. parallel_for callers help out, which hides the wake-up
+  // latency.
+  constexpr size_t SPINS_BEFORE_SLEEP = 4096;
+  size_t idle_spins = 0;
 
-    if (!stole) {
+  while (running_) {
+    // Try the local queue first, then steal from the others. Deterministic
+    // victim order (thread_index + 1, ...) to avoid RNG overhead for now.
+    if (try_run_one(thread_index)) {
+      idle_spins = 0;
+    } else if (++idle_spins < SPINS_BEFORE_SLEEP) {
       std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
     }
   }
 }
@@ -100,13 +100,22 @@ public:
   Task_System();
   ~Task_System();
 
-  void initialize();
+  // Starts `worker_count` workers, or one per hardware thread if 0.
+  void initialize(size_t worker_count = 0);
   void shutdown();
 
+  size_t worker_count() const { return workers_.size(); }
+
   void submit(std::function<void()> task);
 
+  // Runs job(0) .. job(job_count - 1) on the workers and blocks until all of
+  // them finished. The calling thread runs queued tasks while it waits. Runs
+  // inline if the system is not initialized.
+  void parallel_for(size_t job_count, const std::function<void(size_t)> &job);
+
 private:
   void worker_thread_func(size_t thread_index);
+  bool try_run_one(size_t first_queue);
 
   static constexpr size_t QUEUE_SIZE = 32; // Must be power of 2
 
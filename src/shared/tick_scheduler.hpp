@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+namespace shared
+{
+
+// Jitter statistics for a fixed-timestep loop. "Lateness" is how far after
+// its deadline a tick actually started.
+struct tick_stats_t
+{
+  uint64_t ticks = 0;
+  uint64_t late_ticks = 0;    // started more than late_threshold after deadline
+  uint64_t skipped_ticks = 0; // dropped when the loop fell too far behind
+  double mean_lateness_us = 0.0;
+  double max_lateness_us = 0.0;
+  double m2_lateness = 0.0; // Welford accumulator, see stddev_lateness_us()
+
+  double stddev_lateness_us() const
+  {
+    return ticks > 1 ? std::sqrt(m2_lateness / double(ticks - 1)) : 0.0;
+  }
+
+  void record(double lateness_us, double late_threshold_us)
+  {
+    ticks += 1;
+    double delta = lateness_us - mean_lateness_us;
+    mean_lateness_us += delta / double(ticks);
+    m2_lateness += delta * (lateness_us - mean_lateness_us);
+    max_lateness_us = std::max(max_lateness_us, lateness_us);
+    if (lateness_us > late_threshold_us)
+      late_ticks += 1;
+  }
+};
+
+// Fixed-timestep scheduler.
+//
+// Deadlines are absolute (start + n * period), so time spent inside a tick
+// does not push later ticks back and the rate does not drift. Waiting is
+// hybrid: the bulk of the interval is handed to a caller-provided wait
+// function (e.g. blocking on the socket with a timeout, so packets are
+// handled as they arrive instead of busy-polling), the last sub-millisecond
+// is spun out with yields because OS timers are not precise enough for it.
+class Tick_Scheduler
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  // Below this much remaining time we stop blocking and spin.
+  std::chrono::microseconds spin_threshold{1000};
+  // Lateness above this counts as a late tick in the stats.
+  std::chrono::microseconds late_threshold{1000};
+  // If we fall more than this many ticks behind, skip ahead instead of
+  // running a burst of catch-up ticks.
+  int max_catch_up_ticks = 5;
+
+  explicit Tick_Scheduler(double tickrate_hz = 60.0)
+  {
+    set_tickrate(tickrate_hz);
+  }
+
+  void set_tickrate(double tickrate_hz)
+  {
+    tickrate_hz = std::clamp(tickrate_hz, 1.0, 1000.0);
+    if (tickrate_hz == current_tickrate)
+      return;
+    current_tickrate = tickrate_hz;
+    period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / tickrate_hz));
+    // Re-anchor so a rate change does not produce a burst of ticks.
+    if (started)
+      next_deadline = clock::now() + period;
+  }
+
+  double tickrate() const { return current_tickrate; }
+  clock::duration tick_period() const { return period; }
+  clock::time_point deadline() const { return next_deadline; }
+
+  // Starts the schedule; the first tick is due immediately.
+  void start()
+  {
+    started = true;
+    next_deadline = clock::now();
+  }
+
+  // Blocks until the next tick is due. `wait_for_io(timeout_seconds)` is
+  // called for the coarse part of the wait and may return early (e.g. when
+  // the socket became readable); it is simply called again with the
+  // remaining time.
+  template <typename Wait_Fn> void wait_for_next_tick(Wait_Fn &&wait_for_io)
+  {
+    if (!started)
+      start();
+
+    while (true)
+    {
+      auto now = clock::now();
+      if (now >= next_deadline)
+        break;
+
+      auto remaining = next_deadline - now;
+      if (remaining > spin_threshold)
+      {
+        auto coarse = remaining - spin_threshold;
+        wait_for_io(std::chrono::duration<double>(coarse).count());
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+
+    begin_tick(clock::now());
+  }
+
+  // Non-blocking variant for loops that are paced by something else (the
+  // integrated client/server loop): returns true and advances the schedule
+  // if a tick is due.
+  bool consume_due_tick()
+  {
+    if (!started)
+      start();
+
+    auto now = clock::now();
+    if (now < next_deadline)
+      return false;
+
+    begin_tick(now);
+    return true;
+  }
+
+  const tick_stats_t &stats() const { return tick_stats; }
+  void reset_stats() { tick_stats = {}; }
+
+private:
+  void begin_tick(clock::time_point now)
+  {
+    double lateness_us =
+        std::chrono::duration<double, std::micro>(now - next_deadline).count();
+    tick_stats.record(
+        lateness_us,
+        std::chrono::duration<double, std::micro>(late_threshold).count());
+
+    next_deadline += period;
+
+    // Drift compensation: stay on the absolute schedule, unless we are so
+    // far behind that catching up would mean a burst of back-to-back ticks.
+    if (now - next_deadline > period * max_catch_up_ticks)
+    {
+      auto behind = (now - next_deadline) / period;
+      tick_stats.skipped_ticks += static_cast<uint64_t>(behind);
+      next_deadline += period * behind;
+    }
+  }
+
+  double current_tickrate = 0.0;
+  clock::duration period{};
+  clock::time_point next_deadline{};
+  bool started = false;
+  tick_stats_t tick_stats;
+};
+
+} // namespace shared
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "entity.hpp"
+#include "shapes.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace shared
+{
+
+// Position and orientation of every live entity in parallel arrays, one
+// element per entity, so passes that only need transforms (bounds, culling)
+// walk two packed arrays instead of touching every entity of every pool.
+// Filled by Entity_System::sync_transforms(); ids[i] is the entity whose
+// transform is at i.
+struct Transform_Stream
+{
+  std::vector<network::Entity_Id> ids;
+  std::vector<linalg::vec3> positions;
+  std::vector<linalg::vec3> orientations;
+
+  size_t size() const { return ids.size(); }
+
+  void clear()
+  {
+    ids.clear();
+    positions.clear();
+    orientations.clear();
+  }
+};
+
+// Batch passes over spans of positions (for instance a Transform_Stream's,
+// or the packed copy in Relevancy_Index). They are plain loops over packed
+// floats, with no per-element calls.
+
+// The smallest box that holds every position; min > max if there are none.
+inline aabb_bounds_t enclosing_bounds(std::span<const linalg::vec3> positions)
+{
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  aabb_bounds_t bounds = {{inf, inf, inf}, {-inf, -inf, -inf}};
+  for (const linalg::vec3 &p : positions)
+  {
+    bounds.min.x = std::min(bounds.min.x, p.x);
+    bounds.min.y = std::min(bounds.min.y, p.y);
+    bounds.min.z = std::min(bounds.min.z, p.z);
+    bounds.max.x = std::max(bounds.max.x, p.x);
+    bounds.max.y = std::max(bounds.max.y, p.y);
+    bounds.max.z = std::max(bounds.max.z, p.z);
+  }
+  return bounds;
+}
+
+// Appends to `inside` the indices of the positions within `radius` of
+// `origin`, in ascending order.
+inline void cull_sphere(std::span<const linalg::vec3> positions,
+                        const linalg::vec3 &origin, float radius,
+                        std::vector<uint32_t> &inside)
+{
+  float radius_squared = radius * radius;
+  for (size_t i = 0; i < positions.size(); ++i)
+  {
+    float dx = positions[i].x - origin.x;
+    float dy = positions[i].y - origin.y;
+    float dz = positions[i].z - origin.z;
+    if (dx * dx + dy * dy + dz * dz <= radius_squared)
+      inside.push_back(static_cast<uint32_t>(i));
+  }
+}
+
+} // namespace shared
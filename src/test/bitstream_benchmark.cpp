@@ -0,0 +1,128 @@
+#include "../shared/entities/player_entity.hpp"
+#include "../shared/network/bitstream.hpp"
+#include "../shared/network/quantization.hpp"
+#include "../shared/rng.hpp"
+#include "reference_bit_writer.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Microbenchmark for the snapshot encoding hot path: how many bits per
+// nanosecond the Bit_Writer / Bit_Reader push for snapshot-sized payloads.
+
+using namespace network;
+using bench_clock = std::chrono::high_resolution_clock;
+
+struct Field_Write
+{
+  uint32_t value;
+  int bits;
+};
+
+template <typename Fn> double time_ns(int iterations, Fn &&fn)
+{
+  auto start = bench_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    fn();
+  auto end = bench_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+void report(const char *name, size_t bits, double ns)
+{
+  std::cout << "  " << name << ": " << bits << " bits in " << ns << " ns -> "
+            << (bits / ns) << " bits/ns" << std::endl;
+}
+
+int main()
+{
+  std::cout << "[BENCH] Bit_Writer / Bit_Reader" << std::endl;
+  constexpr int ITERATIONS = 2000;
+
+  // 1. A snapshot-sized stream of mixed field widths (~16 KB).
+  game::seed_rng(1337);
+  std::vector<Field_Write> writes;
+  size_t total_bits = 0;
+  while (total_bits < 16 * 1024 * 8)
+  {
+    static constexpr int widths[] = {1, 1, 3, 5, 8, 8, 12, 16, 32};
+    int bits = widths[game::random_uint64() % std::size(widths)];
+    writes.push_back({static_cast<uint32_t>(game::random_uint64()), bits});
+    total_bits += bits;
+  }
+
+  double ref_ns = time_ns(ITERATIONS,
+                          [&]
+                          {
+                            Reference_Bit_Writer w;
+                            for (const auto &f : writes)
+                              w.write_bits(f.value, f.bits);
+                            if (w.buffer.empty())
+                              std::abort();
+                          });
+  report("reference write_bits", total_bits, ref_ns);
+
+  std::vector<uint8> encoded;
+  double word_ns = time_ns(ITERATIONS,
+                           [&]
+                           {
+                             Bit_Writer w;
+                             w.reserve(total_bits / 8 + 8);
+                             for (const auto &f : writes)
+                               w.write_bits(f.value, f.bits);
+                             encoded = w.flush();
+                           });
+  report("Bit_Writer write_bits", total_bits, word_ns);
+  std::cout << "  speedup: " << (ref_ns / word_ns) << "x" << std::endl;
+
+  double read_ns = time_ns(ITERATIONS,
+                           [&]
+                           {
+                             Bit_Reader r(encoded.data(), encoded.size());
+                             uint32_t sink = 0;
+                             for (const auto &f : writes)
+                               sink ^= r.read_bits(f.bits);
+                             if (sink == 0xdeadbeef)
+                               std::abort();
+                           });
+  report("Bit_Reader read_bits", total_bits, read_ns);
+
+  // 2. Full entity updates: 64 players with render components (strings).
+  std::vector<Player_Entity> players(64);
+  for (size_t i = 0; i < players.size(); ++i)
+  {
+    auto &p = players[i];
+    p.position = {float(i) * 3.5f, 12.25f, -float(i)};
+    p.view_angle_yaw = float(i * 7 % 360);
+    p.health = 100 - int(i);
+    p.client_slot_index = int(i % sv_max_player_count);
+    p.render.mesh_id = int(i % 4);
+    p.render.mesh_path.set("assets/meshes/player_model.obj");
+  }
+
+  size_t entity_bits = 0;
+  double entity_ns = time_ns(ITERATIONS,
+                             [&]
+                             {
+                               Bit_Writer w;
+                               for (const auto &p : players)
+                                 p.serialize(w, nullptr);
+                               entity_bits = w.bits_written();
+                               encoded = w.flush();
+                             });
+  report("Entity::serialize x64 (full)", entity_bits, entity_ns);
+
+  double decode_ns = time_ns(ITERATIONS,
+                             [&]
+                             {
+                               Bit_Reader r(encoded.data(), encoded.size());
+                               Player_Entity p;
+                               for (size_t i = 0; i < players.size(); ++i)
+                                 p.deserialize(r);
+                             });
+  report("Entity::deserialize x64 (full)", entity_bits, decode_ns);
+
+  std::cout << "[BENCH] Done." << std::endl;
+  return 0;
+}
@@ -0,0 +1,132 @@
+#include "../shared/entities/player_entity.hpp"
+#include "../shared/entities/static_entities.hpp"
+#include "../shared/entities/weapon_entity.hpp"
+#include "../shared/rng.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Microbenchmark for finding an entity's changed fields against its baseline
+// copy: one memcmp per schema field against the Diff_Layout lane kernel, on
+// snapshot-style flat state copies of each class, and which of the two the
+// class's own layout picked.
+
+using namespace network;
+using bench_clock = std::chrono::high_resolution_clock;
+
+constexpr size_t ENTITIES = 4096;
+constexpr int ITERATIONS = 200;
+
+Field_Mask reference_changed_fields(const Class_Schema *schema,
+                                    const uint8 *a, const uint8 *b)
+{
+  Field_Mask mask = 0;
+  for (const auto &field : schema->fields)
+  {
+    if (std::memcmp(a + field.offset, b + field.offset, field.size) != 0)
+      mask |= Field_Mask(1) << field.index;
+  }
+  return mask;
+}
+
+template <typename Fn> double time_ns(Fn &&fn)
+{
+  auto start = bench_clock::now();
+  for (int i = 0; i < ITERATIONS; ++i)
+    fn();
+  auto end = bench_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         (double(ITERATIONS) * ENTITIES);
+}
+
+// `changed_percent` of the entities get one random byte of one random field
+// flipped, the rest are identical to their baseline.
+void bench_class(const char *name, const Entity &prototype,
+                 int changed_percent)
+{
+  const Class_Schema *schema = prototype.get_schema();
+  size_t size = schema->state_size;
+  std::vector<uint8> current(ENTITIES * size);
+  for (size_t i = 0; i < ENTITIES; ++i)
+    std::memcpy(&current[i * size],
+                reinterpret_cast<const uint8 *>(&prototype), size);
+  std::vector<uint8> baseline = current;
+
+  for (size_t i = 0; i < ENTITIES; ++i)
+  {
+    if (int(game::random_uint64() % 100) >= changed_percent)
+      continue;
+    const Field_Prop &field =
+        schema->fields[game::random_uint64() % schema->fields.size()];
+    current[i * size + field.offset + game::random_uint64() % field.size] ^=
+        0x5A;
+  }
+
+  uint64 reference_sum = 0;
+  double reference_ns = time_ns(
+      [&]
+      {
+        for (size_t i = 0; i < ENTITIES; ++i)
+          reference_sum += reference_changed_fields(
+              schema, &current[i * size], &baseline[i * size]);
+      });
+
+  Diff_Layout lanes;
+  lanes.build(schema->fields, size, Diff_Strategy::Lanes);
+  uint64 kernel_sum = 0;
+  double kernel_ns = time_ns(
+      [&]
+      {
+        for (size_t i = 0; i < ENTITIES; ++i)
+          kernel_sum +=
+              lanes.changed_fields(&current[i * size], &baseline[i * size]);
+      });
+
+  for (size_t i = 0; i < ENTITIES; ++i)
+  {
+    if (reference_changed_fields(schema, &current[i * size],
+                                 &baseline[i * size]) !=
+        lanes.changed_fields(&current[i * size], &baseline[i * size]))
+    {
+      std::cout << "  mismatch for " << name << " entity " << i << std::endl;
+      std::abort();
+    }
+  }
+  if (reference_sum != kernel_sum)
+    std::abort();
+
+  std::cout << "  " << name << " (" << schema->fields.size() << " fields, "
+            << size << " bytes, " << changed_percent << "% changed): memcmp "
+            << reference_ns << " ns, lanes " << kernel_ns << " ns -> "
+            << (reference_ns / kernel_ns) << "x, picked "
+            << (schema->diff_layout.uses_lanes() ? "lanes" : "memcmp")
+            << std::endl;
+}
+
+int main()
+{
+  std::cout << "[BENCH] Changed-field kernel (" << diff_lane_bytes
+            << "-byte lanes)" << std::endl;
+  game::seed_rng(4242);
+
+  Player_Entity player;
+  player.position = {12.5f, -3.0f, 64.0f};
+  player.health = 100;
+  player.render.mesh_path.set("assets/meshes/player_model.obj");
+  Weapon_Entity weapon;
+  weapon.ammo = 30;
+  weapon.render.mesh_path.set("assets/meshes/rifle.obj");
+  AABB_Entity box;
+  box.half_extents = {64.0f, 8.0f, 64.0f};
+
+  for (int changed_percent : {0, 25, 100})
+  {
+    bench_class("Player_Entity", player, changed_percent);
+    bench_class("Weapon_Entity", weapon, changed_percent);
+    bench_class("AABB_Entity", box, changed_percent);
+  }
+
+  std::cout << "[BENCH] Done." << std::endl;
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include "../shared/entities/static_entities.hpp"
+#include "../shared/map.hpp"
+#include "../shared/rng.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+// Load time of a 100k-entity map (boxes, wedges and meshes) from the text
+// format and from the binary format, which is memory-mapped and copied into
+// the entities class by class. The binary load must give back exactly the
+// entities that were saved.
+
+using namespace network;
+using bench_clock = std::chrono::high_resolution_clock;
+
+constexpr size_t ENTITIES = 100000;
+constexpr int ITERATIONS = 5;
+
+static vec3f random_vec3(float scale)
+{
+  return {(game::random_float() - 0.5f) * scale,
+          (game::random_float() - 0.5f) * scale,
+          (game::random_float() - 0.5f) * scale};
+}
+
+static void randomize_render(render_component_t &render, int i)
+{
+  render.mesh_id = i % 7;
+  render.mesh_path.set("models/crate.obj");
+  render.offset = random_vec3(2.0f);
+  render.scale = {1.0f, 1.0f + game::random_float(), 1.0f};
+}
+
+static shared::map_t make_map()
+{
+  shared::map_t map;
+  map.name = "benchmark";
+  map.reserve(entity_type::AABB, ENTITIES * 5 / 8 + 1);
+  map.reserve(entity_type::WEDGE, ENTITIES * 2 / 8 + 1);
+  map.reserve(entity_type::STATIC_MESH, ENTITIES / 8 + 1);
+  for (size_t i = 0; i < ENTITIES; ++i)
+  {
+    switch (i % 8)
+    {
+    case 0:
+    case 1:
+    {
+      Wedge_Entity wedge;
+      wedge.position = random_vec3(8000.0f);
+      wedge.half_extents = random_vec3(64.0f);
+      wedge.orientation = int32(i % 4);
+      randomize_render(wedge.render, int(i));
+      map.add_entity(wedge);
+      break;
+    }
+    case 2:
+    {
+      Static_Mesh_Entity mesh;
+      mesh.position = random_vec3(8000.0f);
+      randomize_render(mesh.render, int(i));
+      map.add_entity(mesh);
+      break;
+    }
+    default:
+    {
+      AABB_Entity box;
+      box.position = random_vec3(8000.0f);
+      box.half_extents = random_vec3(64.0f);
+      randomize_render(box.render, int(i));
+      map.add_entity(box);
+      break;
+    }
+    }
+  }
+  return map;
+}
+
+// Fastest of ITERATIONS loads, in milliseconds.
+static double time_load(const std::string &path, shared::map_t &out)
+{
+  double best_ms = 1e30;
+  for (int i = 0; i < ITERATIONS; ++i)
+  {
+    auto start = bench_clock::now();
+    bool ok = shared::load_map(path, out);
+    auto end = bench_clock::now();
+    if (!ok)
+      return -1.0;
+    best_ms = std::min(
+        best_ms,
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best_ms;
+}
+
+static bool same_entities(const shared::map_t &a, const shared::map_t &b)
+{
+  if (a.entities.size() != b.entities.size() || a.name != b.name)
+    return false;
+  for (size_t i = 0; i < a.entities.size(); ++i)
+  {
+    const Entity *x = a.entities[i].entity;
+    const Entity *y = b.entities[i].entity;
+    if (a.entities[i].uid != b.entities[i].uid || x->type != y->type)
+      return false;
+    for (const auto &field : x->get_schema()->fields)
+    {
+      if (std::memcmp(reinterpret_cast<const uint8 *>(x) + field.offset,
+                      reinterpret_cast<const uint8 *>(y) + field.offset,
+                      field.size) != 0)
+        return false;
+    }
+  }
+  return true;
+}
+
+int main()
+{
+  std::cout << "[BENCH] Map load, " << ENTITIES << " entities" << std::endl;
+  game::seed_rng(17);
+  shared::map_t map = make_map();
+
+  auto dir = std::filesystem::temp_directory_path();
+  std::string text_path = (dir / "map_load_benchmark.map").string();
+  std::string binary_path =
+      (dir / "map_load_benchmark").string() + shared::binary_map_extension;
+  if (!shared::save_map(text_path, map) ||
+      !shared::convert_map(text_path, binary_path) ||
+      !shared::save_map_binary(binary_path, map))
+  {
+    std::cerr << "Could not write the benchmark maps" << std::endl;
+    return 1;
+  }
+
+  shared::map_t from_text;
+  shared::map_t from_binary;
+  double text_ms = time_load(text_path, from_text);
+  double binary_ms = time_load(binary_path, from_binary);
+  auto text_bytes = std::filesystem::file_size(text_path);
+  auto binary_bytes = std::filesystem::file_size(binary_path);
+  std::filesystem::remove(text_path);
+  std::filesystem::remove(binary_path);
+
+  if (text_ms < 0.0 || binary_ms < 0.0 ||
+      from_text.entities.size() != ENTITIES)
+  {
+    std::cerr << "Could not load the benchmark maps" << std::endl;
+    return 1;
+  }
+  if (!same_entities(map, from_binary))
+  {
+    std::cerr << "Binary map does not match what was saved" << std::endl;
+    return 1;
+  }
+
+  std::cout << "  text:   " << text_ms << " ms, " << text_bytes / 1024
+            << " KiB" << std::endl;
+  std::cout << "  binary: " << binary_ms << " ms, " << binary_bytes / 1024
+            << " KiB (" << text_ms / binary_ms << "x)" << std::endl;
+  std::cout << "[BENCH] Done." << std::endl;
+  return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../shared/network/network_types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The original one-bit-at-a-time writer. The word-buffered Bit_Writer must
+// produce exactly the same bytes (test_entity_delta_packing), and
+// bitstream_benchmark measures against it.
+struct Reference_Bit_Writer
+{
+  std::vector<network::uint8> buffer;
+  size_t bit_index = 0;
+
+  void write_bit(bool value)
+  {
+    size_t byte_pos = bit_index / 8;
+    if (buffer.size() <= byte_pos)
+      buffer.push_back(0);
+    if (value)
+      buffer[byte_pos] |= (1 << (bit_index % 8));
+    bit_index++;
+  }
+
+  void write_bits(uint32_t value, int bits)
+  {
+    for (int i = 0; i < bits; ++i)
+      write_bit((value >> i) & 1);
+  }
+
+  void align()
+  {
+    if (bit_index % 8 != 0)
+      bit_index += (8 - (bit_index % 8));
+  }
+};
@@ -0,0 +1,367 @@
+#include "../shared/entities/player_entity.hpp"
+#include "../shared/entities/static_entities.hpp"
+#include "../shared/entities/weapon_entity.hpp"
+#include "../shared/network/quantization.hpp"
+#include "../shared/rng.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Serialize / deserialize / apply_diff cost for 10k mixed entities: the
+// generic path (a switch on Field_Type and the field's encoding for every
+// field of every entity, and a linear field search per update; kept here as
+// the reference) against the per-class Field_Codec tables the schema builds
+// at registration. Both paths must produce the same bytes and states.
+
+using namespace network;
+using bench_clock = std::chrono::high_resolution_clock;
+
+constexpr size_t ENTITIES = 10000;
+constexpr int ITERATIONS = 20;
+
+namespace generic
+{
+
+void write_field(Bit_Writer &w, const Field_Prop &field, const uint8 *base)
+{
+  const uint8 *p = base + field.offset;
+  switch (field.type)
+  {
+  case Field_Type::Int32:
+    write_quantized_int(w, *reinterpret_cast<const int32_t *>(p),
+                        field.quantization);
+    break;
+  case Field_Type::Float32:
+    write_quantized(w, *reinterpret_cast<const float *>(p),
+                    field.quantization);
+    break;
+  case Field_Type::Bool:
+    w.write_bit(*reinterpret_cast<const bool *>(p));
+    break;
+  case Field_Type::Vec3f:
+    write_quantized_vec3(w, reinterpret_cast<const float *>(p),
+                         field.quantization);
+    break;
+  case Field_Type::PascalString:
+  {
+    const auto *ps = reinterpret_cast<const pascal_string *>(p);
+    w.write_bits(ps->length, 8);
+    w.write_bytes_unaligned(ps->data, ps->length);
+    break;
+  }
+  case Field_Type::RenderComponent:
+  {
+    const auto *rc = reinterpret_cast<const render_component_t *>(p);
+    write_var_int(w, rc->mesh_id);
+    w.write_bits(rc->mesh_path.length, 8);
+    w.write_bytes_unaligned(rc->mesh_path.data, rc->mesh_path.length);
+    w.write_bit(rc->visible);
+    w.write_bit(rc->is_wireframe);
+    for (const vec3f *v : {&rc->offset, &rc->scale, &rc->rotation})
+    {
+      write_coord(w, v->x);
+      write_coord(w, v->y);
+      write_coord(w, v->z);
+    }
+    break;
+  }
+  }
+}
+
+void read_field(Bit_Reader &r, const Field_Prop &field, uint8 *base)
+{
+  uint8 *p = base + field.offset;
+  switch (field.type)
+  {
+  case Field_Type::Int32:
+  {
+    int32_t value = read_quantized_int(r, field.quantization);
+    std::memcpy(p, &value, sizeof(value));
+    break;
+  }
+  case Field_Type::Float32:
+  {
+    float value = read_quantized(r, field.quantization);
+    std::memcpy(p, &value, sizeof(value));
+    break;
+  }
+  case Field_Type::Bool:
+  {
+    bool value = r.read_bit();
+    std::memcpy(p, &value, sizeof(value));
+    break;
+  }
+  case Field_Type::Vec3f:
+  {
+    float values[3];
+    read_quantized_vec3(r, values, field.quantization);
+    std::memcpy(p, values, sizeof(values));
+    break;
+  }
+  case Field_Type::PascalString:
+  {
+    auto *ps = reinterpret_cast<pascal_string *>(p);
+    ps->length = static_cast<uint8>(r.read_bits(8));
+    r.read_bytes_unaligned(ps->data, ps->length);
+    if (ps->length < ps->max_length())
+      ps->data[ps->length] = '\0';
+    break;
+  }
+  case Field_Type::RenderComponent:
+  {
+    auto *rc = reinterpret_cast<render_component_t *>(p);
+    rc->mesh_id = read_var_int(r);
+    rc->mesh_path.length = static_cast<uint8>(r.read_bits(8));
+    r.read_bytes_unaligned(rc->mesh_path.data, rc->mesh_path.length);
+    if (rc->mesh_path.length < rc->mesh_path.max_length())
+      rc->mesh_path.data[rc->mesh_path.length] = '\0';
+    rc->visible = r.read_bit();
+    rc->is_wireframe = r.read_bit();
+    for (vec3f *v : {&rc->offset, &rc->scale, &rc->rotation})
+    {
+      v->x = read_coord(r);
+      v->y = read_coord(r);
+      v->z = read_coord(r);
+    }
+    break;
+  }
+  }
+}
+
+void serialize(Bit_Writer &w, const Entity &entity)
+{
+  const Class_Schema *schema = entity.get_schema();
+  const uint8 *base = reinterpret_cast<const uint8 *>(&entity);
+  size_t num_fields = schema->fields.size();
+  w.write_bits64(all_fields_mask(num_fields), static_cast<int>(num_fields));
+  for (const auto &field : schema->fields)
+    write_field(w, field, base);
+}
+
+void deserialize(Bit_Reader &r, Entity &entity)
+{
+  const Class_Schema *schema = entity.get_schema();
+  uint8 *base = reinterpret_cast<uint8 *>(&entity);
+  std::vector<bool> changed(schema->fields.size());
+  for (size_t i = 0; i < changed.size(); ++i)
+    changed[i] = r.read_bit();
+  for (size_t i = 0; i < changed.size(); ++i)
+  {
+    if (changed[i])
+      read_field(r, schema->fields[i], base);
+  }
+}
+
+void apply_diff(void *target, const std::vector<Field_Update> &updates,
+                const Class_Schema *schema)
+{
+  uint8 *target_ptr = static_cast<uint8 *>(target);
+  for (const auto &update : updates)
+  {
+    for (const auto &field : schema->fields)
+    {
+      if (field.index == update.field_id)
+      {
+        if (update.data.size() == field.size)
+          std::memcpy(target_ptr + field.offset, update.data.data(),
+                      field.size);
+        break;
+      }
+    }
+  }
+}
+
+} // namespace generic
+
+float random_float(float range)
+{
+  return float(game::random_uint64() % 100000) / 100000.0f * range;
+}
+
+// A third each of players, weapons and boxes, every field set to something.
+std::vector<std::unique_ptr<Entity>> make_entities()
+{
+  std::vector<std::unique_ptr<Entity>> entities;
+  for (size_t i = 0; i < ENTITIES; ++i)
+  {
+    std::unique_ptr<Entity> entity;
+    switch (i % 3)
+    {
+    case 0:
+    {
+      auto player = std::make_unique<Player_Entity>();
+      player->view_angle_yaw = random_float(360.0f) - 180.0f;
+      player->view_angle_pitch = random_float(180.0f) - 90.0f;
+      player->health = int32(game::random_uint64() % 101);
+      player->ammo = int32(game::random_uint64() % 300);
+      player->client_slot_index = int32(i % sv_max_player_count);
+      player->render.mesh_path.set("assets/meshes/player_model.obj");
+      entity = std::move(player);
+      break;
+    }
+    case 1:
+    {
+      auto weapon = std::make_unique<Weapon_Entity>();
+      weapon->ammo = int32(game::random_uint64() % 30);
+      weapon->render.mesh_path.set("assets/meshes/rifle.obj");
+      entity = std::move(weapon);
+      break;
+    }
+    default:
+    {
+      auto box = std::make_unique<AABB_Entity>();
+      box->half_extents = {random_float(64.0f), random_float(8.0f),
+                           random_float(64.0f)};
+      entity = std::move(box);
+      break;
+    }
+    }
+    entity->position = {random_float(8000.0f) - 4000.0f, random_float(256.0f),
+                        random_float(8000.0f) - 4000.0f};
+    entity->orientation = {0.0f, random_float(360.0f) - 180.0f, 0.0f};
+    entities.push_back(std::move(entity));
+  }
+  return entities;
+}
+
+std::vector<std::unique_ptr<Entity>>
+blank_copies(const std::vector<std::unique_ptr<Entity>> &entities)
+{
+  std::vector<std::unique_ptr<Entity>> copies;
+  for (const auto &entity : entities)
+  {
+    if (dynamic_cast<const Player_Entity *>(entity.get()))
+      copies.push_back(std::make_unique<Player_Entity>());
+    else if (dynamic_cast<const Weapon_Entity *>(entity.get()))
+      copies.push_back(std::make_unique<Weapon_Entity>());
+    else
+      copies.push_back(std::make_unique<AABB_Entity>());
+  }
+  return copies;
+}
+
+bool same_fields(const Entity &a, const Entity &b)
+{
+  return changed_field_mask(a.get_schema(),
+                            reinterpret_cast<const uint8 *>(&a),
+                            reinterpret_cast<const uint8 *>(&b)) == 0;
+}
+
+template <typename Fn> double time_ms(Fn &&fn)
+{
+  auto start = bench_clock::now();
+  for (int i = 0; i < ITERATIONS; ++i)
+    fn();
+  auto end = bench_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() /
+         ITERATIONS;
+}
+
+void report(const char *what, double generic_ms, double plan_ms)
+{
+  std::cout << "  " << what << ": generic " << generic_ms << " ms, plan "
+            << plan_ms << " ms -> " << (generic_ms / plan_ms) << "x"
+            << std::endl;
+}
+
+int main()
+{
+  std::cout << "[BENCH] Serialization plans, " << ENTITIES << " entities"
+            << std::endl;
+  game::seed_rng(17);
+  auto entities = make_entities();
+
+  // Full updates (every field), which is where the per-field dispatch
+  // dominates.
+  Bit_Writer generic_writer;
+  double generic_write_ms = time_ms(
+      [&]
+      {
+        generic_writer.reset();
+        for (const auto &entity : entities)
+          generic::serialize(generic_writer, *entity);
+      });
+  Bit_Writer plan_writer;
+  double plan_write_ms = time_ms(
+      [&]
+      {
+        plan_writer.reset();
+        for (const auto &entity : entities)
+          entity->serialize(plan_writer, nullptr);
+      });
+  const std::vector<uint8> &generic_bytes = generic_writer.flush();
+  const std::vector<uint8> &plan_bytes = plan_writer.flush();
+  if (generic_bytes != plan_bytes)
+  {
+    std::cout << "  serialize output differs" << std::endl;
+    std::abort();
+  }
+  report("serialize", generic_write_ms, plan_write_ms);
+
+  auto generic_targets = blank_copies(entities);
+  double generic_read_ms = time_ms(
+      [&]
+      {
+        Bit_Reader reader(generic_bytes.data(), generic_bytes.size());
+        for (auto &target : generic_targets)
+          generic::deserialize(reader, *target);
+      });
+  auto plan_targets = blank_copies(entities);
+  double plan_read_ms = time_ms(
+      [&]
+      {
+        Bit_Reader reader(plan_bytes.data(), plan_bytes.size());
+        for (auto &target : plan_targets)
+          target->deserialize(reader);
+      });
+  for (size_t i = 0; i < ENTITIES; ++i)
+  {
+    if (!same_fields(*generic_targets[i], *plan_targets[i]))
+    {
+      std::cout << "  deserialize differs for entity " << i << std::endl;
+      std::abort();
+    }
+  }
+  report("deserialize", generic_read_ms, plan_read_ms);
+
+  // Every field of every entity as a Field_Update, the last field first so
+  // the generic search walks the whole field list.
+  std::vector<std::vector<Field_Update>> updates;
+  for (const auto &entity : entities)
+  {
+    auto entity_updates = diff(nullptr, entity.get(), entity->get_schema());
+    std::reverse(entity_updates.begin(), entity_updates.end());
+    updates.push_back(std::move(entity_updates));
+  }
+  generic_targets = blank_copies(entities);
+  double generic_apply_ms = time_ms(
+      [&]
+      {
+        for (size_t i = 0; i < ENTITIES; ++i)
+          generic::apply_diff(generic_targets[i].get(), updates[i],
+                              generic_targets[i]->get_schema());
+      });
+  plan_targets = blank_copies(entities);
+  double plan_apply_ms = time_ms(
+      [&]
+      {
+        for (size_t i = 0; i < ENTITIES; ++i)
+          apply_diff(plan_targets[i].get(), updates[i],
+                     plan_targets[i]->get_schema());
+      });
+  for (size_t i = 0; i < ENTITIES; ++i)
+  {
+    if (!same_fields(*entities[i], *plan_targets[i]) ||
+        !same_fields(*generic_targets[i], *plan_targets[i]))
+    {
+      std::cout << "  apply_diff differs for entity " << i << std::endl;
+      std::abort();
+    }
+  }
+  report("apply_diff", generic_apply_ms, plan_apply_ms);
+
+  std::cout << "[BENCH] Done." << std::endl;
+  return 0;
+}
@@ -1,7 +1,9 @@
 #include "../shared/network/packet.hpp"
 #include "../shared/network/server_connection_state.hpp"
 #include "../shared/network/udp_socket.hpp"
+#include "../shared/tick_scheduler.hpp"
 #include "game.pb.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <thread>
@@ -40,8 +42,7 @@ void test_receive_and_reassembly()
   }
   client_addr = Address(127, 0, 0, 1, 9002);
 
-  state.player_slots[0] = true;
-  state.player_ips[0] = client_addr;
+  connect_player(state, 0, client_addr);
 
   // Create a Move Command
   game::CmdMove move;
@@ -84,7 +85,7 @@ void test_receive_and_reassembly()
   {
     std::cerr << "Failed to receive/reassemble moves!" << std::endl;
     // Debug
-    std::cerr << "Partial packets count: " << state.partial_packets[0].size()
+    std::cerr << "Partial packets count: " << state.reassembly[0].pending()
               << std::endl;
     assert(false);
   }
@@ -111,9 +112,330 @@ void test_receive_and_reassembly()
   std::cout << "  -> Move Reassembled Correctly!" << std::endl;
 }
 
+void test_reassembly_ring()
+{
+  std::cout << "[TEST] Testing Reassembly Ring..." << std::endl;
+
+  std::vector<uint8> message(3 * MAX_PAYLOAD_SIZE_IN_BYTES + 100);
+  for (size_t i = 0; i < message.size(); ++i)
+    message[i] = static_cast<uint8>(i * 7);
+  auto fragments = convert_to_packets(message, 1);
+  for (auto &fragment : fragments)
+    fragment.header.sequence_id = 5;
+  assert(fragments.size() == 4);
+
+  Reassembly_Ring ring(4, 16, std::chrono::milliseconds(100));
+  auto now = Reassembly_Ring::clock::now();
+
+  // Out of order, with a duplicate: complete only after the last missing one.
+  assert(ring.insert(fragments[2], now).empty());
+  assert(ring.insert(fragments[0], now).empty());
+  assert(ring.insert(fragments[2], now).empty());
+  assert(ring.insert(fragments[3], now).empty());
+  assert(ring.pending() == 1);
+  std::span<const uint8> done = ring.insert(fragments[1], now);
+  assert(done.size() == message.size());
+  assert(std::equal(done.begin(), done.end(), message.begin()));
+  assert(ring.pending() == 0);
+  assert(ring.stats().duplicates == 1);
+
+  // A late duplicate of a completed message starts a new, never-finished one,
+  // which times out.
+  assert(ring.insert(fragments[0], now).empty());
+  assert(ring.pending() == 1);
+  ring.evict_stale(now + std::chrono::milliseconds(50));
+  assert(ring.pending() == 1);
+  ring.evict_stale(now + std::chrono::milliseconds(150));
+  assert(ring.pending() == 0);
+  assert(ring.stats().evicted == 1);
+
+  // A fragment arriving after its message timed out does not complete it.
+  auto later = now + std::chrono::seconds(1);
+  for (size_t i = 0; i < 3; ++i)
+    assert(ring.insert(fragments[i], later).empty());
+  assert(ring.insert(fragments[3], later + std::chrono::milliseconds(200))
+             .empty());
+  assert(ring.stats().evicted == 2);
+
+  // Single-packet messages are handed out in place.
+  Packet single = convert_to_packets({1, 2, 3}, 1)[0];
+  std::span<const uint8> in_place = ring.insert(single, later);
+  assert(in_place.data() == single.buffer && in_place.size() == 3);
+
+  // Inconsistent fragments are rejected.
+  Packet bad = fragments[0];
+  bad.header.sequence_idx = 9;
+  assert(ring.insert(bad, later).empty());
+  assert(ring.stats().malformed == 1);
+
+  std::cout << "  -> Reassembly Ring OK!" << std::endl;
+}
+
+void test_buffer_pool()
+{
+  std::cout << "[TEST] Testing Connection Buffer Pool..." << std::endl;
+
+  // Nothing is allocated up front.
+  Server_Connection_State state;
+  Buffer_Pool &pool = state.buffer_pool;
+  assert(state.player_byte_buffers[0].data.empty());
+  assert(pool.stats().bytes_in_use == 0);
+
+  // Lazily grown in size classes, keeping what was written.
+  Byte_Buffer &buffer = state.player_byte_buffers[0];
+  assert(pool.reserve(buffer, 100));
+  assert(buffer.data.size() == Buffer_Pool::min_class_bytes);
+  for (size_t i = 0; i < 100; ++i)
+    buffer.data[i] = static_cast<uint8>(i);
+  buffer.cursor = 100;
+  assert(pool.reserve(buffer, 3000));
+  assert(buffer.data.size() == 4096);
+  assert(buffer.data[99] == 99);
+  assert(pool.stats().bytes_in_use == 4096);
+  assert(pool.stats().bytes_pooled == 256);
+  assert(!pool.reserve(buffer, Buffer_Pool::max_class_bytes + 1));
+  assert(buffer.data.size() == 4096);
+
+  // Released on disconnect, reused by the next connection.
+  Address address(127, 0, 0, 1, 9010);
+  connect_player(state, 0, address);
+  disconnect_player(state, address);
+  assert(buffer.data.empty() && buffer.cursor == 0);
+  assert(pool.stats().bytes_in_use == 0);
+  assert(pool.stats().bytes_pooled == 4096 + 256);
+
+  uint64 allocations = pool.stats().allocations;
+  assert(pool.reserve(state.player_byte_buffers[1], 4000));
+  assert(pool.stats().allocations == allocations);
+  assert(pool.stats().reuses == 1);
+  assert(pool.stats().peak_bytes_in_use == 4096 + 256);
+
+  pool.trim();
+  assert(pool.stats().bytes_pooled == 0);
+
+  std::cout << "  -> Buffer Pool OK!" << std::endl;
+}
+
+void test_packet_routing()
+{
+  std::cout << "[TEST] Testing Packet Routing..." << std::endl;
+
+  // The address table survives churn: erase shifts probe runs back.
+  Address_Table<sv_max_player_count> table;
+  for (int i = 0; i < sv_max_player_count; ++i)
+    assert(table.insert(Address(10, 0, 0, 1, static_cast<uint16>(i)), i));
+  assert(!table.insert(Address(10, 0, 0, 2, 0), 0));
+  for (int i = 0; i < sv_max_player_count; i += 2)
+    table.erase(Address(10, 0, 0, 1, static_cast<uint16>(i)));
+  for (int i = 0; i < sv_max_player_count; ++i)
+  {
+    int expected = i % 2 ? i : Address_Table<sv_max_player_count>::not_found;
+    assert(table.find(Address(10, 0, 0, 1, static_cast<uint16>(i))) ==
+           expected);
+  }
+  assert(table.size() == sv_max_player_count / 2);
+
+  Server_Connection_State state;
+  Address player(127, 0, 0, 1, 9020);
+  Address other(127, 0, 0, 1, 9021);
+  uint16 token = connect_player(state, 7, player);
+  assert(token != 0 && connection_token_slot(token) == 7);
+  assert(get_player_idx(state, player) == 7);
+  assert(get_player_idx(state, other) == size_t(-1));
+
+  // A valid token indexes the slot; a bad one falls back to the address.
+  Packet_Header header = {};
+  header.connection_token = token;
+  assert(find_sender_slot(state, header, player) == 7);
+  assert(find_sender_slot(state, header, other) == size_t(-1));
+  header.connection_token = static_cast<uint16>(token + sv_max_player_count);
+  assert(find_sender_slot(state, header, player) == 7);
+
+  // Unknown senders: deduplicated, bounded, and rate limited.
+  game::NetCommand ack;
+  ack.mutable_snapshot_ack()->set_tick(1);
+  std::vector<uint8> bytes(ack.ByteSizeLong());
+  ack.SerializeToArray(bytes.data(), static_cast<int>(bytes.size()));
+  Packet junk = convert_to_packets(
+      bytes, static_cast<uint8>(Message_Type::NetCommand))[0];
+
+  ServerInbox inbox;
+  state.unknown_senders.burst = 1000.0f;
+  state.unknown_senders.packets_per_second = 1000.0f;
+  state.unknown_senders.admit(Unknown_Sender_Limiter::clock::now());
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  for (int i = 0; i < 40; ++i)
+  {
+    handle_received_packet(state, junk, other, inbox);
+    handle_received_packet(
+        state, junk, Address(10, 1, 0, 0, static_cast<uint16>(i)), inbox);
+  }
+  assert(inbox.potential_joins.size() == max_potential_joins);
+  assert(inbox.potential_joins[0] == other);
+  assert(inbox.net_commands.size() == 80);
+
+  state.unknown_senders.burst = 4.0f;
+  state.unknown_senders.packets_per_second = 1.0f;
+  ServerInbox flooded;
+  for (int i = 0; i < 100; ++i)
+    handle_received_packet(state, junk, other, flooded);
+  assert(flooded.net_commands.size() <= 5);
+  assert(state.unknown_senders.dropped_count() >= 95);
+
+  // The connected player is not subject to the limit.
+  handle_received_packet(state, junk, player, flooded);
+  assert(flooded.net_commands.back().first == player);
+
+  disconnect_player(state, player);
+  assert(get_player_idx(state, player) == size_t(-1));
+  assert(state.connection_tokens[7] == 0);
+
+  std::cout << "  -> Packet Routing OK!" << std::endl;
+}
+
+void test_usercmd_stream()
+{
+  std::cout << "[TEST] Testing Usercmd Stream..." << std::endl;
+
+  assert(degrees_to_angle(90.0f) == 16384);
+  assert(degrees_to_angle(-90.0f) == 49152);
+  assert(std::abs(angle_to_degrees(degrees_to_angle(-37.5f)) + 37.5f) < 0.01f);
+  assert(quantize_move(2.0f) == 127 && quantize_move(-1.0f) == -127);
+
+  auto sample = [](uint32 frame)
+  {
+    usercmd_t cmd;
+    cmd.tick = 100 + frame;
+    cmd.yaw = degrees_to_angle(frame * 1.5f);
+    cmd.pitch = degrees_to_angle(frame % 20 < 10 ? 10.0f : -10.0f);
+    cmd.forward_move = frame % 30 < 20 ? 127 : 0;
+    cmd.side_move = quantize_move(frame % 7 == 0 ? -1.0f : 0.0f);
+    cmd.buttons = frame % 50 == 0 ? Button_Jump : 0;
+    return cmd;
+  };
+
+  // Drop every third datagram plus a burst; redundancy 4 covers the former.
+  Usercmd_Buffer client;
+  Usercmd_Ring server;
+  Bit_Writer writer;
+  size_t executed = 0;
+  size_t max_bytes = 0;
+  for (uint32 frame = 0; frame < 200; ++frame)
+  {
+    client.push(sample(frame));
+    writer.reset();
+    client.write(writer, 4);
+    const auto &bytes = writer.flush();
+    max_bytes = std::max(max_bytes, bytes.size());
+
+    bool lost = frame % 3 == 1 || (frame >= 150 && frame < 156);
+    if (!lost)
+    {
+      Bit_Reader reader(bytes.data(), bytes.size());
+      assert(server.read(reader));
+    }
+
+    while (const usercmd_t *cmd = server.next())
+    {
+      usercmd_t expected = sample(cmd->command_number - 1);
+      assert(cmd->tick == expected.tick && cmd->yaw == expected.yaw &&
+             cmd->pitch == expected.pitch &&
+             cmd->forward_move == expected.forward_move &&
+             cmd->side_move == expected.side_move &&
+             cmd->buttons == expected.buttons);
+      executed += 1;
+    }
+  }
+
+  // Only the burst loses commands: the datagram after it still carries the
+  // last three of it (and one received just before it had the others).
+  std::cout << "  -> executed " << executed << " of 200, lost "
+            << server.stats().lost << ", at most " << max_bytes
+            << " bytes per datagram" << std::endl;
+  assert(server.stats().lost == 3);
+  // The last datagram was dropped, so its newest command is still to come.
+  assert(server.newest() == 199);
+  assert(executed + server.stats().lost == 199);
+  assert(max_bytes <= 32);
+
+  // Truncated input is rejected without executing garbage.
+  Usercmd_Ring fresh;
+  const auto &bytes = writer.flush();
+  Bit_Reader truncated(bytes.data(), 2);
+  assert(!fresh.read(truncated));
+
+  std::cout << "  -> Usercmd Stream OK!" << std::endl;
+}
+
+void test_tick_scheduler()
+{
+  std::cout << "[TEST] Testing Tick Scheduler..." << std::endl;
+
+  Udp_Socket socket;
+  if (!socket.open(9004))
+  {
+    std::cerr << "Failed to open socket on 9004" << std::endl;
+    exit(1);
+  }
+
+  // Nothing pending: wait_readable times out.
+  auto wait_start = std::chrono::steady_clock::now();
+  assert(!socket.wait_readable(0.02));
+  assert(std::chrono::steady_clock::now() - wait_start >=
+         std::chrono::milliseconds(15));
+
+  constexpr double tickrate = 200.0;
+  constexpr int tick_count = 100;
+  shared::Tick_Scheduler scheduler(tickrate);
+
+  int io_waits = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < tick_count; ++i)
+  {
+    scheduler.wait_for_next_tick(
+        [&](double timeout_seconds)
+        {
+          io_waits += 1;
+          socket.wait_readable(timeout_seconds);
+        });
+
+    // Simulate a tick that takes a variable part of the budget; the absolute
+    // schedule must absorb it without drifting.
+    std::this_thread::sleep_for(std::chrono::microseconds((i % 4) * 500));
+  }
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  // The first tick is due immediately, so 100 ticks span 99 periods.
+  double expected = (tick_count - 1) / tickrate;
+  const auto &stats = scheduler.stats();
+  std::cout << "  -> " << tick_count << " ticks in " << elapsed
+            << " s (expected " << expected << " s), lateness mean "
+            << stats.mean_lateness_us << "us max " << stats.max_lateness_us
+            << "us, io waits " << io_waits << std::endl;
+
+  assert(stats.ticks == tick_count);
+  assert(io_waits > 0);
+  assert(elapsed >= expected * 0.98);
+  assert(elapsed < expected * 1.25);
+
+  // Falling far behind skips ticks instead of bursting.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  assert(scheduler.consume_due_tick());
+  assert(scheduler.stats().skipped_ticks > 0);
+
+  std::cout << "  -> Scheduler OK!" << std::endl;
+}
+
 int main()
 {
   test_receive_and_reassembly();
+  test_reassembly_ring();
+  test_buffer_pool();
+  test_packet_routing();
+  test_usercmd_stream();
+  test_tick_scheduler();
   std::cout << "[TEST] All tests passed." << std::endl;
   return 0;
 }
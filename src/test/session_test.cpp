@@ -4,7 +4,11 @@
 #include "log.hpp"
 #include "map.hpp" // shared::create_entity_by_classname
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <string>
 
 using namespace shared;
 
@@ -23,7 +27,7 @@ int main()
     e->position = {0, 0, 0};
     e->half_extents = {10, 10, 10};
   }
-  test_map.add_entity(aabb_ent);
+  test_map.add_entity(*aabb_ent);
 
   // Add a Player Entity Spawn
   auto player_ent = shared::create_entity_by_classname("player_start");
@@ -32,11 +36,11 @@ int main()
     p->position = {5, 5, 0};
     p->view_angle_yaw = 90.0f;
   }
-  test_map.add_entity(player_ent);
+  test_map.add_entity(*player_ent);
 
   // 2. Initialize Session
   game_session_t session;
-  init_session_from_map(session, test_map);
+  init_session_from_map(session, std::move(test_map));
 
   // 3. Verify
 
@@ -59,6 +63,14 @@ int main()
     return 1;
   }
 
+  // The session keeps the map; static entities point into it.
+  if (session.map.entities.size() != 2 ||
+      session.static_entities[0] != session.map.entities[0].entity)
+  {
+    log_error("Static entities do not reference the session's map");
+    return 1;
+  }
+
   // Verify BVH (should be built from static entities)
   // If BVH building is implemented for entities, this should pass.
   if (session.bvh.nodes.empty())
@@ -97,6 +109,252 @@ int main()
     return 1;
   }
 
+  // Map storage: a saved and reloaded map keeps each class in one block,
+  // removed entities leave a tombstone that the next add reuses, and
+  // entities never move while they are in the map.
+  {
+    map_t boxes;
+    for (int i = 0; i < 100; ++i)
+    {
+      network::AABB_Entity box;
+      box.position = {float(i), 0, 0};
+      box.half_extents = {1, 1, 1};
+      boxes.add_entity(box);
+    }
+    network::Player_Entity spawn;
+    boxes.add_entity(spawn);
+
+    const char *path = "session_test_arena.map";
+    if (!save_map(path, boxes))
+    {
+      log_error("Could not save {}", path);
+      return 1;
+    }
+    map_t loaded;
+    bool ok = load_map(path, loaded);
+    std::remove(path);
+    if (!ok || loaded.entities.size() != 101)
+    {
+      log_error("Reloaded map has the wrong entities");
+      return 1;
+    }
+
+    auto &arena = loaded.arena<network::AABB_Entity>();
+    if (arena.blocks.size() != 1 || arena.blocks[0].size() != 100 ||
+        loaded.entities[0].entity != &arena.blocks[0][0] ||
+        loaded.entities[99].entity != &arena.blocks[0][99])
+    {
+      log_error("Loaded boxes are not one contiguous block");
+      return 1;
+    }
+
+    network::Entity *kept = loaded.entities[10].entity;
+    entity_uid_t removed = loaded.entities[5].uid;
+    network::Entity *hole = loaded.entities[5].entity;
+    loaded.remove_entity(removed);
+    int live = 0;
+    arena.for_each([&](network::AABB_Entity &) { live += 1; });
+    if (live != 99 || hole->type != entity_type::UNKNOWN)
+    {
+      log_error("Removed box was not left as a tombstone");
+      return 1;
+    }
+
+    network::AABB_Entity extra;
+    extra.position = {-1, 0, 0};
+    entity_uid_t added = loaded.add_entity(extra);
+    if (loaded.find_by_uid(added)->entity != hole ||
+        hole->type != entity_type::AABB || hole->position.x != -1.0f ||
+        loaded.entities[9].entity != kept || kept->position.x != 10.0f)
+    {
+      log_error("Map entities moved or the tombstone was not reused");
+      return 1;
+    }
+  }
+
+  // Property parsing: fields are found by name through the schema's sorted
+  // index and parsed in place from the file text.
+  {
+    const network::Class_Schema *schema =
+        network::AABB_Entity{}.get_schema();
+    auto half_extents = schema->find_fields("half_extents");
+    if (half_extents.size() != 1 ||
+        schema->fields[half_extents[0]].name != "half_extents" ||
+        !schema->find_fields("no_such_field").empty())
+    {
+      log_error("find_fields did not find the right fields");
+      return 1;
+    }
+
+    const char *path = "session_test_properties.map";
+    if (FILE *file = std::fopen(path, "w"))
+    {
+      std::fputs("entity\n{\n  \"classname\" \"worldspawn\"\n"
+                 "  \"name\" \"Hand Written\"\n}\n"
+                 "entity\n{\n  \"classname\" \"aabb_entity\"\n"
+                 "  \"_uid\" \"42\"\n  \"center\" \"1.5 -2 +3e1\"\n"
+                 "  \"half_extents\" \"4  5 6\"\n"
+                 "  \"render\" \"7|models/box.obj|true|0|0 0 1|2 2 2|0 90 0\"\n"
+                 "  \"unknown_key\" \"whatever\"\n}\n",
+                 file);
+      std::fclose(file);
+    }
+    map_t loaded;
+    bool ok = load_map(path, loaded);
+    std::remove(path);
+    const map_entity_t *entry = ok ? loaded.find_by_uid(42) : nullptr;
+    const auto *box =
+        entry ? network::entity_cast<network::AABB_Entity>(entry->entity)
+              : nullptr;
+    if (!box || loaded.name != "Hand Written")
+    {
+      log_error("Hand-written map did not load");
+      return 1;
+    }
+    if (box->position.x != 1.5f || box->position.y != -2.0f ||
+        box->position.z != 30.0f || box->half_extents.y != 5.0f ||
+        box->half_extents.z != 6.0f || box->render.mesh_id != 7 ||
+        std::string(box->render.mesh_path.c_str()) != "models/box.obj" ||
+        !box->render.visible || box->render.is_wireframe ||
+        box->render.offset.z != 1.0f || box->render.rotation.y != 90.0f)
+    {
+      log_error("Hand-written map properties were parsed wrong");
+      return 1;
+    }
+  }
+
+  // Binary maps: a round trip gives back the same entities in the same
+  // order, through the packed copy and, when the stored layout no longer
+  // matches, through the by-name fallback.
+  {
+    map_t original;
+    original.name = "Binary";
+    for (int i = 0; i < 10; ++i)
+    {
+      network::AABB_Entity box;
+      box.position = {float(i) + 0.125f, -1.0f / 3.0f, 0};
+      box.half_extents = {1, 2, 3};
+      box.render.mesh_path.set("models/box.obj");
+      original.add_entity(box);
+      network::Wedge_Entity wedge;
+      wedge.orientation = i % 4;
+      original.add_entity_with_uid(100 + i, wedge);
+    }
+
+    auto same = [&](const map_t &loaded)
+    {
+      if (loaded.name != original.name ||
+          loaded.entities.size() != original.entities.size())
+        return false;
+      for (size_t i = 0; i < loaded.entities.size(); ++i)
+      {
+        const network::Entity *a = original.entities[i].entity;
+        const network::Entity *b = loaded.entities[i].entity;
+        if (loaded.entities[i].uid != original.entities[i].uid ||
+            a->type != b->type)
+          return false;
+        for (const auto &field : a->get_schema()->fields)
+        {
+          if (std::memcmp(reinterpret_cast<const uint8_t *>(a) + field.offset,
+                          reinterpret_cast<const uint8_t *>(b) + field.offset,
+                          field.size) != 0)
+            return false;
+        }
+      }
+      return true;
+    };
+
+    const char *path = "session_test_binary.bmap";
+    const char *text_path = "session_test_binary.map";
+    map_t loaded;
+    bool ok = save_map_binary(path, original) && is_binary_map(path) &&
+              load_map(path, loaded) && same(loaded);
+
+    // Text and back: positions survive to the text format's precision.
+    map_t converted;
+    ok = ok && convert_map(path, text_path) && !is_binary_map(text_path) &&
+         convert_map(text_path, path) && load_map(path, converted) &&
+         converted.entities.size() == original.entities.size() &&
+         converted.find_by_uid(105) &&
+         converted.entities[2].entity->position.x == 1.125f;
+
+    // Overwrites one byte of the saved file.
+    auto poke = [&](long offset, int byte)
+    {
+      FILE *file = std::fopen(path, "r+b");
+      if (!file)
+        return false;
+      std::fseek(file, offset, SEEK_SET);
+      std::fputc(byte, file);
+      std::fclose(file);
+      return true;
+    };
+    constexpr long header_size = 80;
+    const long first_class = header_size; // its layout hash comes first
+
+    // A stale layout hash sends the load through the by-name path, with the
+    // same result.
+    map_t fallback;
+    ok = ok && save_map_binary(path, original) && poke(first_class, 0x5a) &&
+         load_map(path, fallback) && same(fallback);
+
+    // A render component the writing build laid out differently cannot be
+    // read; the by-name path leaves it at its defaults and loads the rest.
+    map_t relaid;
+    ok = ok && save_map_binary(path, original) && poke(first_class, 0x5a) &&
+         poke(48 + 4 * long(network::Field_Type::RenderComponent), 0x5a) &&
+         load_map(path, relaid);
+    if (ok)
+    {
+      auto *box = network::entity_cast<network::AABB_Entity>(
+          relaid.entities[0].entity);
+      ok = box && box->half_extents.z == 3.0f &&
+           box->render.mesh_path.length == 0;
+    }
+
+    // Damaged values in a copied record are made valid: the first box's
+    // visible flag and mesh path length. Its render component follows
+    // position, orientation and half extents in the record, and the class's
+    // records_offset is 48 bytes into its entry.
+    map_t damaged;
+    uint64_t records = 0;
+    ok = ok && save_map_binary(path, original);
+    if (FILE *file = ok ? std::fopen(path, "rb") : nullptr)
+    {
+      std::fseek(file, first_class + 48, SEEK_SET);
+      ok = std::fread(&records, sizeof(records), 1, file) == 1;
+      std::fclose(file);
+    }
+    long render = long(records) + 3 * long(sizeof(network::vec3f));
+    ok = ok &&
+         poke(render + offsetof(network::render_component_t, visible), 0x7f) &&
+         poke(render + offsetof(network::render_component_t, mesh_path),
+              0xff) &&
+         load_map(path, damaged);
+    if (ok)
+    {
+      auto *box = network::entity_cast<network::AABB_Entity>(
+          damaged.entities[0].entity);
+      uint8_t visible = 0;
+      std::memcpy(&visible, &box->render.visible, 1);
+      ok = visible == 1 && box->render.mesh_path.length ==
+                               box->render.mesh_path.max_length();
+    }
+
+    // A cut-off file is rejected.
+    std::filesystem::resize_file(path, 100);
+    map_t truncated;
+    ok = ok && !load_map(path, truncated);
+
+    std::remove(path);
+    std::remove(text_path);
+    if (!ok)
+    {
+      log_error("Binary map round trip failed");
+      return 1;
+    }
+  }
+
   log_error("Session Test Passed!");
   return 0;
 }
@@ -0,0 +1,268 @@
+#include "../shared/entities/player_entity.hpp"
+#include "../shared/entities/weapon_entity.hpp"
+#include "../shared/entity_system.hpp"
+#include "../shared/network/interest.hpp"
+#include "../shared/network/snapshot_builder.hpp"
+#include "../shared/network/snapshot_priority.hpp"
+#include "../shared/rng.hpp"
+#include "../shared/task_system.hpp"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Per-tick snapshot build cost for 32 clients and 5k entities, serial and
+// with 1..N Task_System workers. Every configuration must produce exactly the
+// same payloads. Then the same build on a large map with and without
+// interest management and a per-client bandwidth budget.
+
+using namespace network;
+using bench_clock = std::chrono::high_resolution_clock;
+
+constexpr int CLIENTS = 32;
+constexpr int ENTITIES = 5000;
+constexpr int TICKS = 200;
+
+struct World
+{
+  shared::Entity_System entities;
+  Snapshot_Ring history;
+  uint32 tick = 0;
+
+  const snapshot_t &step()
+  {
+    // Roughly a quarter of the world moves every tick.
+    auto *players = entities.get_entities<Player_Entity>(entity_type::PLAYER);
+    for (auto &p : *players)
+    {
+      if (game::random_uint64() % 4 == 0)
+        p.set(p.position, {p.position.x + 0.25f, p.position.y, p.position.z});
+    }
+    auto *weapons = entities.get_entities<Weapon_Entity>(entity_type::WEAPON);
+    for (auto &w : *weapons)
+    {
+      if (game::random_uint64() % 16 == 0)
+        w.set(w.ammo, w.ammo - 1);
+    }
+
+    entities.sync_transforms();
+    tick += 1;
+    snapshot_t &snapshot = history.begin(tick);
+    capture_snapshot(entities, snapshot);
+    return snapshot;
+  }
+};
+
+// Clients mostly ack the previous tick, some lag behind, one needs a full
+// update.
+std::vector<const snapshot_t *> client_baselines(const World &world)
+{
+  std::vector<const snapshot_t *> baselines;
+  for (int client = 0; client < CLIENTS; ++client)
+  {
+    uint32 lag = client == 0 ? world.tick : (client % 8 == 0 ? 3 : 1);
+    baselines.push_back(world.history.find(world.tick - lag));
+  }
+  return baselines;
+}
+
+// Entities spread over a `map_size` x `map_size` map; each client is sent
+// either everything or only what is near its player (relevancy included in
+// the timing), optionally within a per-client byte budget per tick.
+void run_interest(float map_size, bool cull, size_t budget_bytes)
+{
+  game::seed_rng(7);
+  World world;
+  std::vector<Entity_Id> client_players;
+  for (int i = 0; i < ENTITIES; ++i)
+  {
+    float x = float(game::random_uint64() % 1000) / 1000.0f * map_size;
+    float z = float(game::random_uint64() % 1000) / 1000.0f * map_size;
+    if (i % 4 == 0)
+    {
+      auto *p = world.entities.spawn<Player_Entity>(entity_type::PLAYER);
+      p->position = {x, 0.0f, z};
+      if (client_players.size() < CLIENTS)
+        client_players.push_back(p->id);
+    }
+    else
+    {
+      auto *w = world.entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+      w->position = {x, 0.0f, z};
+      w->ammo = 30;
+    }
+  }
+
+  std::array<Interest_Ring, CLIENTS> sent;
+  std::array<Priority_Accumulator, CLIENTS> priorities;
+  std::array<std::vector<uint32>, CLIENTS> relevant;
+  std::array<std::vector<float>, CLIENTS> rates;
+  Relevancy_Index relevancy;
+  Snapshot_Builder builder;
+  std::vector<Snapshot_Builder::Client> clients(CLIENTS);
+  double total_us = 0.0;
+  size_t total_bytes = 0;
+  size_t max_bytes = 0;
+  size_t total_visible = 0;
+  for (int t = 0; t < TICKS; ++t)
+  {
+    const snapshot_t &snapshot = world.step();
+
+    auto start = bench_clock::now();
+    if (cull)
+      relevancy.build(snapshot, world.entities, {});
+    for (int c = 0; c < CLIENTS; ++c)
+    {
+      Snapshot_Builder::Client &client = clients[c];
+      uint32 acked = world.tick - 1;
+      client.baseline = {};
+      if (const sent_view_t *view = sent[c].find(acked))
+        client.baseline = view->of(world.history.find(acked));
+
+      relevant[c].clear();
+      if (cull)
+      {
+        interest_viewer_t viewer;
+        viewer.entity = client_players[c];
+        const shared::Transform_Stream &transforms = world.entities.transforms;
+        size_t player = world.entities.transform_index(viewer.entity);
+        if (player < transforms.size())
+          viewer.origin = transforms.positions[player];
+        relevancy.query(viewer, relevant[c], &rates[c]);
+        client.priority_rates = &rates[c];
+      }
+      else
+      {
+        for (size_t i = 0; i < snapshot.entities.size(); ++i)
+          relevant[c].push_back(static_cast<uint32>(i));
+      }
+      client.visible = &relevant[c];
+      client.budget_bytes = budget_bytes;
+      client.priorities = &priorities[c];
+      client.sent = &sent[c].begin(world.tick);
+      total_visible += relevant[c].size();
+    }
+    builder.build(snapshot, clients, &world.history);
+    total_us += std::chrono::duration<double, std::micro>(
+                    bench_clock::now() - start)
+                    .count();
+
+    for (int c = 0; c < CLIENTS; ++c)
+    {
+      total_bytes += builder.payload(c).size();
+      max_bytes = std::max(max_bytes, builder.payload(c).size());
+    }
+  }
+
+  std::cout << "  " << map_size << " units, "
+            << (cull ? "relevancy" : "everything");
+  if (budget_bytes != Snapshot_Builder::unlimited)
+    std::cout << ", " << budget_bytes << " byte budget";
+  std::cout << ": " << total_us / TICKS << " us/tick, "
+            << total_visible / (TICKS * CLIENTS) << " entities, "
+            << total_bytes / (TICKS * CLIENTS) << " bytes/client (max "
+            << max_bytes << ")" << std::endl;
+}
+
+int main()
+{
+  std::cout << "[BENCH] Snapshot build: " << CLIENTS << " clients, "
+            << ENTITIES << " entities" << std::endl;
+
+  size_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> worker_counts = {0};
+  for (size_t n = 1; n <= max_workers; n *= 2)
+    worker_counts.push_back(n);
+  if (worker_counts.back() != max_workers)
+    worker_counts.push_back(max_workers);
+
+  std::vector<std::vector<uint8>> reference;
+  double serial_us = 0.0;
+  for (size_t workers : worker_counts)
+  {
+    // Same world, same random sequence for every run.
+    game::seed_rng(42);
+    World world;
+    for (int i = 0; i < ENTITIES; ++i)
+    {
+      if (i % 4 == 0)
+      {
+        auto *p = world.entities.spawn<Player_Entity>(entity_type::PLAYER);
+        p->position = {float(i), 0.0f, 0.0f};
+        p->render.mesh_path.set("assets/meshes/player_model.obj");
+      }
+      else
+      {
+        auto *w = world.entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+        w->ammo = 30;
+      }
+    }
+    for (int i = 0; i < 4; ++i)
+      world.step();
+
+    Task_System tasks;
+    if (workers > 0)
+      tasks.initialize(workers);
+
+    Snapshot_Builder builder;
+    double total_us = 0.0;
+    size_t total_bytes = 0;
+    for (int t = 0; t < TICKS; ++t)
+    {
+      const snapshot_t &snapshot = world.step();
+      auto baselines = client_baselines(world);
+
+      auto start = bench_clock::now();
+      builder.build(snapshot, baselines, workers > 0 ? &tasks : nullptr);
+      total_us += std::chrono::duration<double, std::micro>(
+                      bench_clock::now() - start)
+                      .count();
+
+      for (int c = 0; c < CLIENTS; ++c)
+        total_bytes += builder.payload(c).size();
+
+      // Determinism: the last tick's payloads are compared across runs.
+      if (t == TICKS - 1)
+      {
+        std::vector<std::vector<uint8>> payloads;
+        for (int c = 0; c < CLIENTS; ++c)
+        {
+          auto bytes = builder.payload(c);
+          payloads.emplace_back(bytes.begin(), bytes.end());
+        }
+        if (reference.empty())
+          reference = payloads;
+        if (payloads != reference)
+        {
+          std::cerr << "Payloads differ with " << workers << " workers"
+                    << std::endl;
+          return 1;
+        }
+      }
+    }
+
+    double per_tick_us = total_us / TICKS;
+    if (workers == 0)
+      serial_us = per_tick_us;
+    std::cout << "  " << (workers == 0 ? std::string("serial")
+                                       : std::to_string(workers) + " workers")
+              << ": " << per_tick_us << " us/tick ("
+              << serial_us / per_tick_us << "x), "
+              << total_bytes / (TICKS * CLIENTS) << " bytes/client, "
+              << builder.stats().hit_rate() * 100.0 << "% cache hits"
+              << std::endl;
+    tasks.shutdown();
+  }
+
+  std::cout << "[BENCH] Interest management, serial" << std::endl;
+  for (float map_size : {8000.0f, 32000.0f})
+  {
+    run_interest(map_size, false, Snapshot_Builder::unlimited);
+    run_interest(map_size, true, Snapshot_Builder::unlimited);
+    run_interest(map_size, true, max_snapshot_data_bytes);
+  }
+
+  std::cout << "[BENCH] Done." << std::endl;
+  return 0;
+}
@@ -39,6 +39,14 @@ int main() {
 
   assert(counter.load() == TASK_COUNT);
 
+  // parallel_for blocks until every job ran.
+  std::vector<int> results(1000, 0);
+  ts.parallel_for(results.size(), [&](size_t i) { results[i] = int(i) * 2; });
+  for (size_t i = 0; i < results.size(); ++i) {
+    assert(results[i] == int(i) * 2);
+  }
+  std::cout << "parallel_for done." << std::endl;
+
   ts.shutdown();
   std::cout << "Task System shutdown." << std::endl;
 
@@ -1,8 +1,18 @@
+#define ENTITIES_WANT_INCLUDES
+#include "../shared/entities/entity_list.hpp"
 #include "../shared/entity.hpp"
+#include "../shared/entity_system.hpp"
+#include "../shared/network/bandwidth_profiler.hpp"
 #include "../shared/network/entity_serialization.hpp"
 #include "../shared/network/schema.hpp"
+#include "../shared/network/snapshot_builder.hpp"
+#include "../shared/rng.hpp"
+#include "reference_bit_writer.hpp"
 #include "game.pb.h"
 #include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 using namespace network;
@@ -28,12 +38,711 @@ REGISTER_FIELD(y)
 REGISTER_FIELD(ammo)
 END_SCHEMA(TestPlayer)
 
+// One int field per Int_Coding.
+class Coded_Counters : public Entity
+{
+public:
+  SCHEMA_FIELD(int32, nibble, Schema_Flags::Networked);
+  SCHEMA_FIELD_CODED(int32, group7, Schema_Flags::Networked,
+                     Int_Coding::Group7);
+  SCHEMA_FIELD_CODED(int32, length_prefixed, Schema_Flags::Networked,
+                     Int_Coding::Length_Prefixed);
+
+  DECLARE_SCHEMA(Coded_Counters)
+};
+
+BEGIN_SCHEMA(Coded_Counters)
+REGISTER_FIELD(nibble)
+REGISTER_FIELD(group7)
+REGISTER_FIELD(length_prefixed)
+END_SCHEMA(Coded_Counters)
+
+void test_bit_writer_matches_reference()
+{
+  std::cout << "  [Subtest] Word-buffered Bit_Writer vs reference..."
+            << std::endl;
+
+  game::seed_rng(42);
+  Bit_Writer writer;
+  Reference_Bit_Writer reference;
+  std::vector<uint8> bytes(64);
+
+  for (int op = 0; op < 20000; ++op)
+  {
+    uint64_t r = game::random_uint64();
+    switch (r % 5)
+    {
+    case 0:
+    case 1:
+    {
+      int bits = 1 + static_cast<int>((r >> 8) % 32);
+      uint32_t value = static_cast<uint32_t>(game::random_uint64());
+      writer.write_bits(value, bits);
+      reference.write_bits(value, bits);
+      break;
+    }
+    case 2:
+    {
+      bool value = (r >> 8) & 1;
+      writer.write_bit(value);
+      reference.write_bit(value);
+      break;
+    }
+    case 3:
+    {
+      size_t count = (r >> 8) % bytes.size();
+      for (auto &b : bytes)
+        b = static_cast<uint8>(game::random_uint64());
+      writer.write_bytes_unaligned(bytes.data(), count);
+      for (size_t i = 0; i < count; ++i)
+        reference.write_bits(bytes[i], 8);
+      break;
+    }
+    case 4:
+    {
+      if ((r >> 8) % 8 == 0)
+      {
+        writer.align();
+        reference.align();
+      }
+      break;
+    }
+    }
+    assert(writer.bits_written() == reference.bit_index);
+  }
+
+  // align() at the very end does not add bytes in either writer.
+  const auto &out = writer.flush();
+  assert(out.size() == reference.buffer.size());
+  assert(std::memcmp(out.data(), reference.buffer.data(), out.size()) == 0);
+
+  // Read everything back through the word-buffered reader.
+  Bit_Reader reader(out.data(), out.size());
+  Bit_Reader ref_reader(reference.buffer.data(), reference.buffer.size());
+  while (ref_reader.bits_remaining() > 0)
+  {
+    int bits = 1 + static_cast<int>(game::random_uint64() % 32);
+    uint32_t expected = 0;
+    for (int i = 0; i < bits; ++i)
+      expected |= uint32_t(ref_reader.read_bit()) << i;
+    assert(reader.read_bits(bits) == expected);
+  }
+  std::cout << "    -> Success! (" << out.size() << " bytes)" << std::endl;
+}
+
+void test_strings_and_render_component()
+{
+  std::cout << "  [Subtest] Strings and render components..." << std::endl;
+
+  Bit_Writer writer;
+  writer.write_bit(true); // knock the stream off byte alignment
+  write_string(writer, "unaligned string payload");
+  write_c_string(writer, "c string");
+
+  Player_Entity player;
+  player.health = 42;
+  player.render.mesh_id = 7;
+  player.render.mesh_path.set("assets/meshes/player_model.obj");
+  player.render.scale = {2.0f, 2.0f, 2.0f};
+  player.serialize(writer, nullptr);
+
+  const auto &bytes = writer.flush();
+  Bit_Reader reader(bytes.data(), bytes.size());
+  assert(reader.read_bit());
+  std::string s;
+  read_string(reader, s);
+  assert(s == "unaligned string payload");
+  char c_str[32];
+  read_c_string(reader, c_str, sizeof(c_str));
+  assert(std::string(c_str) == "c string");
+
+  Player_Entity received;
+  received.deserialize(reader);
+  assert(received.health == 42);
+  assert(received.render.mesh_id == 7);
+  assert(std::string(received.render.mesh_path.c_str()) ==
+         "assets/meshes/player_model.obj");
+  assert(received.render.scale.x == 2.0f);
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_quantized_fields()
+{
+  std::cout << "  [Subtest] Quantized fields..." << std::endl;
+
+  // Widths are known at compile time.
+  static_assert(quantize_range(0.0f, 100.0f, 1.0f).bits == 7);
+  static_assert(quantize_range(-1.0f, 31.0f, 1.0f).bits == 6);
+  static_assert(quantize_angle(12).bits == 12);
+  static_assert(quantize_position(1.0f / 32.0f).bits == 21);
+  static_assert(Entity::_schema_meta_position.quantization.mode ==
+                Quantization::Position);
+
+  constexpr Field_Quantization health = quantize_range(0.0f, 100.0f, 1.0f);
+  constexpr Field_Quantization angle = quantize_angle(12);
+  constexpr Field_Quantization position = quantize_position(1.0f / 32.0f);
+  constexpr Field_Quantization normal = quantize_unit_normal(11);
+
+  Bit_Writer writer;
+  write_quantized_int(writer, 73, health);
+  write_quantized_int(writer, 250, health); // clamped to 7 bits
+  write_quantized(writer, -90.0f, angle);
+  write_quantized(writer, 270.0f, angle); // wraps
+  write_quantized(writer, 1234.5f, position);
+  write_quantized(writer, -20000.25f, position); // outside the world box
+  float direction[3] = {0.3f, -0.5f, -0.81f};
+  write_quantized_vec3(writer, direction, normal);
+  size_t bits = writer.bits_written();
+  assert(bits == 7 * 2 + 12 * 2 + (1 + 21) + (1 + 32) + 11 * 2);
+
+  const auto &bytes = writer.flush();
+  Bit_Reader reader(bytes.data(), bytes.size());
+  assert(read_quantized_int(reader, health) == 73);
+  assert(read_quantized_int(reader, health) == 127);
+  assert(std::abs(read_quantized(reader, angle) + 90.0f) < 0.05f);
+  assert(std::abs(read_quantized(reader, angle) + 90.0f) < 0.05f);
+  assert(read_quantized(reader, position) == 1234.5f);
+  assert(read_quantized(reader, position) == -20000.25f);
+  float decoded[3];
+  read_quantized_vec3(reader, decoded, normal);
+  float length = std::sqrt(0.3f * 0.3f + 0.5f * 0.5f + 0.81f * 0.81f);
+  float dot = (decoded[0] * 0.3f - decoded[1] * 0.5f - decoded[2] * 0.81f) /
+              length;
+  assert(dot > 0.9999f);
+
+  // Schema fields pick their encoding up through serialize / deserialize.
+  Player_Entity player;
+  player.position = {100.25f, -3.5f, 4000.0f};
+  player.orientation = {0.0f, 45.0f, 0.0f};
+  player.view_angle_yaw = 123.0f;
+  player.client_slot_index = 5;
+  Bit_Writer entity_writer;
+  player.serialize(entity_writer, nullptr);
+  const auto &entity_bytes = entity_writer.flush();
+  Bit_Reader entity_reader(entity_bytes.data(), entity_bytes.size());
+  Player_Entity received;
+  received.deserialize(entity_reader);
+  assert(received.position.x == 100.25f && received.position.y == -3.5f &&
+         received.position.z == 4000.0f);
+  assert(received.orientation.y == 45.0f);
+  assert(std::abs(received.view_angle_yaw - 123.0f) < 0.01f);
+  assert(received.client_slot_index == 5);
+  std::cout << "    -> Success! (" << entity_bytes.size()
+            << " bytes for a full player)" << std::endl;
+}
+
+void test_int_codings()
+{
+  std::cout << "  [Subtest] Integer codings..." << std::endl;
+
+  constexpr Int_Coding codings[] = {Int_Coding::Nibble, Int_Coding::Group7,
+                                    Int_Coding::Length_Prefixed};
+  const uint32_t unsigned_values[] = {0,       1,          15,   16,
+                                      127,     128,        1000, 16383,
+                                      16384,   0x7FFFFFFF, 0x80000000,
+                                      0xFFFFFFFF};
+  const int32_t signed_values[] = {0,     -1,    1,         -64,      63,
+                                   -65,   100,   -1000,     INT32_MAX,
+                                   INT32_MIN};
+
+  for (Int_Coding coding : codings)
+  {
+    Bit_Writer writer;
+    size_t expected_bits = 0;
+    for (uint32_t value : unsigned_values)
+    {
+      size_t before = writer.bits_written();
+      write_coded_uint(writer, value, coding);
+      assert(writer.bits_written() - before == coded_uint_bits(value, coding));
+      expected_bits += coded_uint_bits(value, coding);
+    }
+    for (int32_t value : signed_values)
+      write_coded_int(writer, value, coding);
+    assert(expected_bits <= writer.bits_written());
+
+    const auto &bytes = writer.flush();
+    Bit_Reader reader(bytes.data(), bytes.size());
+    for (uint32_t value : unsigned_values)
+      assert(read_coded_uint(reader, coding) == value);
+    for (int32_t value : signed_values)
+      assert(read_coded_int(reader, coding) == value);
+  }
+
+  // The worst cases the old nibble coding had, against the new ones.
+  assert(coded_uint_bits(0xFFFFFFFF, Int_Coding::Nibble) == 40);
+  assert(coded_uint_bits(0xFFFFFFFF, Int_Coding::Group7) == 40);
+  assert(coded_uint_bits(0xFFFFFFFF, Int_Coding::Length_Prefixed) == 37);
+  assert(coded_uint_bits(127, Int_Coding::Nibble) == 10);
+  assert(coded_uint_bits(127, Int_Coding::Group7) == 8);
+  assert(coded_uint_bits(1000, Int_Coding::Length_Prefixed) == 15);
+  // Zig-zag keeps small negatives small.
+  assert(zig_zag(-1) == 1 && zig_zag(1) == 2 && zig_zag(INT32_MIN) == ~0u);
+
+  // Each field round-trips through its declared coding.
+  static_assert(Coded_Counters::_schema_meta_group7.quantization.int_coding ==
+                Int_Coding::Group7);
+  Coded_Counters counters;
+  counters.nibble = -12345;
+  counters.group7 = -12345;
+  counters.length_prefixed = -12345;
+  Bit_Writer writer;
+  counters.serialize(writer, nullptr);
+  const auto &bytes = writer.flush();
+  Bit_Reader reader(bytes.data(), bytes.size());
+  Coded_Counters received;
+  received.deserialize(reader);
+  assert(received.nibble == -12345 && received.group7 == -12345 &&
+         received.length_prefixed == -12345);
+  std::cout << "    -> Success!" << std::endl;
+}
+
+// The lane kernel against one memcmp per field, for random byte flips in
+// every networked class (and Wedge_Entity, which registers a field twice).
+void test_diff_kernel()
+{
+  std::cout << "  [Subtest] Changed-field kernel (" << diff_lane_bytes
+            << "-byte lanes)..." << std::endl;
+
+  Player_Entity player;
+  Weapon_Entity weapon;
+  AABB_Entity box;
+  Wedge_Entity wedge;
+  const Entity *prototypes[] = {&player, &weapon, &box, &wedge};
+
+  game::seed_rng(7);
+  for (const Entity *prototype : prototypes)
+  {
+    const Class_Schema *schema = prototype->get_schema();
+    size_t size = schema->state_size;
+    std::vector<uint8> base(size);
+    std::memcpy(base.data(), reinterpret_cast<const uint8 *>(prototype),
+                size);
+    // Whichever strategy the class picked, both must agree.
+    Diff_Layout per_field;
+    Diff_Layout lanes;
+    per_field.build(schema->fields, size, Diff_Strategy::Per_Field);
+    lanes.build(schema->fields, size, Diff_Strategy::Lanes);
+    assert(!per_field.uses_lanes() && lanes.uses_lanes());
+    for (int round = 0; round < 2000; ++round)
+    {
+      std::vector<uint8> current = base;
+      int flips = int(game::random_uint64() % 4);
+      for (int f = 0; f < flips; ++f)
+        current[game::random_uint64() % size] ^= 0x81;
+
+      Field_Mask expected = 0;
+      for (const auto &field : schema->fields)
+      {
+        if (std::memcmp(current.data() + field.offset,
+                        base.data() + field.offset, field.size) != 0)
+          expected |= Field_Mask(1) << field.index;
+      }
+      assert(changed_field_mask(schema, current.data(), base.data()) ==
+             expected);
+      assert(fields_differ(schema, current.data(), base.data()) ==
+             (expected != 0));
+      assert(per_field.changed_fields(current.data(), base.data()) ==
+             expected);
+      assert(lanes.changed_fields(current.data(), base.data()) == expected);
+      assert(per_field.differs(current.data(), base.data()) ==
+             (expected != 0));
+      assert(lanes.differs(current.data(), base.data()) == (expected != 0));
+    }
+  }
+  // Many small fields compare by lanes; a render component with a few small
+  // fields next to it is cheaper per field.
+  assert(player.get_schema()->diff_layout.uses_lanes());
+  assert(!box.get_schema()->diff_layout.uses_lanes());
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_field_codecs()
+{
+  std::cout << "  [Subtest] Per-class field codecs..." << std::endl;
+
+  Player_Entity player;
+  player.position = {-1234.5f, 96.0f, 2048.25f};
+  player.orientation = {0.0f, -135.0f, 10.0f};
+  player.view_angle_yaw = 91.5f;
+  player.view_angle_pitch = -30.0f;
+  player.health = -7;
+  player.ammo = 123456;
+  player.client_slot_index = 31;
+  Weapon_Entity weapon;
+  weapon.ammo = 12;
+  AABB_Entity box;
+  box.half_extents = {64.0f, 0.5f, 3.25f};
+  const Entity *prototypes[] = {&player, &weapon, &box};
+
+  for (const Entity *prototype : prototypes)
+  {
+    const Class_Schema *schema = prototype->get_schema();
+    const uint8 *base = reinterpret_cast<const uint8 *>(prototype);
+    assert(schema->codecs.size() == schema->fields.size());
+    for (const auto &field : schema->fields)
+    {
+      const Field_Codec &codec = schema->codecs[field.index];
+      assert(codec.offset == field.offset);
+
+      // Numeric fields must come out exactly as the runtime-dispatched
+      // encoders write them.
+      Bit_Writer expected;
+      const uint8 *p = base + field.offset;
+      if (field.type == Field_Type::Int32)
+        write_quantized_int(expected, *reinterpret_cast<const int32 *>(p),
+                            field.quantization);
+      else if (field.type == Field_Type::Float32)
+        write_quantized(expected, *reinterpret_cast<const float *>(p),
+                        field.quantization);
+      else if (field.type == Field_Type::Vec3f)
+        write_quantized_vec3(expected, reinterpret_cast<const float *>(p),
+                             field.quantization);
+      else
+        continue;
+
+      Bit_Writer actual;
+      codec.write(actual, p, codec.quantization);
+      assert(actual.bits_written() == expected.bits_written());
+      assert(actual.flush() == expected.flush());
+    }
+  }
+
+  // apply_diff indexes fields directly and skips ids it does not know.
+  Player_Entity target;
+  std::vector<Field_Update> updates = diff(nullptr, &player,
+                                           player.get_schema());
+  updates.push_back({uint16_t(player.get_schema()->fields.size()), {1, 2}});
+  apply_diff(&target, updates, target.get_schema());
+  assert(!fields_differ(player.get_schema(),
+                        reinterpret_cast<const uint8 *>(&player),
+                        reinterpret_cast<const uint8 *>(&target)));
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_class_ids()
+{
+  std::cout << "  [Subtest] Dense class ids..." << std::endl;
+
+  Schema_Registry &registry = Schema_Registry::get();
+  // Shared entity classes: id == entity_type, whatever registered first.
+  Player_Entity player;
+  Weapon_Entity weapon;
+  Wedge_Entity wedge;
+  assert(player.get_schema()->class_id == uint16_t(entity_type::PLAYER));
+  assert(weapon.get_schema()->class_id == uint16_t(entity_type::WEAPON));
+  assert(wedge.get_schema()->class_id == uint16_t(entity_type::WEDGE));
+  assert(shared::schema_for_type(entity_type::WEAPON) == weapon.get_schema());
+  assert(shared::schema_for_type(entity_type::UNKNOWN) == nullptr);
+  assert(shared::schema_for_type(entity_type::COUNT) == nullptr);
+  assert(registry.get_schema(uint16_t(0))->class_name == "Entity");
+
+  // Every id maps back to the schema registered under its name.
+  for (size_t id = 0; id < registry.class_count(); ++id)
+  {
+    const Class_Schema *schema = registry.get_schema(uint16_t(id));
+    assert(schema->class_id == id);
+    assert(registry.get_schema(schema->class_name) == schema);
+  }
+  assert(registry.get_schema(uint16_t(registry.class_count())) == nullptr);
+
+  // Registering again keeps the id and the pointer get_schema() cached.
+  TestPlayer test_player;
+  const Class_Schema *before = test_player.get_schema();
+  const Class_Schema *again =
+      registry.register_class("TestPlayer", before->fields, before->relevancy);
+  assert(again == before && again->class_id == before->class_id);
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_component_offsets()
+{
+  std::cout << "  [Subtest] Component offset table..." << std::endl;
+
+  Player_Entity player;
+  AABB_Entity box;
+  assert(player.get_component<render_component_t>() == &player.render);
+  assert(player.get_component<vec3f>() == &player.position); // first vec3f
+  assert(player.get_component<pascal_string>() == nullptr);
+  assert(box.get_component<render_component_t>() == &box.render);
+  assert(box.get_component<int32>() == nullptr);
+  const Entity &as_base = box;
+  assert(as_base.get_component<vec3f>() == &box.position);
+
+  // for_each_component visits exactly the entities get_component finds.
+  shared::Entity_System entities;
+  for (int i = 0; i < 3; ++i)
+    entities.spawn<Player_Entity>(entity_type::PLAYER);
+  for (int i = 0; i < 2; ++i)
+    entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+  for (int i = 0; i < 4; ++i)
+    entities.spawn<AABB_Entity>(entity_type::AABB);
+
+  int visited = 0;
+  entities.for_each_component<render_component_t>(
+      [&](Entity &entity, render_component_t &render)
+      {
+        assert(entity.get_component<render_component_t>() == &render);
+        render.mesh_id = 7;
+        visited += 1;
+      });
+  assert(visited == 9);
+  for (const auto &p :
+       *entities.get_entities<Player_Entity>(entity_type::PLAYER))
+    assert(p.render.mesh_id == 7);
+
+  // Only players and weapons have an int32.
+  visited = 0;
+  entities.for_each_component<int32>([&](Entity &, int32 &) { visited += 1; });
+  assert(visited == 5);
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_entity_handles()
+{
+  std::cout << "  [Subtest] Entity handles..." << std::endl;
+
+  shared::Entity_System entities;
+  std::vector<Entity_Id> ids;
+  for (int i = 0; i < 8; ++i)
+  {
+    auto *weapon = entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+    weapon->ammo = i;
+    ids.push_back(weapon->id);
+  }
+  auto *player = entities.spawn<Player_Entity>(entity_type::PLAYER);
+  Entity_Id player_id = player->id;
+
+  // Destroying moves the last weapon into the hole; every other handle
+  // still finds its own entity.
+  assert(entities.destroy(ids[2]));
+  assert(!entities.destroy(ids[2]));
+  assert(entities.find(ids[2]) == nullptr);
+  assert(entities.get_entities<Weapon_Entity>(entity_type::WEAPON)->size() ==
+         7);
+  for (int i = 0; i < 8; ++i)
+  {
+    if (i == 2)
+      continue;
+    auto *weapon = entities.get<Weapon_Entity>(entity_type::WEAPON, ids[i]);
+    assert(weapon && weapon->ammo == i && weapon->id == ids[i]);
+  }
+  assert(entities.get<Weapon_Entity>(entity_type::WEAPON, player_id) ==
+         nullptr);
+  assert(entities.find(player_id) == player);
+  assert(entities.find(null_entity_id) == nullptr);
+
+  // The freed index comes back with a new generation.
+  auto *reused = entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+  assert(reused->id.index == ids[2].index);
+  assert(!(reused->id == ids[2]));
+  assert(entities.find(ids[2]) == nullptr);
+  assert(entities.find(reused->id) == reused);
+
+  // Ids from before a reset do not resolve afterwards.
+  entities.reset();
+  auto *after = entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+  assert(entities.find(ids[0]) == nullptr);
+  assert(entities.find(after->id) == after);
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_transform_stream()
+{
+  std::cout << "  [Subtest] Transform stream..." << std::endl;
+
+  shared::Entity_System entities;
+  std::vector<Entity_Id> ids;
+  for (int i = 0; i < 6; ++i)
+  {
+    auto *weapon = entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+    weapon->position = {float(i) * 100.0f, 0.0f, 0.0f};
+    weapon->orientation = {0.0f, float(i), 0.0f};
+    ids.push_back(weapon->id);
+  }
+  auto *player = entities.spawn<Player_Entity>(entity_type::PLAYER);
+  player->position = {0.0f, 50.0f, 0.0f};
+  Entity_Id player_id = player->id;
+  assert(entities.destroy(ids[1]));
+
+  entities.sync_transforms();
+  const shared::Transform_Stream &stream = entities.transforms;
+  assert(stream.size() == 6);
+  assert(stream.positions.size() == 6 && stream.orientations.size() == 6);
+  for (int i = 0; i < 6; ++i)
+  {
+    size_t index = entities.transform_index(ids[i]);
+    if (i == 1)
+    {
+      assert(index == stream.size());
+      continue;
+    }
+    assert(index < stream.size() && stream.ids[index] == ids[i]);
+    assert(stream.positions[index].x == float(i) * 100.0f);
+    assert(stream.orientations[index].y == float(i));
+  }
+  size_t player_index = entities.transform_index(player_id);
+  assert(stream.positions[player_index].y == 50.0f);
+
+  // Batch passes over the stream.
+  shared::aabb_bounds_t all = shared::enclosing_bounds(stream.positions);
+  assert(all.min.x == 0.0f && all.max.x == 500.0f && all.max.y == 50.0f);
+  std::vector<uint32_t> near;
+  shared::cull_sphere(stream.positions, {0, 0, 0}, 150.0f, near);
+  assert(near.size() == 2); // weapon 0 and the player
+  for (uint32_t index : near)
+    assert(stream.ids[index] == ids[0] || stream.ids[index] == player_id);
+
+  // The stream does not follow spawns after the sync.
+  auto *late = entities.spawn<Weapon_Entity>(entity_type::WEAPON);
+  assert(entities.transform_index(late->id) == entities.transforms.size());
+
+  entities.reset();
+  assert(entities.transforms.size() == 0);
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_entity_type_tags()
+{
+  std::cout << "  [Subtest] Entity type tags..." << std::endl;
+
+  Player_Entity player;
+  Weapon_Entity weapon;
+  AABB_Entity box;
+  Wedge_Entity wedge;
+  Static_Mesh_Entity mesh;
+  TestPlayer untagged;
+  assert(player.type == entity_type::PLAYER);
+  assert(weapon.type == entity_type::WEAPON);
+  assert(box.type == entity_type::AABB);
+  assert(wedge.type == entity_type::WEDGE);
+  assert(mesh.type == entity_type::STATIC_MESH);
+  assert(untagged.type == entity_type::UNKNOWN);
+  Player_Entity copy = player;
+  assert(copy.type == entity_type::PLAYER);
+
+  // Factory-made entities are tagged too, and tags agree with class ids.
+  auto made = shared::create_entity_by_classname("wedge_entity");
+  assert(made->type == entity_type::WEDGE);
+  assert(made->get_schema()->class_id == uint16_t(made->type));
+  assert(shared::get_classname_for_entity(made.get()) == "wedge_entity");
+  assert(shared::get_classname_for_entity(&untagged) == "unknown");
+
+  Entity *as_base = &box;
+  assert(entity_cast<AABB_Entity>(as_base) == &box);
+  assert(entity_cast<Wedge_Entity>(as_base) == nullptr);
+  assert(entity_cast<AABB_Entity>(static_cast<Entity *>(nullptr)) == nullptr);
+  const Entity *as_const = &wedge;
+  assert(entity_cast<Wedge_Entity>(as_const) == &wedge);
+
+  // visit_entity hands each entity over as its own class, and anything not
+  // in the list as an Entity.
+  Entity *all[] = {&player, &weapon, &box, &wedge, &mesh, &untagged};
+  int seen[7] = {};
+  for (Entity *entity : all)
+  {
+    int which = shared::visit_entity(
+        *entity, shared::overloaded{
+                     [](Player_Entity &) { return 1; },
+                     [](Weapon_Entity &) { return 2; },
+                     [](AABB_Entity &) { return 3; },
+                     [](const Wedge_Entity &) { return 4; },
+                     [](Static_Mesh_Entity &) { return 5; },
+                     [](Entity &) { return 6; }});
+    seen[which] += 1;
+  }
+  for (int i = 1; i <= 6; ++i)
+    assert(seen[i] == 1);
+
+  int boxes = 0;
+  for (const Entity *entity : all)
+    shared::visit_entity(*entity,
+                         shared::overloaded{
+                             [&](const AABB_Entity &visited)
+                             {
+                               assert(&visited == &box);
+                               boxes += 1;
+                             },
+                             [](const auto &) {}});
+  assert(boxes == 1);
+  std::cout << "    -> Success!" << std::endl;
+}
+
+void test_bandwidth_profiler()
+{
+  std::cout << "  [Subtest] Bandwidth profiler..." << std::endl;
+
+  Bandwidth_Profiler &profiler = Bandwidth_Profiler::get();
+  profiler.reset();
+  profiler.set_enabled(true);
+
+  Coded_Counters counters;
+  counters.nibble = 1000;       // sign + 3 nibbles: 16 bits
+  counters.group7 = 1000;       // zig-zag 2000, two groups: 16 bits
+  counters.length_prefixed = 1; // zig-zag 2, 5 + 2 bits
+  Coded_Counters baseline = counters;
+  baseline.group7 = 0;
+
+  const Class_Schema *schema = counters.get_schema();
+  auto one_entity = [&](uint32 tick, const Coded_Counters &state)
+  {
+    snapshot_t snapshot;
+    snapshot.tick = tick;
+    std::memcpy(snapshot.append({1, 1}, entity_type{}, schema),
+                reinterpret_cast<const uint8 *>(&state), schema->state_size);
+    return snapshot;
+  };
+  snapshot_t base = one_entity(1, baseline);
+  snapshot_t current = one_entity(2, counters);
+
+  // One client gets the full record, three share the same delta record
+  // (encoded once) and one has it deferred by its budget: bits are counted
+  // per record sent, not per record encoded.
+  Priority_Accumulator priorities;
+  std::vector<Snapshot_Builder::Client> clients(5);
+  for (size_t c = 1; c < clients.size(); ++c)
+    clients[c].baseline = {&base};
+  clients[4].budget_bytes = 0;
+  clients[4].priorities = &priorities;
+  Snapshot_Builder builder;
+  builder.build(current, clients, nullptr);
+  assert(builder.stats().lookups == 5 && builder.stats().hits == 3);
+  profiler.set_enabled(false);
+
+  std::vector<Bandwidth_Profiler::row_t> rows = profiler.rows();
+  auto find = [&](const std::string &field)
+  {
+    for (const auto &row : rows)
+      if (row.class_name == "Coded_Counters" && row.field_name == field)
+        return row;
+    assert(false && "field missing from the profile");
+    return Bandwidth_Profiler::row_t{};
+  };
+  auto nibble = find("nibble");
+  auto group7 = find("group7");
+  auto length = find("length_prefixed");
+  auto mask = find("(changed mask)");
+  assert(nibble.encoding == "nibble" && nibble.count == 1 &&
+         nibble.bits == 16);
+  assert(group7.encoding == "group7" && group7.count == 4 &&
+         group7.bits == 4 * 16);
+  assert(length.encoding == "length_prefixed" && length.bits == 7);
+  assert(mask.count == 4 && mask.bits == 4 * 3);
+  for (size_t i = 1; i < rows.size(); ++i)
+    assert(rows[i - 1].bits >= rows[i].bits);
+
+  std::cout << profiler.report();
+  profiler.reset();
+  assert(profiler.rows().empty());
+  std::cout << "    -> Success!" << std::endl;
+}
+
 int main()
 {
   std::cout << "[TEST] Starting Entity Delta Packing Test..." << std::endl;
 
   // 1. Register Schema
   TestPlayer::register_schema();
+  Coded_Counters::register_schema();
 
   // 2. Create Entity
   TestPlayer player;
@@ -147,6 +856,19 @@ int main()
     std::cout << "    -> Success (within precision limits)!" << std::endl;
   }
 
+  test_bit_writer_matches_reference();
+  test_strings_and_render_component();
+  test_quantized_fields();
+  test_int_codings();
+  test_diff_kernel();
+  test_field_codecs();
+  test_class_ids();
+  test_component_offsets();
+  test_entity_handles();
+  test_transform_stream();
+  test_entity_type_tags();
+  test_bandwidth_profiler();
+
   std::cout << "[TEST] All Tests Passed." << std::endl;
   return 0;
 }
@@ -80,7 +80,7 @@ void test_modify()
   // Setup
   auto ent = std::make_shared<AABB_Entity>();
   ent->position = {0, 0, 0};
-  entity_uid_t uid = map.add_entity(ent);
+  entity_uid_t uid = map.add_entity(*ent);
 
   // 1. Modify via Edit_Recorder
   {
@@ -88,7 +88,7 @@ void test_modify()
     edit.track(uid);
 
     auto *entry = map.find_by_uid(uid);
-    auto *aabb = dynamic_cast<AABB_Entity *>(entry->entity.get());
+    auto *aabb = dynamic_cast<AABB_Entity *>(entry->entity);
     aabb->position = {10.0f, 0, 0};
 
     edit.finish(uid);
@@ -98,7 +98,7 @@ void test_modify()
   }
 
   auto *entry = map.find_by_uid(uid);
-  auto *aabb = dynamic_cast<AABB_Entity *>(entry->entity.get());
+  auto *aabb = dynamic_cast<AABB_Entity *>(entry->entity);
   assert(aabb);
   assert(aabb->position.x == 10.0f);
   assert(ts.can_undo());
@@ -106,13 +106,13 @@ void test_modify()
   // 2. Undo Modify
   ts.undo(map);
   entry = map.find_by_uid(uid);
-  aabb = dynamic_cast<AABB_Entity *>(entry->entity.get());
+  aabb = dynamic_cast<AABB_Entity *>(entry->entity);
   assert(aabb->position.x == 0.0f);
 
   // 3. Redo Modify
   ts.redo(map);
   entry = map.find_by_uid(uid);
-  aabb = dynamic_cast<AABB_Entity *>(entry->entity.get());
+  aabb = dynamic_cast<AABB_Entity *>(entry->entity);
   assert(aabb->position.x == 10.0f);
 
   std::cout << "Modify Passed." << std::endl;
@@ -127,15 +127,15 @@ void test_batch_delete()
   // Add 3 entities
   auto e1 = std::make_shared<AABB_Entity>();
   e1->position = {1, 0, 0};
-  entity_uid_t uid1 = map.add_entity(e1);
+  entity_uid_t uid1 = map.add_entity(*e1);
 
   auto e2 = std::make_shared<AABB_Entity>();
   e2->position = {2, 0, 0};
-  entity_uid_t uid2 = map.add_entity(e2);
+  entity_uid_t uid2 = map.add_entity(*e2);
 
   auto e3 = std::make_shared<AABB_Entity>();
   e3->position = {3, 0, 0};
-  entity_uid_t uid3 = map.add_entity(e3);
+  entity_uid_t uid3 = map.add_entity(*e3);
 
   assert(map.entities.size() == 3);
 
@@ -161,9 +161,9 @@ void test_batch_delete()
   assert(map.find_by_uid(uid3) != nullptr);
 
   // Verify positions are correct
-  auto *r1 = dynamic_cast<AABB_Entity *>(map.find_by_uid(uid1)->entity.get());
-  auto *r2 = dynamic_cast<AABB_Entity *>(map.find_by_uid(uid2)->entity.get());
-  auto *r3 = dynamic_cast<AABB_Entity *>(map.find_by_uid(uid3)->entity.get());
+  auto *r1 = dynamic_cast<AABB_Entity *>(map.find_by_uid(uid1)->entity);
+  auto *r2 = dynamic_cast<AABB_Entity *>(map.find_by_uid(uid2)->entity);
+  auto *r3 = dynamic_cast<AABB_Entity *>(map.find_by_uid(uid3)->entity);
   assert(r1->position.x == 1.0f);
   assert(r2->position.x == 2.0f);
   assert(r3->position.x == 3.0f);
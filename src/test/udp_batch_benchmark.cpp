@@ -0,0 +1,105 @@
+#include "../shared/network/packet.hpp"
+#include "../shared/network/udp_socket.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Loopback throughput of the single-packet socket path versus the batched
+// (sendmmsg / recvmmsg) and GSO paths. Each round sends one multi-fragment
+// "snapshot" and drains the receiving socket, which is what the server does
+// per client per tick.
+
+using namespace network;
+using bench_clock = std::chrono::high_resolution_clock;
+
+enum class Path
+{
+  Single,
+  Batch,
+  Gso,
+};
+
+struct Result
+{
+  size_t sent = 0;
+  size_t received = 0;
+  double seconds = 0.0;
+};
+
+Result run(Path path, Udp_Socket &sender, Udp_Socket &receiver,
+           const Address &dest, const std::vector<Packet> &snapshot,
+           int rounds)
+{
+  sender.set_gso_enabled(path == Path::Gso);
+
+  std::vector<Packet> inbox(64);
+  std::vector<Address> senders(64);
+
+  Result result;
+  auto start = bench_clock::now();
+  for (int round = 0; round < rounds; ++round)
+  {
+    if (path == Path::Single)
+    {
+      for (const auto &p : snapshot)
+        result.sent += sender.send(p, dest) ? 1 : 0;
+
+      Packet p;
+      Address from;
+      while (receiver.receive(p, from))
+        ++result.received;
+    }
+    else
+    {
+      result.sent += sender.send_batch(snapshot, dest);
+      size_t n;
+      while ((n = receiver.receive_batch(inbox, senders)) > 0)
+        result.received += n;
+    }
+  }
+  result.seconds =
+      std::chrono::duration<double>(bench_clock::now() - start).count();
+  return result;
+}
+
+int main()
+{
+  std::cout << "[BENCH] UDP loopback throughput" << std::endl;
+
+  Udp_Socket receiver;
+  Udp_Socket sender;
+  if (!receiver.open(9010) || !sender.open(0))
+  {
+    std::cerr << "Failed to open benchmark sockets" << std::endl;
+    return 1;
+  }
+  Address dest(127, 0, 0, 1, 9010);
+  std::cout << "  GSO supported: " << (sender.gso_supported() ? "yes" : "no")
+            << std::endl;
+
+  // An 8-fragment snapshot (7 full + 1 partial).
+  std::vector<uint8> payload(MAX_PAYLOAD_SIZE_IN_BYTES * 7 + 300, 0xAB);
+  auto snapshot = convert_to_packets(payload, 1);
+
+  constexpr int ROUNDS = 20000;
+  const char *names[] = {"single send/recvfrom", "sendmmsg/recvmmsg",
+                         "GSO/recvmmsg"};
+  double baseline_pps = 0.0;
+  for (Path path : {Path::Single, Path::Batch, Path::Gso})
+  {
+    if (path == Path::Gso && !sender.gso_supported())
+      continue;
+    Result r = run(path, sender, receiver, dest, snapshot, ROUNDS);
+    double pps = r.received / r.seconds;
+    if (path == Path::Single)
+      baseline_pps = pps;
+    std::cout << "  " << names[int(path)] << ": sent " << r.sent
+              << ", received " << r.received << " in " << r.seconds
+              << " s -> " << pps << " packets/sec ("
+              << (baseline_pps > 0 ? pps / baseline_pps : 0.0) << "x)"
+              << std::endl;
+  }
+
+  std::cout << "[BENCH] Done." << std::endl;
+  return 0;
+}